@@ -6,13 +6,18 @@
 #include <ctime>
 #include <string>
 #include <climits>
+#include <map>
 #include <queue>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 #include "edlib.h"
+#include "sequenceReader.h"
 
 using namespace std;
 
-int readFastaSequences(const char* path, vector< vector<char> >* seqs);
+int openSequenceFile(const char* path, SequenceReader* reader);
 
 void printAlignment(const char* query, const char* target,
                     const unsigned char* alignment, const int alignmentLength,
@@ -40,13 +45,14 @@ int main(int argc, char * const argv[]) {
     int option;
     int kArg = -1;
     int numRepeats = 1;
+    int numThreads = 1;
 
     // If "STD" or "EXT", cigar string will be printed. if "NICE" nice representation
     // of alignment will be printed.
     char alignmentFormat[16] = "NICE";
 
     bool invalidOption = false;
-    while ((option = getopt(argc, argv, "m:n:k:f:r:spl")) >= 0) {
+    while ((option = getopt(argc, argv, "m:n:k:f:r:t:spl")) >= 0) {
         switch (option) {
         case 'm': strcpy(mode, optarg); break;
         case 'n': numBestSeqs = atoi(optarg); break;
@@ -56,12 +62,14 @@ int main(int argc, char * const argv[]) {
         case 'p': findAlignment = true; break;
         case 'l': findStartLocations = true; break;
         case 'r': numRepeats = atoi(optarg); break;
+        case 't': numThreads = atoi(optarg); break;
         default: invalidOption = true;
         }
     }
     if (optind + 2 != argc || invalidOption) {
         fprintf(stderr, "\n");
         fprintf(stderr, "Usage: %s [options...] <queries.fasta> <target.fasta>\n", argv[0]);
+        fprintf(stderr, "Files can also be in FASTQ format, and can be compressed with gzip.\n");
         fprintf(stderr, "Options:\n");
         fprintf(stderr, "\t-s  If specified, there will be no score or alignment output (silent mode).\n");
         fprintf(stderr, "\t-m HW|NW|SHW  Alignment mode that will be used. [default: NW]\n");
@@ -82,6 +90,7 @@ int main(int argc, char * const argv[]) {
         fprintf(stderr, "\t-r N  Core part of calculation will be repeated N times."
                 " This is useful only for performance measurement, when single execution is too short to measure."
                 " [default: 1]\n");
+        fprintf(stderr, "\t-t N  Number of threads that queries are aligned in. [default: 1]\n");
         return 1;
     }
     //-------------------------------------------------------------------------//
@@ -92,6 +101,11 @@ int main(int argc, char * const argv[]) {
         return 1;
     }
 
+    if (numThreads < 1) {
+        printf("Invalid number of threads (-t)!\n");
+        return 1;
+    }
+
     EdlibAlignMode modeCode;
     if (!strcmp(mode, "SHW"))
         modeCode = EDLIB_MODE_SHW;
@@ -110,221 +124,254 @@ int main(int argc, char * const argv[]) {
     if (findAlignment) alignTask = EDLIB_TASK_PATH;
 
 
-    int readResult;
-    // Read queries
+    // Open queries, they are read while they are being aligned.
     char* queriesFilepath = argv[optind];
-    vector< vector<char> >* querySequences = new vector< vector<char> >();
-    printf("Reading queries...\n");
-    readResult = readFastaSequences(queriesFilepath, querySequences);
-    if (readResult) {
-        printf("Error: There is no file with name %s\n", queriesFilepath);
-        delete querySequences;
+    SequenceReader queryReader;
+    if (openSequenceFile(queriesFilepath, &queryReader)) {
         return 1;
     }
-    int numQueries = querySequences->size();
-    int queriesTotalLength = 0;
-    for (int i = 0; i < numQueries; i++) {
-        queriesTotalLength += (*querySequences)[i].size();
-    }
-    printf("Read %d queries, %d residues total.\n", numQueries, queriesTotalLength);
 
     // Read target
     char* targetFilepath = argv[optind+1];
-    vector< vector<char> >* targetSequences = new vector< vector<char> >();
+    SequenceReader targetReader;
     printf("Reading target fasta file...\n");
-    readResult = readFastaSequences(targetFilepath, targetSequences);
-    if (readResult) {
-        printf("Error: There is no file with name %s\n", targetFilepath);
-        delete querySequences;
-        delete targetSequences;
+    if (openSequenceFile(targetFilepath, &targetReader)) {
+        return 1;
+    }
+    const char* target;
+    int targetLength;
+    if (!targetReader.next(&target, &targetLength)) {
+        printf("Error: There is no sequence in file %s\n", targetFilepath);
         return 1;
     }
-    char* target = (*targetSequences)[0].data();
-    int targetLength = (*targetSequences)[0].size();
     printf("Read target, %d residues.\n", targetLength);
 
 
     // ----------------------------- MAIN CALCULATION ----------------------------- //
-    printf("\nComparing queries to target...\n");
-    int* scores = new int[numQueries];
-    int** endLocations = new int*[numQueries];
-    int** startLocations = new int*[numQueries];
-    int* numLocations = new int[numQueries];
+    printf("\nReading queries and comparing them to target...\n");
+    // Without -n, results are printed in same order as queries are given, as soon as results of all
+    // queries before them are printed, and are freed right after that.
+    // With -n, it is known which results to print only once all queries are aligned, so until then
+    // only results that can still be among the best ones are kept.
+    const bool keepBest = numBestSeqs > 0;
+    struct QueryResult {
+        const char* query;
+        int queryLength;
+        EdlibAlignResult result;
+        bool done;  // True once result is calculated.
+    };
+    // Queries that are being aligned and results that are not printed yet, by query index.
+    map<int, QueryResult> results;
+    int nextToPrint = 0;  // Index of query which result is printed next, used without -n.
+    priority_queue< pair<int, int> > keptScores;  // Scores and indices of kept results, worst on top, with -n.
     priority_queue<int> bestScores; // Contains numBestSeqs best scores
     int k = kArg;
-    unsigned char* alignment = NULL; int alignmentLength;
+    int numQueries = 0;
+    long long queriesTotalLength = 0;
+    int numQueriesDone = 0;
+    // Guards queryReader, results, nextToPrint, keptScores, bestScores, k, counters of queries and output.
+    mutex resultsMutex;
     clock_t start = clock();
+    chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
 
-    if (!findAlignment || silent) {
-        printf("0/%d", numQueries);
-        fflush(stdout);
-    }
-    for (int i = 0; i < numQueries; i++) {
-        char* query = (*querySequences)[i].data();
-        int queryLength = (*querySequences)[i].size();
-
-        // Calculate score
-        EdlibAlignResult result;
-        for (int rep = 0; rep < numRepeats; rep++) {  // Redundant repetition, for performance measurements.
-            result = edlibAlign(query, queryLength, target, targetLength,
-                                edlibNewAlignConfig(k, modeCode, alignTask, NULL, 0));
-            if (rep < numRepeats - 1) edlibFreeAlignResult(result);
-        }
-
-        scores[i] = result.editDistance;
-        endLocations[i] = result.endLocations;
-        startLocations[i] = result.startLocations;
-        numLocations[i] = result.numLocations;
-        alignment = result.alignment;
-        alignmentLength = result.alignmentLength;
-
-        // If we want only numBestSeqs best sequences, update best scores 
-        // and adjust k to largest score.
-        if (numBestSeqs > 0) {
-            if (scores[i] >= 0) {
-                bestScores.push(scores[i]);
-                if (static_cast<int>(bestScores.size()) > numBestSeqs) {
-                    bestScores.pop();
-                }
-                if (static_cast<int>(bestScores.size()) == numBestSeqs) {
-                    k = bestScores.top() - 1;
-                    if (kArg >= 0 && kArg < k)
-                        k = kArg;
-                }
-            }
-        }
-        
-        if (!findAlignment || silent) {
-            printf("\r%d/%d", i + 1, numQueries);
-            fflush(stdout);
-        } else {
+    // Prints alignment of query with given index if it was found, or its score if alignment was not searched for.
+    auto printResult = [&](const int i, const QueryResult& queryResult) {
+        const EdlibAlignResult& result = queryResult.result;
+        if (findAlignment) {
             // Print alignment if it was found, use first position
-            if (alignment) {
-                printf("\n");
-                printf("Query #%d (%d residues): score = %d\n", i, queryLength, scores[i]);
-                if (!strcmp(alignmentFormat, "NICE")) {
-                    printAlignment(query, target, alignment, alignmentLength,
-                                   *(endLocations[i]), modeCode);
+            if (!result.alignment) return;
+            printf("\n");
+            printf("Query #%d (%d residues): score = %d\n", i, queryResult.queryLength, result.editDistance);
+            if (!strcmp(alignmentFormat, "NICE")) {
+                printAlignment(queryResult.query, target, result.alignment, result.alignmentLength,
+                               *(result.endLocations), modeCode);
+            } else {
+                printf("Cigar:\n");
+                EdlibCigarFormat cigarFormat = !strcmp(alignmentFormat, "CIG_STD") ?
+                    EDLIB_CIGAR_STANDARD : EDLIB_CIGAR_EXTENDED;
+                char* cigar =edlibAlignmentToCigar(result.alignment, result.alignmentLength, cigarFormat);
+                if (cigar) {
+                    printf("%s\n", cigar);
+                    free(cigar);
                 } else {
-                    printf("Cigar:\n");
-                    EdlibCigarFormat cigarFormat = !strcmp(alignmentFormat, "CIG_STD") ?
-                        EDLIB_CIGAR_STANDARD : EDLIB_CIGAR_EXTENDED;
-                    char* cigar =edlibAlignmentToCigar(alignment, alignmentLength, cigarFormat);
-                    if (cigar) {
-                        printf("%s\n", cigar);
-                        free(cigar);
+                    printf("Error while printing cigar!\n");
+                }
+            }
+        } else if (result.editDistance > -1) {
+            printf("#%d: %d  %d", i, result.editDistance, result.numLocations);
+            if (result.numLocations > 0) {
+                printf("  [");
+                for (int j = 0; j < result.numLocations; j++) {
+                    printf(" (");
+                    if (result.startLocations) {
+                        printf("%d", result.startLocations[j]);
                     } else {
-                        printf("Error while printing cigar!\n");
+                        printf("?");
                     }
+                    printf(", %d)", result.endLocations[j]);
                 }
+                printf(" ]");
             }
+            printf("\n");
         }
+    };
+    // Frees result and query with given index.
+    auto releaseResult = [&](const int i) {
+        map<int, QueryResult>::iterator it = results.find(i);
+        edlibFreeAlignResult(it->second.result);
+        queryReader.release(it->second.query);
+        results.erase(it);
+    };
+
+    // Progress is printed only when it does not mix with results.
+    const bool printProgress = silent || (keepBest && !findAlignment);
+    if (printProgress) {
+        printf("0");
+        fflush(stdout);
+    }
+    if (!silent && !findAlignment && !keepBest) {
+        printf("Scores:\n");
+        printf("<query number>: <score>, <num_locations>, "
+               "[(<start_location_in_target>, <end_location_in_target>)]\n");
+    }
+    // Each thread reads next query when it is done with previous one, until there are no more queries.
+    auto alignQueries = [&]() {
+        EdlibWorkspace* workspace = edlibCreateWorkspace();  // Reused for all alignments in this thread.
+        while (true) {
+            int i;
+            int queryK;
+            const char* query;
+            int queryLength;
+            {
+                lock_guard<mutex> lock(resultsMutex);
+                if (!queryReader.next(&query, &queryLength)) break;
+                i = numQueries++;
+                queriesTotalLength += queryLength;
+                QueryResult& queryResult = results[i];
+                queryResult.query = query;
+                queryResult.queryLength = queryLength;
+                queryResult.done = false;
+                queryK = k;
+            }
+
+            // Calculate score
+            EdlibQueryProfile* queryProfile = edlibCreateQueryProfile(query, queryLength, NULL, 0);
+            EdlibAlignConfig config = edlibNewAlignConfig(queryK, modeCode, alignTask, NULL, 0);
+            config.workspace = workspace;
+            EdlibAlignResult result;
+            for (int rep = 0; rep < numRepeats; rep++) {  // Redundant repetition, for performance measurements.
+                result = edlibAlignWithProfile(queryProfile, target, targetLength, config);
+                if (rep < numRepeats - 1) edlibFreeAlignResult(result);
+            }
+            edlibFreeQueryProfile(queryProfile);
+
+            lock_guard<mutex> lock(resultsMutex);
+            results[i].result = result;
+            results[i].done = true;
+            if (keepBest) {
+                // If we want only numBestSeqs best sequences, update best scores
+                // and adjust k to largest score.
+                // Sequences with score equal to largest score are still calculated, so that same sequences
+                // are reported no matter in which order queries are calculated.
+                if (result.editDistance >= 0) {
+                    bestScores.push(result.editDistance);
+                    if (static_cast<int>(bestScores.size()) > numBestSeqs) {
+                        bestScores.pop();
+                    }
+                    if (static_cast<int>(bestScores.size()) == numBestSeqs) {
+                        k = bestScores.top();
+                        if (kArg >= 0 && kArg < k)
+                            k = kArg;
+                    }
+                }
+                // Results with score larger than largest of best scores will not be printed.
+                const int scoreLimit = static_cast<int>(bestScores.size()) == numBestSeqs ? bestScores.top() : INT_MAX;
+                if (result.editDistance >= 0 && result.editDistance <= scoreLimit) {
+                    keptScores.push(make_pair(result.editDistance, i));
+                } else {
+                    releaseResult(i);
+                }
+                while (!keptScores.empty() && keptScores.top().first > scoreLimit) {
+                    releaseResult(keptScores.top().second);
+                    keptScores.pop();
+                }
+            } else {
+                while (!results.empty() && results.begin()->first == nextToPrint && results.begin()->second.done) {
+                    if (!silent) printResult(nextToPrint, results.begin()->second);
+                    releaseResult(nextToPrint);
+                    nextToPrint++;
+                }
+            }
 
-        if (alignment)
-            free(alignment);
+            numQueriesDone++;
+            if (printProgress) {
+                printf("\r%d", numQueriesDone);
+                fflush(stdout);
+            }
+        }
+        edlibFreeWorkspace(workspace);
+    };
+    vector<thread> threads;
+    for (int t = 1; t < numThreads; t++) {
+        threads.push_back(thread(alignQueries));
     }
+    alignQueries();
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    printf("%sRead %d queries, %lld residues total.\n", printProgress ? "\n" : "", numQueries, queriesTotalLength);
 
-    if (!silent && !findAlignment) {
+    if (keepBest) {
+        // Results are printed in same order as queries are given.
         int scoreLimit = -1; // Only scores <= then scoreLimit will be printed (we consider -1 as infinity)
-        printf("\n");
-
         if (bestScores.size() > 0) {
-            printf("%d best scores:\n", static_cast<int>(bestScores.size()));
             scoreLimit = bestScores.top();
-        } else {
-            printf("Scores:\n");
         }
-
-        printf("<query number>: <score>, <num_locations>, "
-               "[(<start_location_in_target>, <end_location_in_target>)]\n");
-        for (int i = 0; i < numQueries; i++) {
-            if (scores[i] > -1 && (scoreLimit == -1 || scores[i] <= scoreLimit)) {
-                printf("#%d: %d  %d", i, scores[i], numLocations[i]);
-                if (numLocations[i] > 0) {
-                    printf("  [");
-                    for (int j = 0; j < numLocations[i]; j++) {
-                        printf(" (");
-                        if (startLocations[i]) {
-                            printf("%d", *(startLocations[i] + j));
-                        } else {
-                            printf("?");
-                        }
-                        printf(", %d)", *(endLocations[i] + j));
-                    }
-                    printf(" ]");
-                }
-                printf("\n");
+        if (!silent && !findAlignment) {
+            if (bestScores.size() > 0) {
+                printf("%d best scores:\n", static_cast<int>(bestScores.size()));
+            } else {
+                printf("Scores:\n");
             }
+            printf("<query number>: <score>, <num_locations>, "
+                   "[(<start_location_in_target>, <end_location_in_target>)]\n");
+        }
+        while (!results.empty()) {
+            const int i = results.begin()->first;
+            const EdlibAlignResult& result = results.begin()->second.result;
+            if (!silent && (scoreLimit == -1 || result.editDistance <= scoreLimit)) {
+                printResult(i, results.begin()->second);
+            }
+            releaseResult(i);
         }
-
     }
 
     clock_t finish = clock();
     double cpuTime = static_cast<double>(finish-start)/CLOCKS_PER_SEC;
+    double wallTime = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
     printf("\nCpu time of searching: %lf\n", cpuTime);
+    printf("Wall time of searching: %lf\n", wallTime);
     // ---------------------------------------------------------------------------- //
 
-    // Free allocated space
-    for (int i = 0; i < numQueries; i++) {
-        free(endLocations[i]);
-        if (startLocations[i]) free(startLocations[i]);
-    }
-    delete[] endLocations;
-    delete[] startLocations;
-    delete[] numLocations;
-    delete querySequences;
-    delete targetSequences;
-    delete[] scores;
-    
     return 0;
 }
 
 
 
 
-/** Reads sequences from fasta file.
- * @param [in] path Path to fasta file containing sequences.
- * @param [out] seqs Sequences will be stored here, each sequence as vector of letters.
+/** Opens file with sequences and prints error if it can not be read.
+ * @param [in] path Path to FASTA or FASTQ file, possibly compressed with gzip.
+ * @param [out] reader Reader that sequences will be read with.
  * @return 0 if all ok, positive number otherwise.
  */
-int readFastaSequences(const char* path, vector< vector<char> >* seqs) {
-    seqs->clear();
-    
-    FILE* file = fopen(path, "r");
-    if (file == 0)
-        return 1;
-
-    bool inHeader = false;
-    bool inSequence = false;
-    const int buffSize = 4096;
-    char buffer[buffSize];
-    while (!feof(file)) {
-        int read = fread(buffer, sizeof(char), buffSize, file);
-        for (int i = 0; i < read; ++i) {
-            char c = buffer[i];
-            if (inHeader) { // I do nothing if in header
-                if (c == '\n')
-                    inHeader = false;
-            } else {
-                if (c == '>') {
-                    inHeader = true;
-                    inSequence = false;
-                } else {
-                    if (c == '\r' || c == '\n')
-                        continue;
-                    // If starting new sequence, initialize it.
-                    if (inSequence == false) {
-                        inSequence = true;
-                        seqs->push_back(vector<char>());
-                    }
-                    seqs->back().push_back(c);
-                }
-            }
-        }
+int openSequenceFile(const char* path, SequenceReader* reader) {
+    const SequenceReader::Status status = reader->open(path);
+    if (status == SequenceReader::ERROR_OPEN) {
+        printf("Error: There is no file with name %s\n", path);
+    } else if (status == SequenceReader::ERROR_GZIP) {
+        printf("Error: File %s is compressed with gzip, but edlib-aligner was built without zlib\n", path);
     }
-
-    fclose(file);
-    return 0;
+    return status;
 }
 
 
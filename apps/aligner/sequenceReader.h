@@ -0,0 +1,283 @@
+#ifndef EDLIB_ALIGNER_SEQUENCE_READER_H
+#define EDLIB_ALIGNER_SEQUENCE_READER_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#ifdef EDLIB_ALIGNER_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * Reads sequences from FASTA or FASTQ file one by one, so they can be processed before whole file is read.
+ * Format is recognized from the first character of the file ('@' for FASTQ), and headers and qualities are skipped.
+ *
+ * Regular uncompressed files are memory mapped and lines of each sequence are joined in place,
+ * so sequences are returned as pointers into mapped memory and are not copied.
+ * Other files (pipes, and gzip compressed files if compiled with EDLIB_ALIGNER_ZLIB) are read in chunks,
+ * and sequences are copied out of them.
+ * Returned sequences are valid until they are released with release() or reader is destroyed.
+ */
+class SequenceReader {
+public:
+    // Values returned by open().
+    enum Status {
+        OK = 0,
+        ERROR_OPEN = 1,  // File can not be opened.
+        ERROR_GZIP = 2   // File is compressed with gzip, but reader is compiled without zlib.
+    };
+
+    SequenceReader()
+        : data(NULL), size(0), pos(0), eof(true), mapped(false), formatKnown(false), fastq(false),
+          file(NULL) {
+#ifdef EDLIB_ALIGNER_ZLIB
+        gzFileHandle = NULL;
+#endif
+    }
+
+    ~SequenceReader() {
+        if (mapped) munmap(data, size);
+        if (file) fclose(file);
+#ifdef EDLIB_ALIGNER_ZLIB
+        if (gzFileHandle) gzclose(gzFileHandle);
+#endif
+    }
+
+    /**
+     * @param [in] path  Path to FASTA or FASTQ file, which may be compressed with gzip.
+     * @return Status.
+     */
+    Status open(const char* path) {
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return ERROR_OPEN;
+        eof = false;
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
+            if (fileStat.st_size == 0) {
+                ::close(fd);
+                eof = true;
+                return OK;
+            }
+            // Pages are private, so joining lines in place does not modify the file.
+            void* map = mmap(NULL, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                data = static_cast<char*>(map);
+                size = fileStat.st_size;
+                if (!isGzip()) {
+                    ::close(fd);
+                    mapped = true;
+                    eof = true;
+                    madvise(data, size, MADV_SEQUENTIAL);
+                    return OK;
+                }
+                munmap(data, size);
+                data = NULL;
+                size = 0;
+            }
+        }
+
+#ifdef EDLIB_ALIGNER_ZLIB
+        // Reads uncompressed files as they are.
+        gzFileHandle = gzdopen(fd, "rb");
+        if (gzFileHandle == NULL) {
+            ::close(fd);
+            return ERROR_OPEN;
+        }
+#else
+        file = fdopen(fd, "rb");
+        if (file == NULL) {
+            ::close(fd);
+            return ERROR_OPEN;
+        }
+        readMore();
+        if (isGzip()) return ERROR_GZIP;
+#endif
+        return OK;
+    }
+
+    /**
+     * Reads next sequence. Empty sequences are skipped.
+     * @param [out] sequence  Set to point to the sequence, which is not null terminated.
+     * @param [out] sequenceLength
+     * @return True if sequence was read, false if there are no more sequences.
+     */
+    bool next(const char** sequence, int* sequenceLength) {
+        while (true) {
+            size_t start, length;
+            const ParseResult result = parseRecord(&start, &length);
+            if (result == RECORD) {
+                if (length == 0) continue;
+                if (mapped) {
+                    *sequence = data + start;
+                } else {
+                    std::vector<char> copy(data + start, data + start + length);
+                    *sequence = copy.data();
+                    copies[*sequence].swap(copy);
+                }
+                *sequenceLength = static_cast<int>(length);
+                return true;
+            }
+            if (result == END) return false;
+            readMore();  // Record is not complete.
+        }
+    }
+
+    /**
+     * Frees copy of sequence returned by next(), once sequence is not used any more.
+     * Sequences in memory mapped file are not copied, so nothing is freed for them.
+     * @param [in] sequence  Sequence returned by next().
+     */
+    void release(const char* sequence) {
+        copies.erase(sequence);
+    }
+
+private:
+    enum ParseResult { RECORD, INCOMPLETE, END };
+
+    static const size_t CHUNK_SIZE = 1 << 20;
+
+    char* data;  // Mapped file, or part of file that was read but not parsed yet.
+    size_t size;  // Size of data.
+    size_t pos;  // Position in data where parsing continues.
+    bool eof;  // True if there is nothing more to read after data.
+    bool mapped;
+    bool formatKnown;
+    bool fastq;
+
+    // Used only if file is not mapped.
+    FILE* file;
+#ifdef EDLIB_ALIGNER_ZLIB
+    gzFile gzFileHandle;
+#endif
+    std::vector<char> buffer;  // Holds data.
+    std::map< const char*, std::vector<char> > copies;  // Sequences that were returned and not released yet.
+
+    SequenceReader(const SequenceReader&);
+    SequenceReader& operator=(const SequenceReader&);
+
+    bool isGzip() const {
+        return size >= 2 && static_cast<unsigned char>(data[0]) == 0x1f
+            && static_cast<unsigned char>(data[1]) == 0x8b;
+    }
+
+    /**
+     * Moves not parsed data to the start of buffer and reads more data after it.
+     * Buffer grows geometrically, so records that do not fit in it are not parsed too many times.
+     */
+    void readMore() {
+        const size_t remaining = size - pos;
+        if (remaining > 0 && pos > 0) memmove(buffer.data(), buffer.data() + pos, remaining);
+        size = remaining;
+        pos = 0;
+        if (buffer.size() < size + CHUNK_SIZE || buffer.size() < 2 * size) {
+            buffer.resize(std::max(size + CHUNK_SIZE, 2 * size));
+        }
+        const size_t toRead = std::min(buffer.size() - size, static_cast<size_t>(INT_MAX));
+        long long numRead = 0;
+#ifdef EDLIB_ALIGNER_ZLIB
+        numRead = gzread(gzFileHandle, buffer.data() + size, static_cast<unsigned>(toRead));
+#else
+        numRead = static_cast<long long>(fread(buffer.data() + size, 1, toRead, file));
+#endif
+        if (numRead <= 0) {
+            eof = true;
+        } else {
+            size += static_cast<size_t>(numRead);
+        }
+        data = buffer.data();
+    }
+
+    /**
+     * @return Position right after the end of line that starts at or before given position,
+     *         or size if there is no end of line.
+     */
+    size_t lineEnd(const size_t from) const {
+        const void* newLine = from < size ? memchr(data + from, '\n', size - from) : NULL;
+        return newLine ? static_cast<const char*>(newLine) - data + 1 : size;
+    }
+
+    /**
+     * Removes new lines from data in range [start, end) in place.
+     * @return Number of remaining characters, which start at start.
+     */
+    size_t joinLines(const size_t start, const size_t end) {
+        size_t length = 0;
+        for (size_t i = start; i < end; i++) {
+            const char c = data[i];
+            if (c == '\r' || c == '\n') continue;
+            if (start + length != i) data[start + length] = c;  // Pages that are not modified stay shared.
+            length++;
+        }
+        return length;
+    }
+
+    /**
+     * Parses record that starts at pos. If it is complete, joins lines of its sequence and moves pos after it.
+     * @param [out] start  Position of sequence in data.
+     * @param [out] length  Length of sequence.
+     * @return RECORD if record was parsed, INCOMPLETE if more data is needed, END if there are no more records.
+     */
+    ParseResult parseRecord(size_t* const start, size_t* const length) {
+        while (pos < size && (data[pos] == '\n' || data[pos] == '\r')) pos++;
+        if (pos == size) return eof ? END : INCOMPLETE;
+        if (!formatKnown) {
+            fastq = data[pos] == '@';
+            formatKnown = true;
+        }
+
+        size_t i = pos;
+        if (fastq || data[i] == '>') {  // Skip header.
+            i = lineEnd(i);
+            if (i == size && !eof) return INCOMPLETE;
+        }
+        const size_t sequenceStart = i;
+
+        if (!fastq) {
+            // Sequence ends where next header starts.
+            while (i < size && data[i] != '>') {
+                i = lineEnd(i);
+            }
+            if (i == size && !eof) return INCOMPLETE;
+            *start = sequenceStart;
+            *length = joinLines(sequenceStart, i);
+            pos = i;
+            return RECORD;
+        }
+
+        // Sequence ends with line that starts with '+', after which there are as many quality characters.
+        size_t sequenceLength = 0;
+        while (i < size && data[i] != '+') {
+            const size_t next = lineEnd(i);
+            for (size_t j = i; j < next; j++) {
+                sequenceLength += data[j] != '\n' && data[j] != '\r';
+            }
+            i = next;
+        }
+        const size_t sequenceEnd = i;
+        i = lineEnd(i);  // Skip '+' line.
+        size_t qualityLength = 0;
+        while (i < size && qualityLength < sequenceLength) {
+            qualityLength += data[i] != '\n' && data[i] != '\r';
+            i++;
+        }
+        if (qualityLength == sequenceLength) {
+            i = lineEnd(i);
+        }
+        if (i == size && !eof) return INCOMPLETE;
+        *start = sequenceStart;
+        *length = joinLines(sequenceStart, sequenceEnd);
+        pos = i;
+        return RECORD;
+    }
+};
+
+#endif // EDLIB_ALIGNER_SEQUENCE_READER_H
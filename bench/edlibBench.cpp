@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "edlib.h"
+
+using namespace std;
+
+// Microbenchmarks of edlibAlign() for all modes and tasks, over a range of query lengths,
+// divergences of target from query, and with fixed or automatically determined k.
+// Use --benchmark_format=json or --benchmark_out=<file> to get machine readable results,
+// and --benchmark_filter=<regex> to run only some of the benchmarks.
+
+namespace {
+
+struct Sequences {
+    vector<char> query;
+    vector<char> target;
+    int numEdits;  // Number of edits made to query, which is upper bound of edit distance.
+};
+
+const char ALPHABET[] = "ACGT";
+
+/**
+ * Makes given number of random substitutions, insertions and deletions in sequence.
+ */
+vector<char> mutate(const vector<char>& sequence, const int numEdits, mt19937& generator) {
+    vector<char> mutated(sequence);
+    for (int i = 0; i < numEdits; i++) {
+        const int position = static_cast<int>(generator() % (mutated.size() + 1));
+        const char letter = ALPHABET[generator() % 4];
+        switch (generator() % 3) {
+            case 0:
+                if (position < static_cast<int>(mutated.size())) mutated[position] = letter;
+                break;
+            case 1:
+                mutated.insert(mutated.begin() + position, letter);
+                break;
+            default:
+                if (position < static_cast<int>(mutated.size())) mutated.erase(mutated.begin() + position);
+        }
+    }
+    return mutated;
+}
+
+vector<char> randomSequence(const int length, mt19937& generator) {
+    vector<char> sequence(length);
+    for (int i = 0; i < length; i++) sequence[i] = ALPHABET[generator() % 4];
+    return sequence;
+}
+
+/**
+ * Returns query of given length and target that contains mutated query, as expected by given mode:
+ * for NW target is just mutated query, for SHW it is followed by random sequence,
+ * and for HW random sequences are both before and after it.
+ * Sequences are generated from fixed seed and cached, so all benchmarks and runs use the same ones.
+ */
+const Sequences& getSequences(const int queryLength, const int divergence, const EdlibAlignMode mode) {
+    static map<tuple<int, int, int>, Sequences> cache;
+    const tuple<int, int, int> key(queryLength, divergence, mode);
+    auto it = cache.find(key);
+    if (it != cache.end()) return it->second;
+
+    mt19937 generator(static_cast<uint32_t>(queryLength * 100 + divergence));
+    Sequences sequences;
+    sequences.query = randomSequence(queryLength, generator);
+    sequences.numEdits = static_cast<int>(static_cast<long long>(queryLength) * divergence / 100);
+    const vector<char> mutated = mutate(sequences.query, sequences.numEdits, generator);
+    if (mode == EDLIB_MODE_HW) {
+        sequences.target = randomSequence(queryLength / 2, generator);
+    }
+    sequences.target.insert(sequences.target.end(), mutated.begin(), mutated.end());
+    if (mode != EDLIB_MODE_NW) {
+        const vector<char> suffix = randomSequence(mode == EDLIB_MODE_HW ? queryLength / 2 : queryLength, generator);
+        sequences.target.insert(sequences.target.end(), suffix.begin(), suffix.end());
+    }
+    return cache.emplace(key, move(sequences)).first->second;
+}
+
+/**
+ * Arguments are query length, divergence in percents and whether k is fixed.
+ * Fixed k is the number of edits made to query, otherwise k is -1.
+ */
+void BM_Align(benchmark::State& state, const EdlibAlignMode mode, const EdlibAlignTask task) {
+    const int queryLength = static_cast<int>(state.range(0));
+    const Sequences& sequences = getSequences(queryLength, static_cast<int>(state.range(1)), mode);
+    const int targetLength = static_cast<int>(sequences.target.size());
+    const int k = state.range(2) ? sequences.numEdits : -1;
+    const EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, NULL, 0);
+
+    int editDistance = -1;
+    for (auto _ : state) {
+        EdlibAlignResult result = edlibAlign(sequences.query.data(), queryLength,
+                                             sequences.target.data(), targetLength, config);
+        editDistance = result.editDistance;
+        benchmark::DoNotOptimize(result.endLocations);
+        edlibFreeAlignResult(result);
+    }
+    if (editDistance < 0) {
+        state.SkipWithError("Alignment not found");
+        return;
+    }
+    state.counters["editDistance"] = editDistance;
+    // Cells of full dynamic programming matrix per second, so results of different lengths can be compared.
+    state.counters["cells"] = benchmark::Counter(static_cast<double>(queryLength) * targetLength,
+                                                 benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void registerBenchmarks() {
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    const char* modeNames[] = {"NW", "SHW", "HW"};
+    const EdlibAlignTask tasks[] = {EDLIB_TASK_DISTANCE, EDLIB_TASK_LOC, EDLIB_TASK_PATH};
+    const char* taskNames[] = {"DISTANCE", "LOC", "PATH"};
+    for (int i = 0; i < 3; i++) {
+        // In HW mode band is not limited to diagonal, so whole query is calculated on most of target,
+        // which takes a minute for 1M query.
+        const vector<int64_t> queryLengths = modes[i] == EDLIB_MODE_HW
+            ? vector<int64_t>({30, 1000, 100000}) : vector<int64_t>({30, 1000, 100000, 1000000});
+        for (int j = 0; j < 3; j++) {
+            const string name = string("Align/") + modeNames[i] + "/" + taskNames[j];
+            benchmark::RegisterBenchmark(name.c_str(), BM_Align, modes[i], tasks[j])
+                ->ArgsProduct({queryLengths, {1, 10}, {0, 1}})
+                ->ArgNames({"query", "divergence", "fixedK"})
+                ->Unit(benchmark::kMicrosecond);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    registerBenchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
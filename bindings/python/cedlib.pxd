@@ -36,4 +36,12 @@ cdef extern from "edlib.h" nogil:
                                  const char* target, int targetLength,
                                  const EdlibAlignConfig config)
 
+     void edlibAlignPairs(const char* const* queries, const int* queryLengths,
+                          const char* const* targets, const int* targetLengths, int numPairs,
+                          const EdlibAlignConfig config, int numThreads,
+                          EdlibAlignResult* results)
+
      char* edlibAlignmentToCigar(const unsigned char* alignment, int alignmentLength, EdlibCigarFormat cigarFormat)
+
+     int edlibAlignmentToCigarBuffer(const unsigned char* alignment, int alignmentLength,
+                                     EdlibCigarFormat cigarFormat, char* cigar, int cigarCapacity)
@@ -1,5 +1,8 @@
 cimport cython
 from cpython.mem cimport PyMem_Malloc, PyMem_Free
+from cpython.buffer cimport PyObject_GetBuffer, PyBuffer_Release, PyBUF_FORMAT, PyBUF_C_CONTIGUOUS
+from libc.limits cimport INT_MAX
+from libcpp.vector cimport vector
 import re
 
 cimport cedlib
@@ -53,6 +56,39 @@ def _map_to_bytes(query, target, additional_equalities):
     return query_bytes, target_bytes, additional_equalities
 
 
+cdef cedlib.EdlibAlignConfig _build_config(mode, task, k, additionalEqualities,
+                                          cedlib.EdlibEqualityPair** c_additionalEqualities) except *:
+    """ Build an edlib config object based on given parameters of align().
+    If there are additional equalities, they are allocated into c_additionalEqualities,
+    which caller has to free with PyMem_Free once config is not used any more.
+    """
+    cconfig = cedlib.edlibDefaultAlignConfig()
+
+    if k is not None: cconfig.k = k
+
+    if mode == 'NW': cconfig.mode = cedlib.EDLIB_MODE_NW
+    if mode == 'HW': cconfig.mode = cedlib.EDLIB_MODE_HW
+    if mode == 'SHW': cconfig.mode = cedlib.EDLIB_MODE_SHW
+
+    if task == 'distance': cconfig.task = cedlib.EDLIB_TASK_DISTANCE
+    if task == 'locations': cconfig.task = cedlib.EDLIB_TASK_LOC
+    if task == 'path': cconfig.task = cedlib.EDLIB_TASK_PATH
+
+    c_additionalEqualities[0] = NULL
+    if additionalEqualities is None:
+        cconfig.additionalEqualities = NULL
+        cconfig.additionalEqualitiesLength = 0
+    else:
+        c_additionalEqualities[0] = <cedlib.EdlibEqualityPair*> PyMem_Malloc(
+            len(additionalEqualities) * cython.sizeof(cedlib.EdlibEqualityPair))
+        for i in range(len(additionalEqualities)):
+            c_additionalEqualities[0][i].first = bytearray(additionalEqualities[i][0].encode('utf-8'))[0]
+            c_additionalEqualities[0][i].second = bytearray(additionalEqualities[i][1].encode('utf-8'))[0]
+        cconfig.additionalEqualities = c_additionalEqualities[0]
+        cconfig.additionalEqualitiesLength = len(additionalEqualities)
+    return cconfig
+
+
 def align(query, target, mode="NW", task="distance", k=-1, additionalEqualities=None):
     """ Align query with target using edit distance.
     @param {str or bytes or iterable of hashable objects} query, combined with target must have no more
@@ -95,32 +131,8 @@ def align(query, target, mode="NW", task="distance", k=-1, additionalEqualities=
     cdef char* ctarget = target_bytes;
 
     # Build an edlib config object based on given parameters.
-    cconfig = cedlib.edlibDefaultAlignConfig()
-
-    if k is not None: cconfig.k = k
-
-    if mode == 'NW': cconfig.mode = cedlib.EDLIB_MODE_NW
-    if mode == 'HW': cconfig.mode = cedlib.EDLIB_MODE_HW
-    if mode == 'SHW': cconfig.mode = cedlib.EDLIB_MODE_SHW
-
-    if task == 'distance': cconfig.task = cedlib.EDLIB_TASK_DISTANCE
-    if task == 'locations': cconfig.task = cedlib.EDLIB_TASK_LOC
-    if task == 'path': cconfig.task = cedlib.EDLIB_TASK_PATH
-
-    cdef bytes tmp_bytes;
-    cdef char* tmp_cstring;
     cdef cedlib.EdlibEqualityPair* c_additionalEqualities = NULL
-    if additionalEqualities is None:
-        cconfig.additionalEqualities = NULL
-        cconfig.additionalEqualitiesLength = 0
-    else:
-        c_additionalEqualities = <cedlib.EdlibEqualityPair*> PyMem_Malloc(len(additionalEqualities)
-                                                                          * cython.sizeof(cedlib.EdlibEqualityPair))
-        for i in range(len(additionalEqualities)):
-            c_additionalEqualities[i].first = bytearray(additionalEqualities[i][0].encode('utf-8'))[0]
-            c_additionalEqualities[i].second = bytearray(additionalEqualities[i][1].encode('utf-8'))[0]
-        cconfig.additionalEqualities = c_additionalEqualities
-        cconfig.additionalEqualitiesLength = len(additionalEqualities)
+    cconfig = _build_config(mode, task, k, additionalEqualities, &c_additionalEqualities)
 
     # Run alignment -- need to get len before disabling the GIL
     query_len = len(query)
@@ -155,6 +167,147 @@ def align(query, target, mode="NW", task="distance", k=-1, additionalEqualities=
     return result
 
 
+cdef _get_sequence_buffer(sequence, Py_buffer* view):
+    """ Get buffer with bytes of sequence for align_many(), which has to be released with PyBuffer_Release.
+    Buffer has to be contiguous and consist of single byte elements, since each of them is one character.
+    """
+    if isinstance(sequence, str):
+        try:
+            sequence = _map_ascii_string(sequence)
+        except NeedsAlphabetMapping:
+            raise ValueError("align_many() supports only ASCII strings, use align() for other strings.")
+    PyObject_GetBuffer(sequence, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS)
+    if view.itemsize != 1:
+        PyBuffer_Release(view)
+        raise ValueError("Sequence has elements of %d bytes, but only single byte elements are supported."
+                         % view.itemsize)
+    if view.len > INT_MAX:
+        PyBuffer_Release(view)
+        raise ValueError("Sequence is too long.")
+
+
+def align_many(queries, targets, mode="NW", task="distance", k=-1, additionalEqualities=None, threads=1):
+    """ Align each query with target at the same index, same as align() would, but in multiple threads.
+    It is much faster than calling align() for each pair, since all alignments are done without the GIL,
+    and results are returned as NumPy arrays instead of dictionary for each pair, so NumPy is needed.
+    @param {list or array} queries  Sequences that are aligned, each one is ASCII str, bytes,
+           or any object that supports buffer protocol with single byte elements and is contiguous,
+           e.g. bytearray or NumPy array of uint8.
+           NumPy array of bytes (e.g. dtype 'S100') or 2D NumPy array (with sequence in each row) work too.
+    @param {list or array} targets  Same as queries, of same length.
+    @param {string} mode  Optional. Same as for align().
+    @param {string} task  Optional. Same as for align().
+    @param {int} k  Optional. Same as for align().
+    @param {list} additionalEqualities  Optional. Same as for align(), but only with single byte characters.
+    @param {int} threads  Optional. Number of threads that alignments are done in. Default is 1.
+    @return Dictionary with following fields, each having value for each pair:
+            {numpy.ndarray of int32} editDistance  -1 if it is larger than k.
+            {numpy.ndarray of int32} alphabetLength
+            {numpy.ndarray of int32} start  Start of first location in target, -1 if task is 'distance'.
+            {numpy.ndarray of int32} end  End of first location in target, -1 if there is no location.
+            {numpy.ndarray of objects} cigar  Cigar of alignment in extended format, same as from align(),
+                or None if task is not 'path'.
+    """
+    import numpy
+
+    num_pairs = len(queries)
+    if len(targets) != num_pairs:
+        raise ValueError("queries and targets must have same length.")
+    if threads < 1:
+        raise ValueError("threads must be at least 1.")
+
+    # Buffers of sequences are held until alignments are done, since edlib reads sequences from them.
+    cdef vector[Py_buffer] buffers
+    buffers.reserve(2 * num_pairs)
+    cdef vector[const char*] cqueries
+    cdef vector[int] query_lengths
+    cdef vector[const char*] ctargets
+    cdef vector[int] target_lengths
+    cdef vector[cedlib.EdlibAlignResult] cresults
+    cdef cedlib.EdlibEqualityPair* c_additionalEqualities = NULL
+    cdef cedlib.EdlibAlignConfig cconfig
+    cdef Py_buffer view
+    cdef int cnum_pairs = num_pairs
+    cdef int cthreads = threads
+    cdef int i
+    cdef size_t j
+    try:
+        for query, target in zip(queries, targets):
+            _get_sequence_buffer(query, &view)
+            buffers.push_back(view)
+            cqueries.push_back(<const char*> view.buf)
+            query_lengths.push_back(view.len)
+            _get_sequence_buffer(target, &view)
+            buffers.push_back(view)
+            ctargets.push_back(<const char*> view.buf)
+            target_lengths.push_back(view.len)
+
+        cconfig = _build_config(mode, task, k, additionalEqualities, &c_additionalEqualities)
+        cresults.resize(num_pairs)
+        with nogil:
+            cedlib.edlibAlignPairs(cqueries.data(), query_lengths.data(), ctargets.data(), target_lengths.data(),
+                                   cnum_pairs, cconfig, cthreads, cresults.data())
+    finally:
+        if c_additionalEqualities != NULL: PyMem_Free(c_additionalEqualities)
+        for j in range(buffers.size()):
+            PyBuffer_Release(&buffers[j])
+
+    # Build arrays with results from result objects that edlib returned.
+    edit_distances = numpy.empty(num_pairs, dtype=numpy.int32)
+    alphabet_lengths = numpy.empty(num_pairs, dtype=numpy.int32)
+    starts = numpy.empty(num_pairs, dtype=numpy.int32)
+    ends = numpy.empty(num_pairs, dtype=numpy.int32)
+    cigars = numpy.empty(num_pairs, dtype=object)
+    cdef int[::1] cedit_distances = edit_distances
+    cdef int[::1] calphabet_lengths = alphabet_lengths
+    cdef int[::1] cstarts = starts
+    cdef int[::1] cends = ends
+    # Cigar of each alignment is written into the same buffer, which is enlarged when needed.
+    cdef int cigar_capacity = 0
+    cdef char* ccigar = NULL
+    cdef int cigar_length
+    cdef bint failed = False
+    try:
+        for i in range(cnum_pairs):
+            failed = failed or cresults[i].status == 1
+            cedit_distances[i] = cresults[i].editDistance
+            calphabet_lengths[i] = cresults[i].alphabetLength
+            cstarts[i] = -1
+            cends[i] = -1
+            if cresults[i].numLocations > 0:
+                if cresults[i].startLocations: cstarts[i] = cresults[i].startLocations[0]
+                if cresults[i].endLocations: cends[i] = cresults[i].endLocations[0]
+            if cresults[i].alignment:
+                cigar_length = cedlib.edlibAlignmentToCigarBuffer(cresults[i].alignment, cresults[i].alignmentLength,
+                                                                  cedlib.EDLIB_CIGAR_EXTENDED, ccigar, cigar_capacity)
+                if cigar_length >= cigar_capacity:
+                    PyMem_Free(ccigar)
+                    cigar_capacity = 2 * cigar_length + 1
+                    ccigar = <char*> PyMem_Malloc(cigar_capacity)
+                    if ccigar == NULL:
+                        raise MemoryError()
+                    cedlib.edlibAlignmentToCigarBuffer(cresults[i].alignment, cresults[i].alignmentLength,
+                                                       cedlib.EDLIB_CIGAR_EXTENDED, ccigar, cigar_capacity)
+                cigars[i] = ccigar[:cigar_length].decode('UTF-8')
+            else:
+                cigars[i] = None
+    finally:
+        PyMem_Free(ccigar)
+        for i in range(cnum_pairs):
+            cedlib.edlibFreeAlignResult(cresults[i])
+
+    if failed:
+        raise Exception("There was an error.")
+
+    return {
+        'editDistance': edit_distances,
+        'alphabetLength': alphabet_lengths,
+        'start': starts,
+        'end': ends,
+        'cigar': cigars
+    }
+
+
 def getNiceAlignment(alignResult, query, target, gapSymbol="-"):
     """ Output alignments from align() in NICE format
     @param {dictionary} alignResult, output of the method align() 
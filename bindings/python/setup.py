@@ -43,6 +43,7 @@ setup(
                              depends=["edlib/include/edlib.h"],
                              language="c++",
                              compiler_directives={'language_level': '3'},
-                             extra_compile_args=["-O3", "-std=c++11"])],
+                             extra_compile_args=["-O3", "-std=c++11", "-pthread"],
+                             extra_link_args=["-pthread"])],
     cmdclass = cmdclass
 )
@@ -1,4 +1,5 @@
 import sys
+import numpy as np
 import edlib
 
 testFailed = False
@@ -79,6 +80,43 @@ long_seq2 = long_alphabet + long_alphabet[::-1] + long_alphabet
 result = edlib.align(long_seq1, long_seq2)
 testFailed = testFailed or (not (result and result["editDistance"] == 256))
 
+# Aligning many pairs.
+queries = ["telephone", "ACTG", "AACG", ""]
+targets = ["elephant", "CACTRT", "TCAACCTG", "elephant"]
+# Sequences can also be given as bytes or any other object that supports buffer protocol.
+buffer_queries = ["telephone", b"ACTG", bytearray(b"AACG"), ""]
+buffer_targets = ["elephant", b"CACTRT", memoryview(b"TCAACCTG"), b"elephant"]
+for mode in ["NW", "HW"]:
+    for threads in [1, 3]:
+        results = edlib.align_many(buffer_queries, buffer_targets, mode=mode, task="path", threads=threads)
+        for i in range(len(queries)):
+            result = edlib.align(queries[i], targets[i], mode=mode, task="path")
+            start, end = result["locations"][0] if result["locations"] else (None, None)
+            testFailed = testFailed or (not (results["editDistance"][i] == result["editDistance"]
+                                             and results["start"][i] == (-1 if start is None else start)
+                                             and results["end"][i] == (-1 if end is None else end)
+                                             and results["cigar"][i] == result["cigar"]))
+results = edlib.align_many(["ACTG"], ["CACTRT"], mode="HW", additionalEqualities=[("R", "A"), ("R", "G")])
+testFailed = testFailed or (not (results["editDistance"][0] == 0 and results["cigar"][0] is None))
+results = edlib.align_many([], [])
+testFailed = testFailed or (not (len(results["editDistance"]) == 0))
+# NumPy arrays, with sequence in each row or in each element.
+uint8_queries = np.frombuffer(b"ACGTACGA", dtype=np.uint8).reshape(2, 4)
+results = edlib.align_many(uint8_queries, np.array([b"ACGTT", b"TACGAT"]), mode="HW", task="path")
+testFailed = testFailed or (not (list(results["editDistance"]) == [0, 0] and list(results["end"]) == [3, 4]
+                                 and list(results["cigar"]) == ["4=", "4="]))
+try:
+    edlib.align_many(["telephone"], ["elephant", "telephone"])
+    testFailed = True
+except ValueError:
+    pass
+# Elements of more than one byte are not taken as characters.
+try:
+    edlib.align_many(np.array([[1, 2, 3]], np.int32), np.array([[1, 2, 3]], np.int32))
+    testFailed = True
+except ValueError:
+    pass
+
 if testFailed:
     print("Some of the tests failed!")
 else:
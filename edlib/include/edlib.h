@@ -22,6 +22,8 @@
 #    define EDLIB_API
 #endif
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -30,6 +32,9 @@ extern "C" {
 #define EDLIB_STATUS_OK 0
 #define EDLIB_STATUS_ERROR 1
 
+// Default of EdlibAlignConfig.tracebackMemoryBudget, in bytes.
+#define EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET (1024 * 1024)
+
     /**
      * Alignment methods - how should Edlib treat gaps before and after query?
      */
@@ -80,12 +85,46 @@ extern "C" {
         EDLIB_CIGAR_EXTENDED   //!< Match: '=', Insertion: 'I', Deletion: 'D', Mismatch: 'X'.
     } EdlibCigarFormat;
 
+    /**
+     * Algorithm used to find edit distance and end locations.
+     */
+    typedef enum {
+        /**
+         * Myers' bit-vector algorithm, which takes O(n * k / w) time (w is 32 or 64), k being edit distance.
+         * This is the default.
+         */
+        EDLIB_ENGINE_BIT_VECTOR,
+        /**
+         * Diagonal transition is tried first for EDLIB_MODE_NW and EDLIB_MODE_SHW when query is longer than 64,
+         * but only up to edit distance for which it is expected to be faster
+         * (square root of 8 times query length, e.g. 900 for query of length 100000).
+         * If edit distance is larger, bit-vector algorithm is used.
+         * It pays off for long and very similar sequences, but when they are not similar, time spent on trying
+         * diagonal transition is wasted, so it is slower than EDLIB_ENGINE_BIT_VECTOR then.
+         */
+        EDLIB_ENGINE_AUTO,
+        /**
+         * Diagonal transition (Ukkonen's and Myers' O(ND) algorithm), which takes O(n + k^2) time
+         * for EDLIB_MODE_NW and EDLIB_MODE_SHW, so it is faster for very similar long sequences.
+         * For EDLIB_MODE_HW it takes O(n * k) time, since alignment can start on any diagonal.
+         */
+        EDLIB_ENGINE_DIAGONAL_TRANSITION
+    } EdlibAlignEngine;
+
 // Edit operations.
 #define EDLIB_EDOP_MATCH 0    //!< Match.
 #define EDLIB_EDOP_INSERT 1   //!< Insertion to target = deletion from query.
 #define EDLIB_EDOP_DELETE 2   //!< Deletion from target = insertion to query.
 #define EDLIB_EDOP_MISMATCH 3 //!< Mismatch.
 
+    /**
+     * Run of same consecutive edit operations in alignment (see EdlibAlignConfig.runLengthAlignment).
+     */
+    typedef struct {
+        unsigned char operation;  //!< One of EDLIB_EDOP_MATCH, EDLIB_EDOP_INSERT, EDLIB_EDOP_DELETE, EDLIB_EDOP_MISMATCH.
+        int length;  //!< Number of operations in run.
+    } EdlibAlignmentRun;
+
     /**
      * @brief Defines two given characters as equal.
      */
@@ -94,6 +133,98 @@ extern "C" {
         char second;
     } EdlibEqualityPair;
 
+    /**
+     * Costs of affine gap scoring: match costs 0, mismatch costs mismatch, and gap of length L
+     * (L insertions or L deletions one after another) costs gapOpen + L * gapExtend.
+     * Edit distance is the same as cost with mismatch = 1, gapOpen = 0 and gapExtend = 1.
+     */
+    typedef struct {
+        int mismatch;  //!< Non-negative.
+        int gapOpen;  //!< Non-negative.
+        int gapExtend;  //!< Positive.
+    } EdlibAffineCosts;
+
+    /**
+     * Memory that edlib reuses between alignments, so it does not have to allocate it again for each of them.
+     * Create it with edlibCreateWorkspace() and free it with edlibFreeWorkspace().
+     * Workspace can be used by only one alignment at a time, so use one workspace per thread.
+     */
+    typedef struct EdlibWorkspace EdlibWorkspace;
+
+    /**
+     * Statistics of work done in one phase of alignment.
+     */
+    typedef struct {
+        /**
+         * Number of calculated blocks, where block consists of blockSize cells of one column
+         * of dynamic programming matrix.
+         */
+        long long numBlocks;
+        /**
+         * Largest number of blocks calculated in one column, that is largest width of Ukkonen band.
+         */
+        int maxBandBlocks;
+        /**
+         * Time spent in this phase, in nanoseconds.
+         */
+        long long nanoseconds;
+    } EdlibPhaseStats;
+
+    /**
+     * Statistics of work done by edlibAlign(), which help to choose k and to find why alignment is slow.
+     * To obtain them, set stats in configuration.
+     */
+    typedef struct {
+        /**
+         * Number of cells in block: 32 for short queries and 64 for the rest, 1 with affine gap costs.
+         */
+        int blockSize;
+        /**
+         * Engine that found edit distance and end locations.
+         * It is EDLIB_ENGINE_AUTO with affine gap costs, for which neither of engines is used.
+         */
+        EdlibAlignEngine engine;
+        /**
+         * Number of times edit distance was calculated with bit-vector algorithm, or 1 if it was found
+         * with diagonal transition. If k is not given, it starts from blockSize (or right above distance
+         * that diagonal transition gave up at) and is doubled until edit distance is found (after the first
+         * round it may be increased more, to estimate of edit distance), otherwise it is 1.
+         */
+        int numKRounds;
+        /**
+         * k used in the last calculation of edit distance.
+         */
+        int k;
+        /**
+         * Finding edit distance and end locations, in all rounds.
+         */
+        EdlibPhaseStats distance;
+        /**
+         * Finding start locations, which is done on reversed sequences in EDLIB_MODE_HW
+         * (with EDLIB_TASK_LOC or EDLIB_TASK_PATH).
+         */
+        EdlibPhaseStats start;
+        /**
+         * Finding alignment paths (EDLIB_TASK_PATH).
+         */
+        EdlibPhaseStats alignment;
+        /**
+         * Number of levels of recursion of Hirschberg's algorithm, which is used to find alignment path
+         * of long sequences. 0 if it was not used.
+         */
+        int hirschbergDepth;
+        /**
+         * Total size of temporary memory allocated from workspace, in bytes.
+         * Memory that was released and allocated again is counted each time.
+         */
+        long long bytesAllocated;
+        /**
+         * Largest size of temporary memory allocated from workspace that was in use at the same time, in bytes.
+         * When threads are used, memory used by all of them at the same time is counted.
+         */
+        long long peakBytes;
+    } EdlibAlignStats;
+
     /**
      * @brief Configuration object for edlibAlign() function.
      */
@@ -137,11 +268,90 @@ extern "C" {
          * 0 if there are none.
          */
         int additionalEqualitiesLength;
+
+        /**
+         * Workspace from which edlib allocates temporary memory, which speeds up aligning many
+         * (especially short) sequences one after another.
+         * Can be set to NULL, in which case edlib allocates and frees temporary memory on each call.
+         */
+        EdlibWorkspace* workspace;
+
+        /**
+         * Number of threads used to find alignment path (EDLIB_TASK_PATH) of long sequences,
+         * for which Hirschberg's algorithm is used: its halves and sub-problems are then calculated in parallel.
+         * 1 by default, which means that everything is calculated in the calling thread.
+         */
+        int numThreads;
+
+        /**
+         * Sub-problems of Hirschberg's algorithm with target shorter than this are not split between threads,
+         * since starting a thread would take more time than it saves.
+         * Used only if numThreads is larger than 1.
+         */
+        int parallelCutoff;
+
+        /**
+         * Maximal size of memory, in bytes, used to store band of dynamic programming matrix, from which
+         * alignment path (EDLIB_TASK_PATH) is found with traceback. If more is needed, only every
+         * sqrt(targetLength)-th column is stored and band is calculated again in segments between them,
+         * which calculates matrix about twice. If even that does not fit, problem is split into smaller ones
+         * with Hirschberg's algorithm, which needs memory only for a few columns but calculates matrix
+         * about log(targetLength) times. Larger budget makes finding alignment path of long sequences faster,
+         * while smaller one lowers peak memory (see EdlibAlignStats.peakBytes).
+         * EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET by default, which is used also if it is 0 or less.
+         * With affine gap costs, band is always stored whole, and if it would not fit into budget,
+         * status of result is EDLIB_STATUS_ERROR.
+         */
+        long long tracebackMemoryBudget;
+
+        /**
+         * Maximal number of optimal alignment paths to find with EDLIB_TASK_PATH, one for each of
+         * first maxAlignments pairs of start and end locations.
+         * 1 by default (0 is also treated as 1). Set to negative value to find alignment paths for all locations.
+         * Since all locations have the same score, this is much faster than aligning again to each of them.
+         */
+        int maxAlignments;
+
+        /**
+         * If set to 1, alignment paths are returned as runs of same operations in alignmentRuns of result,
+         * and alignment of result is NULL, so memory for one operation per column is not needed for result.
+         * Paths are found into temporary memory of workspace instead, which is reused from call to call.
+         * 0 by default.
+         */
+        int runLengthAlignment;
+
+        /**
+         * If set, edlibAlign() and edlibAlignWithProfile() fill it with statistics of the alignment
+         * (edlibAlignMany() fills it for each target, before calling callback).
+         * Other functions ignore it. NULL by default.
+         */
+        EdlibAlignStats* stats;
+
+        /**
+         * Algorithm used to find edit distance, see EdlibAlignEngine. Start locations and alignment path
+         * are found in the same way for all of them, so all give the same results.
+         * EDLIB_ENGINE_BIT_VECTOR by default.
+         */
+        EdlibAlignEngine engine;
+
+        /**
+         * If set, alignment with the lowest affine gap cost is found instead of alignment with the lowest
+         * edit distance, and editDistance in result is set to that cost (k also limits it).
+         * Mode tells which gaps before and after query are free, same as for edit distance.
+         * It is calculated with banded dynamic programming (Gotoh's algorithm), which is slower than
+         * calculation of edit distance, so it is best used on regions found by edit distance.
+         * Used by edlibAlign(), edlibAlignWithProfile(), edlibAlignBatch() and functions that use them,
+         * while edlibFindHits(), edlibCreateStreamSearch() and edlibAlign64() for targets longer than
+         * 2^20 characters fail if it is set. If costs are not valid, status of result is EDLIB_STATUS_ERROR.
+         * NULL by default.
+         */
+        const EdlibAffineCosts* affineCosts;
     } EdlibAlignConfig;
 
     /**
      * Helper method for easy construction of configuration object.
-     * @return Configuration object filled with given parameters.
+     * @return Configuration object filled with given parameters, other fields are set to their defaults
+     *         (see edlibDefaultAlignConfig()).
      */
     EDLIB_API EdlibAlignConfig edlibNewAlignConfig(
         int k, EdlibAlignMode mode, EdlibAlignTask task,
@@ -151,10 +361,25 @@ extern "C" {
 
     /**
      * @return Default configuration object, with following defaults:
-     *         k = -1, mode = EDLIB_MODE_NW, task = EDLIB_TASK_DISTANCE, no additional equalities.
+     *         k = -1, mode = EDLIB_MODE_NW, task = EDLIB_TASK_DISTANCE, no additional equalities,
+     *         no workspace, numThreads = 1, parallelCutoff = 10000,
+     *         tracebackMemoryBudget = EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET, maxAlignments = 1,
+     *         runLengthAlignment = 0, no stats, engine = EDLIB_ENGINE_BIT_VECTOR,
+     *         no affine costs.
      */
     EDLIB_API EdlibAlignConfig edlibDefaultAlignConfig(void);
 
+    /**
+     * @return  Empty workspace, that grows as needed while aligning.
+     *          Make sure to free it using edlibFreeWorkspace().
+     */
+    EDLIB_API EdlibWorkspace* edlibCreateWorkspace(void);
+
+    /**
+     * Frees workspace that was created with edlibCreateWorkspace().
+     */
+    EDLIB_API void edlibFreeWorkspace(EdlibWorkspace* workspace);
+
 
     /**
      * Container for results of alignment done by edlibAlign() function.
@@ -194,6 +419,8 @@ extern "C" {
 
         /**
          * Alignment is found for first pair of start and end locations.
+         * If more alignments were requested (see EdlibAlignConfig.maxAlignments), alignments for the following
+         * pairs of locations are stored after it, one after another, with their lengths in alignmentLengths.
          * Set to NULL if not calculated.
          * Alignment is sequence of numbers: 0, 1, 2, 3.
          * 0 stands for match.
@@ -207,7 +434,7 @@ extern "C" {
         unsigned char* alignment;
 
         /**
-         * Length of alignment.
+         * Length of alignment (of the first one, if there are more).
          */
         int alignmentLength;
 
@@ -215,6 +442,34 @@ extern "C" {
          * Number of different characters in query and target together.
          */
         int alphabetLength;
+
+        /**
+         * Array of lengths of alignments found for first numAlignments pairs of start and end locations.
+         * Alignment for i-th pair starts right after the alignments for previous pairs end.
+         * Set to NULL if alignment is not calculated.
+         * If you do not free whole result object using edlibFreeAlignResult(), do not forget to use free().
+         */
+        int* alignmentLengths;
+
+        /**
+         * Number of alignments, which is at most numLocations. 0 if alignment is not calculated.
+         */
+        int numAlignments;
+
+        /**
+         * Alignments as runs of same operations, set instead of alignment if
+         * EdlibAlignConfig.runLengthAlignment is set. Runs of alignments for following pairs of locations
+         * are stored after runs of first one, with numbers of runs of each alignment in alignmentNumRuns.
+         * alignmentLength and alignmentLengths are set as usual. Set to NULL if not calculated.
+         * If you do not free whole result object using edlibFreeAlignResult(), do not forget to use free().
+         */
+        EdlibAlignmentRun* alignmentRuns;
+
+        /**
+         * Array of numbers of runs of each of numAlignments alignments. Set to NULL if alignmentRuns is NULL.
+         * If you do not free whole result object using edlibFreeAlignResult(), do not forget to use free().
+         */
+        int* alignmentNumRuns;
     } EdlibAlignResult;
 
     /**
@@ -245,6 +500,354 @@ extern "C" {
         const EdlibAlignConfig config
     );
 
+    /**
+     * Same as EdlibAlignResult, but with 64-bit locations, as returned by edlibAlign64().
+     */
+    typedef struct {
+        int status;
+        int editDistance;
+        long long* endLocations;
+        long long* startLocations;
+        int numLocations;
+        unsigned char* alignment;
+        int alignmentLength;
+        int alphabetLength;
+        int* alignmentLengths;
+        int numAlignments;
+        EdlibAlignmentRun* alignmentRuns;
+        int* alignmentNumRuns;
+    } EdlibAlignResult64;
+
+    /**
+     * Frees memory in EdlibAlignResult64 that was allocated by edlib.
+     */
+    EDLIB_API void edlibFreeAlignResult64(EdlibAlignResult64 result);
+
+    /**
+     * Same as edlibAlign(), but target can be longer than what fits into int, e.g. whole chromosome.
+     * Results are same as those of edlibAlign(), only with 64-bit locations.
+     *
+     * Long target is never transformed or copied as a whole: it is processed in parts, and only parts of it
+     * around end locations are used to find start locations and alignment paths.
+     * Since alignment path in those parts is at most queryLength + editDistance long, query still has to
+     * fit into int, and so has to target for EDLIB_MODE_NW (otherwise status is EDLIB_STATUS_ERROR).
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] target  Second sequence.
+     * @param [in] targetLength  Number of characters in second sequence.
+     * @param [in] config  Additional alignment parameters, like alignment method and wanted results.
+     * @return  Result of alignment.
+     *          Make sure to clean up the object using edlibFreeAlignResult64() or by manually freeing needed members.
+     */
+    EDLIB_API EdlibAlignResult64 edlibAlign64(
+        const char* query, int queryLength,
+        const char* target, long long targetLength,
+        const EdlibAlignConfig config
+    );
+
+    /**
+     * Aligns one query against multiple targets.
+     * Results are the same as if edlibAlign() was called for each target,
+     * but query is preprocessed only once and, for short queries on CPUs with AVX2 or AVX-512,
+     * multiple targets are aligned at once. That makes it much faster for many short alignments.
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] targets  Array of second sequences.
+     * @param [in] targetLengths  Number of characters in each of second sequences.
+     * @param [in] numTargets  Number of second sequences.
+     * @param [in] config  Additional alignment parameters, used for each alignment.
+     * @param [out] results  Array of at least numTargets results, where i-th result is for i-th target.
+     *          Make sure to clean up each of them using edlibFreeAlignResult() or by manually freeing needed members.
+     */
+    EDLIB_API void edlibAlignBatch(
+        const char* query, int queryLength,
+        const char* const* targets, const int* targetLengths, int numTargets,
+        const EdlibAlignConfig config,
+        EdlibAlignResult* results
+    );
+
+    /**
+     * Query that is preprocessed once, so it can be aligned against many targets
+     * without preprocessing it again for each of them.
+     * Create it with edlibCreateQueryProfile() and free it with edlibFreeQueryProfile().
+     */
+    typedef struct EdlibQueryProfile EdlibQueryProfile;
+
+    /**
+     * Preprocesses query for aligning with edlibAlignWithProfile().
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] additionalEqualities  List of pairs of characters, where each pair defines two characters
+     *     as equal. Same as additionalEqualities in EdlibAlignConfig. Can be NULL if there are none.
+     * @param [in] additionalEqualitiesLength  Number of additional equalities, 0 if there are none.
+     * @return  Query profile. Make sure to free it using edlibFreeQueryProfile().
+     */
+    EDLIB_API EdlibQueryProfile* edlibCreateQueryProfile(
+        const char* query, int queryLength,
+        const EdlibEqualityPair* additionalEqualities,
+        int additionalEqualitiesLength
+    );
+
+    /**
+     * Same as edlibAlign(), but query is given as a profile that was created with edlibCreateQueryProfile().
+     * Profile is not modified, so it can be used from multiple threads at the same time.
+     * @param [in] profile  Preprocessed first sequence.
+     * @param [in] target  Second sequence.
+     * @param [in] targetLength  Number of characters in second sequence.
+     * @param [in] config  Additional alignment parameters. Additional equalities are ignored,
+     *     since those given when creating the profile are used.
+     * @return  Result of alignment, same as the one from edlibAlign().
+     *          Make sure to clean up the object using edlibFreeAlignResult() or by manually freeing needed members.
+     */
+    EDLIB_API EdlibAlignResult edlibAlignWithProfile(
+        const EdlibQueryProfile* profile,
+        const char* target, int targetLength,
+        const EdlibAlignConfig config
+    );
+
+    /**
+     * Frees query profile that was created with edlibCreateQueryProfile().
+     */
+    EDLIB_API void edlibFreeQueryProfile(EdlibQueryProfile* profile);
+
+    /**
+     * Called by edlibAlignMany() after each target is aligned.
+     * @param [in] targetIdx  Index of target that was aligned.
+     * @param [in] result  Result of aligning query to that target. Edit distance is -1 if it is larger than k
+     *     that target was aligned with. It is valid only during the call and is freed after it.
+     * @param [in] userData  Pointer that was given to edlibAlignMany().
+     * @return  k for the following targets. Alignment of target is abandoned as soon as it is certain
+     *     that its edit distance is larger than k, so it is worth returning the smallest k that is still useful.
+     *     -1 means there is no limit, while any smaller value stops aligning remaining targets.
+     */
+    typedef int (*EdlibAlignCallback)(int targetIdx, const EdlibAlignResult* result, void* userData);
+
+    /**
+     * Aligns one query against multiple targets, one by one, and passes each result to the callback,
+     * which sets k for the following targets.
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] targets  Array of second sequences.
+     * @param [in] targetLengths  Number of characters in each of second sequences.
+     * @param [in] numTargets  Number of second sequences.
+     * @param [in] config  Additional alignment parameters. First target is aligned with config.k.
+     * @param [in] callback  Called after each target is aligned.
+     * @param [in] userData  Passed to the callback.
+     */
+    EDLIB_API void edlibAlignMany(
+        const char* query, int queryLength,
+        const char* const* targets, const int* targetLengths, int numTargets,
+        const EdlibAlignConfig config,
+        EdlibAlignCallback callback, void* userData
+    );
+
+    /**
+     * Finds numBest targets to which query aligns with smallest edit distance.
+     * Once numBest targets are found, each next target is aligned only with k that would get it among them,
+     * so alignment of target that can not get there is abandoned early. That makes it much faster than
+     * aligning query against each target with edlibAlign().
+     * Among targets with same edit distance, ones with smaller index are preferred.
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] targets  Array of second sequences.
+     * @param [in] targetLengths  Number of characters in each of second sequences.
+     * @param [in] numTargets  Number of second sequences.
+     * @param [in] numBest  Number of targets to find.
+     * @param [in] config  Additional alignment parameters. If k is not negative,
+     *     only targets with edit distance of at most k are found.
+     * @param [out] results  Array of at least numBest results, which are set to results of alignment
+     *     of best targets, sorted by edit distance. They are same as those that edlibAlign() would give.
+     *     Make sure to clean up each of them using edlibFreeAlignResult() or by manually freeing needed members.
+     * @param [out] targetIdxs  Array of at least numBest elements, which are set to index of target
+     *     for each of results.
+     * @return  Number of results that were set. It is smaller than numBest only if there are not enough
+     *     targets with edit distance of at most k.
+     */
+    EDLIB_API int edlibAlignTopN(
+        const char* query, int queryLength,
+        const char* const* targets, const int* targetLengths, int numTargets,
+        int numBest, const EdlibAlignConfig config,
+        EdlibAlignResult* results, int* targetIdxs
+    );
+
+    /**
+     * Aligns each query against target with same index, with pairs divided among multiple threads.
+     * Results are the same as if edlibAlign() was called for each pair.
+     * Each thread allocates temporary memory from its own workspace, so config.workspace is not used,
+     * and stats are not collected.
+     * @param [in] queries  Array of first sequences.
+     * @param [in] queryLengths  Number of characters in each of first sequences.
+     * @param [in] targets  Array of second sequences.
+     * @param [in] targetLengths  Number of characters in each of second sequences.
+     * @param [in] numPairs  Number of queries, which is same as number of targets.
+     * @param [in] config  Additional alignment parameters, used for each alignment.
+     * @param [in] numThreads  Number of threads that pairs are aligned in, including the calling thread.
+     *     If some of threads can not be created, pairs are aligned in the threads that were.
+     * @param [out] results  Array of at least numPairs results, where i-th result is for i-th pair.
+     *          Make sure to clean up each of them using edlibFreeAlignResult() or by manually freeing needed members.
+     */
+    EDLIB_API void edlibAlignPairs(
+        const char* const* queries, const int* queryLengths,
+        const char* const* targets, const int* targetLengths, int numPairs,
+        const EdlibAlignConfig config, int numThreads,
+        EdlibAlignResult* results
+    );
+
+    /**
+     * Location in target where alignment of query ends with edit distance of at most k,
+     * as found by edlibFindHits() or by stream search.
+     */
+    typedef struct {
+        /**
+         * Zero-based position in target where alignment ends.
+         * It is 64-bit, since target given to stream search can be longer than what fits into int.
+         */
+        long long endLocation;
+
+        /**
+         * Edit distance of best alignment that ends at endLocation.
+         */
+        int editDistance;
+    } EdlibHit;
+
+    /**
+     * Finds all locations in target where alignment of query ends with edit distance of at most config.k,
+     * not only those with the best edit distance, in one pass over target.
+     * This is useful when looking for all occurrences of a short sequence (e.g. primer or adapter) in target.
+     * Since neighbouring locations of an occurrence usually also have small edit distance, they can be
+     * suppressed so that each occurrence is reported once, by its location with the smallest edit distance.
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] target  Second sequence.
+     * @param [in] targetLength  Number of characters in second sequence.
+     * @param [in] config  Additional alignment parameters. k has to be non-negative and mode has to be
+     *     EDLIB_MODE_HW or EDLIB_MODE_SHW, and affine costs must not be set.
+     *     Task, maxAlignments and parallelization fields are ignored.
+     * @param [in] suppressionRadius  If positive, hit is reported only if all other hits that end at most
+     *     suppressionRadius positions before it have larger edit distance, and all that end at most
+     *     suppressionRadius positions after it have edit distance that is not smaller.
+     *     If 0, all hits are reported.
+     * @param [out] hits  Set to array of hits sorted by end location, or to NULL if there are none.
+     *     Make sure to free it using free().
+     * @return  Number of hits, or -1 if config is not valid.
+     */
+    EDLIB_API int edlibFindHits(
+        const char* query, int queryLength,
+        const char* target, int targetLength,
+        const EdlibAlignConfig config, int suppressionRadius,
+        EdlibHit** hits
+    );
+
+    /**
+     * Search of query in target that is given in parts, one after another, e.g. as it is read from a stream.
+     * Target does not have to be in memory as a whole, and it can be longer than what fits into int.
+     * Only column of dynamic programming matrix is kept between parts, so memory used does not depend on
+     * length of target.
+     */
+    typedef struct EdlibStreamSearch EdlibStreamSearch;
+
+    /**
+     * Starts search of query in target that will be given in parts with edlibStreamSearchFeed().
+     * All locations in target where alignment of query ends with edit distance of at most k are found,
+     * same as with edlibFindHits() with suppressionRadius of 0.
+     * @param [in] query  First sequence. It is copied, so it does not have to exist after this call.
+     * @param [in] queryLength  Number of characters in first sequence, which has to be positive.
+     * @param [in] config  Additional alignment parameters. k has to be non-negative and mode has to be
+     *     EDLIB_MODE_HW or EDLIB_MODE_SHW, and affine costs must not be set. Additional equalities are used,
+     *     other fields are ignored.
+     * @return  Search, or NULL if query is empty or config is not valid.
+     *     Make sure to free it using edlibFreeStreamSearch().
+     */
+    EDLIB_API EdlibStreamSearch* edlibCreateStreamSearch(
+        const char* query, int queryLength,
+        const EdlibAlignConfig config
+    );
+
+    /**
+     * Continues search with next part of target.
+     * @param [in] search
+     * @param [in] targetPart  Next part of target.
+     * @param [in] targetPartLength  Number of characters in targetPart.
+     * @param [out] hits  Set to array of hits that were found, sorted by end location, which is relative
+     *     to the start of the whole target. Because of how edlib calculates, hits can end up to 63 characters
+     *     before the start of given part. Array is valid until next call with this search.
+     * @return  Number of hits.
+     */
+    EDLIB_API int edlibStreamSearchFeed(
+        EdlibStreamSearch* search,
+        const char* targetPart, int targetPartLength,
+        const EdlibHit** hits
+    );
+
+    /**
+     * Ends search once all parts of target were given, and finds hits that end in last characters of target.
+     * @param [in] search
+     * @param [out] hits  Same as for edlibStreamSearchFeed().
+     * @return  Number of hits.
+     */
+    EDLIB_API int edlibStreamSearchFinish(EdlibStreamSearch* search, const EdlibHit** hits);
+
+    /**
+     * Frees search that was created with edlibCreateStreamSearch().
+     */
+    EDLIB_API void edlibFreeStreamSearch(EdlibStreamSearch* search);
+
+    /**
+     * Index of target, built once and then used to search for many queries in it with EDLIB_MODE_HW,
+     * without scanning the whole target for each of them.
+     * It stores positions of all substrings of target of the same length (seeds).
+     * Query with edit distance of at most k contains k + 1 non-overlapping seeds, and at least one of them
+     * is not changed by edits, so only parts of target around occurrences of those seeds are aligned.
+     */
+    typedef struct EdlibTargetIndex EdlibTargetIndex;
+
+    /**
+     * Builds index of target.
+     * @param [in] target  Second sequence. It is copied, so it does not have to exist after this call.
+     * @param [in] targetLength  Number of characters in second sequence.
+     * @param [in] seedLength  Length of seeds, which has to be positive. Index is used only for queries
+     *     that are at least (k + 1) * seedLength long. Longer seeds occur less often by chance,
+     *     so fewer parts of target are aligned, e.g. 12 or more for DNA.
+     * @return  Index, or NULL if arguments are not valid.
+     *     Make sure to free it using edlibFreeTargetIndex().
+     */
+    EDLIB_API EdlibTargetIndex* edlibCreateTargetIndex(const char* target, int targetLength, int seedLength);
+
+    /**
+     * Same as edlibAlign(), but target is taken from index.
+     * Only parts of target that may contain alignment with edit distance of at most k are aligned,
+     * if mode is EDLIB_MODE_HW, k is non-negative, query is long enough for seed length of index,
+     * and there are no additional equalities or affine costs. Otherwise, whole target is aligned.
+     * @param [in] query  First sequence.
+     * @param [in] queryLength  Number of characters in first sequence.
+     * @param [in] index  Index of second sequence.
+     * @param [in] config  Same as for edlibAlign(), except that stats are not collected.
+     * @return  Same as edlibAlign() would return for target of index.
+     */
+    EDLIB_API EdlibAlignResult edlibAlignWithIndex(
+        const char* query, int queryLength,
+        const EdlibTargetIndex* index,
+        const EdlibAlignConfig config
+    );
+
+    /**
+     * Same as edlibFindHits(), but target is taken from index.
+     * Only parts of target that may contain hits are searched, if mode is EDLIB_MODE_HW,
+     * query is long enough for seed length of index and there are no additional equalities.
+     * @return  Same as edlibFindHits() would return for target of index.
+     */
+    EDLIB_API int edlibFindHitsWithIndex(
+        const char* query, int queryLength,
+        const EdlibTargetIndex* index,
+        const EdlibAlignConfig config, int suppressionRadius,
+        EdlibHit** hits
+    );
+
+    /**
+     * Frees index that was created with edlibCreateTargetIndex().
+     */
+    EDLIB_API void edlibFreeTargetIndex(EdlibTargetIndex* index);
+
 
     /**
      * Builds cigar string from given alignment sequence.
@@ -270,6 +873,42 @@ extern "C" {
         EdlibCigarFormat cigarFormat
     );
 
+    /**
+     * Same as edlibAlignmentToCigar(), but writes cigar string into given buffer instead of allocating it.
+     * Call it with cigar set to NULL to find out how large buffer is needed.
+     * @param [in] alignment  Alignment sequence, see edlibAlignmentToCigar().
+     * @param [in] alignmentLength
+     * @param [in] cigarFormat  Cigar will be written in specified format.
+     * @param [out] cigar  Buffer into which null terminated cigar string is written, if it has room for it.
+     *     If it does not, its content is unspecified. Can be NULL.
+     * @param [in] cigarCapacity  Size of cigar buffer, in chars.
+     * @return Length of cigar string, without null character, so it fits into buffer if it is smaller
+     *     than cigarCapacity. -1 if format or alignment is not valid.
+     */
+    EDLIB_API int edlibAlignmentToCigarBuffer(
+        const unsigned char* alignment, int alignmentLength,
+        EdlibCigarFormat cigarFormat, char* cigar, int cigarCapacity
+    );
+
+    /**
+     * Builds cigar from given alignment sequence in packed form used by BAM format, where each operation
+     * is one number: its length shifted left by 4 bits, OR-ed with code of operation
+     * (0 for M, 1 for I, 2 for D, 7 for =, 8 for X), so it can be written directly into BAM record.
+     * Operations longer than 2^28 - 1 are split into more operations, since their length would not fit.
+     * Call it with cigar set to NULL to find out how many operations there are.
+     * @param [in] alignment  Alignment sequence, see edlibAlignmentToCigar().
+     * @param [in] alignmentLength
+     * @param [in] cigarFormat  Tells which operations are used, M or = and X, same as for cigar string.
+     * @param [out] cigar  Buffer into which operations are written, if it has room for all of them.
+     *     If it does not, its content is unspecified. Can be NULL.
+     * @param [in] cigarCapacity  Size of cigar buffer, in operations.
+     * @return Number of operations. -1 if format or alignment is not valid.
+     */
+    EDLIB_API int edlibAlignmentToPackedCigar(
+        const unsigned char* alignment, int alignmentLength,
+        EdlibCigarFormat cigarFormat, uint32_t* cigar, int cigarCapacity
+    );
+
 #ifdef __cplusplus
 }
 #endif
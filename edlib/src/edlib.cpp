@@ -2,57 +2,467 @@
 
 #include <stdint.h>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstdlib>
 #include <algorithm>
 #include <vector>
 #include <cstring>
+#include <deque>
+#include <queue>
 #include <string>
+#include <system_error>
+#include <thread>
+
+// Multi-block SIMD kernels are compiled for x86 with GCC/Clang function target attributes,
+// and picked at runtime based on what CPU supports. Everywhere else only scalar kernel is used.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) \
+    && !defined(EDLIB_NO_SIMD)
+#define EDLIB_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 namespace {
 
 using namespace std;
 
-typedef uint64_t Word;
-static const int WORD_SIZE = sizeof(Word) * 8; // Size of Word in bits
-static const Word WORD_1 = static_cast<Word>(1);
-static const Word HIGH_BIT_MASK = WORD_1 << (WORD_SIZE - 1);  // 100..00
+// Blocks of a column are stored in words of type Word, which is uint64_t by default and uint32_t for
+// short queries (see useShortWords()). Functions that depend on it are templates on Word,
+// with WORD_SIZE being size of Word in bits.
 static const int MAX_UCHAR = 255;
 
+// edlibAlign64() processes long targets in parts of this length.
+static const int LONG_TARGET_PART_LENGTH = 1 << 20;
+
+// When edit distance is not found in the first round with automatically adjusted k, k is set to its lower bound
+// found from q-grams (see qgramLowerBound()) multiplied by this factor, since bound is usually lower.
+static const long long K_LOWER_BOUND_FACTOR = 2;
+// Table of q-gram counts has at most this many times more entries than there are characters in sequences,
+// and at most MAX_QGRAM_TABLE_SIZE entries.
+static const long long QGRAM_TABLE_SIZE_FACTOR = 16;
+static const int MAX_QGRAM_TABLE_SIZE = 1 << 20;
+// Larger than cost of any alignment with affine gap costs, and small enough that costs can be added to it.
+static const int AFFINE_INF = INT_MAX / 2;
+// With affine gap costs, if k is not given, it starts from cost of about this many edits and is doubled.
+static const int AFFINE_INITIAL_NUM_EDITS = 64;
+// With EDLIB_ENGINE_AUTO, diagonal transition gives up when edit distance is larger than
+// square root of this many times query length, since bit-vector algorithm is faster from there on.
+static const long long DIAGONAL_TRANSITION_FACTOR = 8;
+// Target index has at most 2^MAX_TARGET_INDEX_BUCKET_BITS buckets of seeds.
+static const int MAX_TARGET_INDEX_BUCKET_BITS = 24;
+// Base of polynomial rolling hash of seeds in target index.
+static const uint64_t SEED_HASH_BASE = 1099511628211ULL;
+
+/**
+ * Memory from which all temporary arrays are allocated, so that memory is allocated from heap only when
+ * more of it is needed than ever before.
+ * Memory is allocated by bumping a pointer and is released in the reverse order of allocation,
+ * by going back to a mark (see ArenaScope). Arena consists of chunks, which are merged into one big chunk
+ * on reset, so that in steady state all allocations come from the same chunk.
+ */
+class Arena {
+private:
+    static const size_t ALIGNMENT = 16;  // Same as alignment of memory returned by malloc().
+    static const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+    vector<Chunk> chunks;
+    size_t current;  // Index of chunk from which memory is allocated.
+    size_t used;  // Number of bytes that are allocated from current chunk.
+    size_t numAllocatedBytes;  // Number of bytes allocated since last reset, including released ones.
+    size_t numBytesInUse;  // Number of bytes that are allocated and not released.
+    size_t numPeakBytes;  // Largest numBytesInUse since last reset.
+
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+
+    static Chunk createChunk(const size_t size) {
+        Chunk chunk;
+        chunk.data = static_cast<char*>(malloc(size));
+        chunk.size = size;
+        return chunk;
+    }
+
+    /**
+     * Moves to next chunk, which has to have at least given number of bytes.
+     */
+    void nextChunk(const size_t bytes) {
+        const size_t next = chunks.empty() ? 0 : current + 1;
+        const size_t size = std::max(bytes, chunks.empty() ? MIN_CHUNK_SIZE : 2 * chunks.back().size);
+        if (next == chunks.size()) {
+            chunks.push_back(createChunk(size));
+        } else if (chunks[next].size < bytes) {
+            free(chunks[next].data);
+            chunks[next] = createChunk(size);
+        }
+        current = next;
+        used = 0;
+    }
+
+public:
+    // Position in arena, everything that was allocated after it can be released at once.
+    struct Mark {
+        size_t chunk;
+        size_t used;
+        size_t bytesInUse;
+    };
+
+    Arena() : current(0), used(0), numAllocatedBytes(0), numBytesInUse(0), numPeakBytes(0) {}
+
+    ~Arena() {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            free(chunks[i].data);
+        }
+    }
+
+    /**
+     * @return Uninitialized array of n elements, that is valid until it is released.
+     */
+    template <typename T>
+    T* allocate(const size_t n) {
+        const size_t bytes = (std::max(n * sizeof(T), static_cast<size_t>(1)) + ALIGNMENT - 1)
+            / ALIGNMENT * ALIGNMENT;
+        if (chunks.empty() || chunks[current].size - used < bytes) {
+            nextChunk(bytes);
+        }
+        T* const ptr = reinterpret_cast<T*>(chunks[current].data + used);
+        used += bytes;
+        numAllocatedBytes += bytes;
+        numBytesInUse += bytes;
+        numPeakBytes = std::max(numPeakBytes, numBytesInUse);
+        return ptr;
+    }
+
+    size_t allocatedBytes() const {
+        return numAllocatedBytes;
+    }
+
+    size_t peakBytes() const {
+        return numPeakBytes;
+    }
+
+    /**
+     * Starts measuring peak of memory used while other arena (e.g. one used by another thread) is also in use.
+     * @return Peak so far, which has to be given to addConcurrentArena().
+     */
+    size_t startConcurrentPeak() {
+        const size_t peak = numPeakBytes;
+        numPeakBytes = numBytesInUse;
+        return peak;
+    }
+
+    /**
+     * Counts bytes that were allocated from other arena as allocated from this one. Since both were in use
+     * at the same time, peaks of them since startConcurrentPeak() are added together.
+     */
+    void addConcurrentArena(const Arena& other, const size_t previousPeak) {
+        numAllocatedBytes += other.numAllocatedBytes;
+        numPeakBytes = std::max(previousPeak, numPeakBytes + other.numPeakBytes);
+    }
+
+    Mark mark() const {
+        Mark m;
+        m.chunk = current;
+        m.used = used;
+        m.bytesInUse = numBytesInUse;
+        return m;
+    }
+
+    /**
+     * Releases everything that was allocated after given mark.
+     */
+    void release(const Mark m) {
+        current = m.chunk;
+        used = m.used;
+        numBytesInUse = m.bytesInUse;
+    }
+
+    /**
+     * Releases everything and merges chunks into one, so that there is enough space in it
+     * for all that was allocated so far.
+     */
+    void reset() {
+        if (chunks.size() > 1) {
+            size_t totalSize = 0;
+            for (size_t i = 0; i < chunks.size(); i++) {
+                totalSize += chunks[i].size;
+                free(chunks[i].data);
+            }
+            chunks.clear();
+            chunks.push_back(createChunk(totalSize));
+        }
+        current = 0;
+        used = 0;
+        numAllocatedBytes = 0;
+        numBytesInUse = 0;
+        numPeakBytes = 0;
+    }
+};
+
+/**
+ * Releases memory that was allocated from arena during the lifetime of this object, when it goes out of scope.
+ */
+class ArenaScope {
+private:
+    Arena& arena;
+    const Arena::Mark mark;
+
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+
+public:
+    explicit ArenaScope(Arena& arena_) : arena(arena_), mark(arena_.mark()) {}
+    ~ArenaScope() { arena.release(mark); }
+};
+
+/**
+ * Runs both tasks, each one with an arena from which it allocates temporary memory.
+ * If parallel is true, second task is run in a new thread, with its own arena.
+ * Otherwise, or if new thread can not be created, tasks are run one after another.
+ */
+template <typename Task1, typename Task2>
+void runTasks(const bool parallel, Arena& arena, const Task1& task1, const Task2& task2) {
+    std::thread thread;
+    Arena threadArena;
+    if (parallel) {
+        try {
+            thread = std::thread([&task2, &threadArena]() {
+                task2(threadArena);
+            });
+        } catch (const std::system_error&) {
+            // Tasks will be run one after another.
+        }
+    }
+    const size_t previousPeak = arena.startConcurrentPeak();
+    task1(arena);
+    if (thread.joinable()) {
+        thread.join();
+    } else {
+        task2(arena);
+    }
+    arena.addConcurrentArena(threadArena, previousPeak);
+}
+
+template <typename Word>
+struct Block {
+    Word P;  // Pvin
+    Word M;  // Mvin
+    int score; // score of last cell in block;
+
+    Block() {}
+    Block(Word p, Word m, int s) :P(p), M(m), score(s) {}
+};
+
 // Data needed to find alignment.
+// Only blocks in band are stored: blocks of each column are stored one after another,
+// starting with first block of the column, and columns are stored one after another.
+// Stored columns may start with column firstColumn of matrix, when only part of matrix is stored.
+template <typename Word>
 struct AlignmentData {
     Word* Ps;
     Word* Ms;
     int* scores;
     int* firstBlocks;
     int* lastBlocks;
+    size_t* columnStarts;  // columnStarts[i] is index of first block of i-th stored column in Ps, Ms and scores.
+    size_t capacity;  // Number of blocks that can be stored, in all columns together.
+    int columnCapacity;  // Number of columns that can be stored.
+    int firstColumn;  // Column of matrix that is stored first.
 
-    AlignmentData(int maxNumBlocks, int targetLength) {
-        // We build a complete table and mark first and last block for each column
-        // (because algorithm is banded so only part of each columns is used).
-        // TODO: do not build a whole table, but just enough blocks for each column.
-         Ps     = new Word[maxNumBlocks * targetLength];
-         Ms     = new Word[maxNumBlocks * targetLength];
-         scores = new  int[maxNumBlocks * targetLength];
-         firstBlocks = new int[targetLength];
-         lastBlocks  = new int[targetLength];
+    /**
+     * Arrays are allocated from given arena.
+     * @param numColumns  Number of columns that can be stored.
+     * @param numBlocks  Number of blocks that can be stored, in all columns together.
+     */
+    AlignmentData(int numColumns, size_t numBlocks, Arena& arena) {
+        Ps     = arena.allocate<Word>(numBlocks);
+        Ms     = arena.allocate<Word>(numBlocks);
+        scores = arena.allocate<int>(numBlocks);
+        firstBlocks  = arena.allocate<int>(numColumns);
+        lastBlocks   = arena.allocate<int>(numColumns);
+        columnStarts = arena.allocate<size_t>(numColumns);
+        capacity = numBlocks;
+        columnCapacity = numColumns;
+        firstColumn = 0;
     }
 
-    ~AlignmentData() {
-        delete[] Ps;
-        delete[] Ms;
-        delete[] scores;
-        delete[] firstBlocks;
-        delete[] lastBlocks;
+    /**
+     * Stores blocks from firstBlock to lastBlock as i-th stored column, right after the previous one.
+     * @return Status code, error if there is not enough room for them.
+     */
+    int saveColumn(const int i, const Block<Word>* const blocks, const int firstBlock, const int lastBlock) {
+        const size_t columnStart = i == 0 ? 0 : columnStarts[i - 1]
+            + static_cast<size_t>(lastBlocks[i - 1] - firstBlocks[i - 1] + 1);
+        if (columnStart + static_cast<size_t>(lastBlock - firstBlock + 1) > capacity) {
+            // Band is wider than expected, which should never happen.
+            return EDLIB_STATUS_ERROR;
+        }
+        for (int b = firstBlock; b <= lastBlock; b++) {
+            const size_t j = columnStart + static_cast<size_t>(b - firstBlock);
+            Ps[j] = blocks[b].P;
+            Ms[j] = blocks[b].M;
+            scores[j] = blocks[b].score;
+        }
+        firstBlocks[i] = firstBlock;
+        lastBlocks[i] = lastBlock;
+        columnStarts[i] = columnStart;
+        return EDLIB_STATUS_OK;
+    }
+
+    /**
+     * Copies i-th stored column back into blocks.
+     */
+    void loadColumn(const int i, Block<Word>* const blocks) const {
+        for (int b = firstBlocks[i]; b <= lastBlocks[i]; b++) {
+            const size_t j = columnStarts[i] + static_cast<size_t>(b - firstBlocks[i]);
+            blocks[b] = Block<Word>(Ps[j], Ms[j], scores[j]);
+        }
+    }
+
+    /**
+     * @return Number of bytes that AlignmentData with given dimensions takes.
+     */
+    static long long size(int numColumns, long long numBlocks) {
+        return (2ll * sizeof(Word) + sizeof(int)) * numBlocks
+            + (2ll * sizeof(int) + sizeof(size_t)) * numColumns;
+    }
+
+    /**
+     * @return Index of block b of column c in Ps, Ms and scores. Block has to be in band.
+     */
+    size_t index(const int c, const int b) const {
+        return columnStarts[c - firstColumn] + static_cast<size_t>(b - firstBlocks[c - firstColumn]);
+    }
+
+    /**
+     * @return True if block b of column c is stored.
+     */
+    bool inBand(const int c, const int b) const {
+        return b >= firstBlocks[c - firstColumn] && b <= lastBlocks[c - firstColumn];
     }
 };
 
-struct Block {
-    Word P;  // Pvin
-    Word M;  // Mvin
-    int score; // score of last cell in block;
+/**
+ * Columns of dynamic programming matrix of global alignment that are saved every interval columns
+ * while calculating it, so that it can be calculated again in segments starting with them.
+ */
+template <typename Word>
+struct NWCheckpoints {
+    AlignmentData<Word> columns;  // Checkpoint i is column (i + 1) * interval - 1 of matrix, stored as i-th column.
+    int* ks;  // ks[i] is k that was used to calculate columns after checkpoint i.
+    int interval;
+    int numCheckpoints;
 
-    Block() {}
-    Block(Word p, Word m, int s) :P(p), M(m), score(s) {}
+    /**
+     * Arrays are allocated from given arena.
+     * @param targetLength  Number of columns of matrix. Last column is never a checkpoint.
+     * @param checkpointInterval  Number of columns between checkpoints.
+     * @param numBandBlocks  Maximal number of blocks in band of one column.
+     */
+    NWCheckpoints(int targetLength, int checkpointInterval, size_t numBandBlocks, Arena& arena)
+        : columns(getNumCheckpoints(targetLength, checkpointInterval),
+                  numBandBlocks * static_cast<size_t>(getNumCheckpoints(targetLength, checkpointInterval)), arena) {
+        interval = checkpointInterval;
+        numCheckpoints = getNumCheckpoints(targetLength, interval);
+        ks = arena.allocate<int>(numCheckpoints);
+    }
+
+    static int getNumCheckpoints(const int targetLength, const int interval) {
+        return (targetLength - 1) / interval;
+    }
+
+    /**
+     * @return Number of bytes that NWCheckpoints with given dimensions takes.
+     */
+    static long long size(int targetLength, int interval, long long numBandBlocks) {
+        const int numCheckpoints = getNumCheckpoints(targetLength, interval);
+        return AlignmentData<Word>::size(numCheckpoints, numBandBlocks * numCheckpoints)
+            + static_cast<long long>(sizeof(int)) * numCheckpoints;
+    }
+};
+
+/**
+ * State of Myers' bit-vector algorithm for semi-global alignment methods between columns,
+ * so that target can be given in parts (see myersCalcEditDistanceSemiGlobal() for what is done with it).
+ */
+template <typename Word>
+struct SemiGlobalState {
+    Block<Word>* blocks;  // Blocks of the last calculated column, maxNumBlocks of them.
+    int firstBlock;  // 0-based index of first block in Ukkonen band.
+    int lastBlock;  // 0-based index of last block in Ukkonen band.
+    int k;
+    int bestScore;  // -1 if no score of at most k was found yet.
+    int strongReducePhase;  // Number of calculated columns, modulo number of columns between strong reduces.
+};
+
+/**
+ * Counters of work done in one phase of alignment, from which EdlibPhaseStats are filled.
+ * Parallel tasks of Hirschberg's algorithm share them, so they are atomic.
+ */
+struct WorkCounters {
+    std::atomic<long long> numBlocks;
+    std::atomic<int> maxBandBlocks;
+    std::atomic<int> hirschbergDepth;
+
+    WorkCounters() : numBlocks(0), maxBandBlocks(0), hirschbergDepth(0) {}
+
+    static void updateMax(std::atomic<int>& value, const int candidate) {
+        int current = value.load();
+        while (candidate > current && !value.compare_exchange_weak(current, candidate)) {}
+    }
+
+    /**
+     * Fills phase stats with counters and with time since phase started.
+     */
+    void getStats(const std::chrono::steady_clock::time_point startTime, EdlibPhaseStats* const phaseStats) const {
+        phaseStats->numBlocks = numBlocks;
+        phaseStats->maxBandBlocks = maxBandBlocks;
+        phaseStats->nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+    }
+};
+
+/**
+ * Counts blocks that are calculated in one calculation of Myers' algorithm, column by column,
+ * and adds them to work counters (if there are any) when it goes out of scope,
+ * so that shared counters are updated only once per calculation.
+ */
+class BlockCounter {
+private:
+    WorkCounters* const counters;
+    long long numBlocks;
+    int maxBandBlocks;
+
+    BlockCounter(const BlockCounter&);
+    BlockCounter& operator=(const BlockCounter&);
+
+public:
+    explicit BlockCounter(WorkCounters* const counters_) : counters(counters_), numBlocks(0), maxBandBlocks(0) {}
+
+    ~BlockCounter() {
+        if (counters) {
+            counters->numBlocks += numBlocks;
+            WorkCounters::updateMax(counters->maxBandBlocks, maxBandBlocks);
+        }
+    }
+
+    void addColumn(const int firstBlock, const int lastBlock) {
+        const int numColumnBlocks = lastBlock - firstBlock + 1;
+        numBlocks += numColumnBlocks;
+        maxBandBlocks = std::max(maxBandBlocks, numColumnBlocks);
+    }
+};
+
+// SIMD instruction sets for which we have multi-block kernels.
+enum SimdLevel {
+    SIMD_NONE,
+    SIMD_AVX2,
+    SIMD_AVX512
 };
 
 
@@ -63,10 +473,12 @@ struct Block {
 class EqualityDefinition {
 private:
     bool matrix[MAX_UCHAR + 1][MAX_UCHAR + 1];
+    bool onlyIdentity;  // True if each character is equal only to itself.
 public:
     EqualityDefinition(const string& alphabet,
                        const EdlibEqualityPair* additionalEqualities = NULL,
                        const int additionalEqualitiesLength = 0) {
+        onlyIdentity = true;
         for (int i = 0; i < static_cast<int>(alphabet.size()); i++) {
             for (int j = 0; j < static_cast<int>(alphabet.size()); j++) {
                 matrix[i][j] = (i == j);
@@ -78,6 +490,7 @@ public:
                 size_t secondTransformed = alphabet.find(additionalEqualities[i].second);
                 if (firstTransformed != string::npos && secondTransformed != string::npos) {
                     matrix[firstTransformed][secondTransformed] = matrix[secondTransformed][firstTransformed] = true;
+                    if (firstTransformed != secondTransformed) onlyIdentity = false;
                 }
             }
         }
@@ -91,53 +504,334 @@ public:
     bool areEqual(unsigned char a, unsigned char b) const {
         return matrix[a][b];
     }
+
+    /**
+     * @return True if each character is equal only to itself, as by default.
+     */
+    bool isIdentity() const {
+        return onlyIdentity;
+    }
+};
+
+// How the best alignment that ends in cell of matrix with affine gap costs ends.
+enum AffineMove {
+    AFFINE_FROM_DIAGONAL = 0,  // With match or mismatch.
+    AFFINE_FROM_INSERTION = 1,
+    AFFINE_FROM_DELETION = 2
+};
+static const unsigned char AFFINE_INSERTION_OPENED = 4;  // Alignment ending with insertion opens gap in cell.
+static const unsigned char AFFINE_DELETION_OPENED = 8;  // Alignment ending with deletion opens gap in cell.
+
+/**
+ * Moves by which costs of calculated cells of matrix with affine gap costs were obtained,
+ * from which alignment is traced back. Only cells from the first to the last calculated row
+ * are stored for each column.
+ */
+struct AffineTrace {
+    // For each cell, AffineMove, combined with AFFINE_INSERTION_OPENED and AFFINE_DELETION_OPENED.
+    unsigned char* cells;
+    size_t* columnStarts;  // Index of the first cell of each column in cells.
+    int* firstRows;  // First calculated row of each column.
+    size_t numCells;  // Number of cells that are stored, in all columns together.
+    size_t capacity;  // Number of cells that can be stored, in all columns together.
+
+    /**
+     * Arrays are allocated from given arena.
+     * @param numColumns  Number of columns that can be stored.
+     * @param numCells_  Number of cells that can be stored, in all columns together.
+     */
+    AffineTrace(int numColumns, size_t numCells_, Arena& arena) {
+        cells        = arena.allocate<unsigned char>(numCells_);
+        columnStarts = arena.allocate<size_t>(numColumns);
+        firstRows    = arena.allocate<int>(numColumns);
+        numCells = 0;
+        capacity = numCells_;
+    }
+
+    /**
+     * @return Number of bytes that AffineTrace with given dimensions takes.
+     */
+    static long long size(int numColumns, long long numCells) {
+        return static_cast<long long>(sizeof(unsigned char)) * numCells
+            + static_cast<long long>(sizeof(size_t) + sizeof(int)) * numColumns;
+    }
+
+    unsigned char get(const int row, const int column) const {
+        return cells[columnStarts[column] + (row - firstRows[column])];
+    }
 };
 
 } // anonymous namespace
 
+/**
+ * Query that is transformed and preprocessed once, so it can be aligned against multiple targets.
+ */
+struct EdlibQueryProfile {
+    int queryLength;
+    unsigned char* query;  // Transformed query.
+    unsigned char* rQuery;  // Reversed transformed query.
+    // Alphabet consists of characters from query and from additional equalities,
+    // and of one more letter that represents all other characters.
+    int alphabetLength;
+    // letterIdx[c] is index of character c in alphabet.
+    unsigned char letterIdx[MAX_UCHAR + 1];
+    bool inQuery[MAX_UCHAR + 1];  // inQuery[c] is true if character c is in query.
+    int queryAlphabetLength;  // Number of unique characters in query.
+    EqualityDefinition* equalityDefinition;
+    // Peqs consist of words of type that is used for this query length, see useShortWords().
+    void* Peq;
+    void* rPeq;  // Peq for reversed query.
+    Arena arena;  // Transformed queries and Peqs are allocated from it.
+};
+
+/**
+ * Memory that is reused between alignments, so that temporary arrays do not have to be allocated each time.
+ */
+struct EdlibWorkspace {
+    Arena arena;
+    vector<int> positions;  // End locations, as found by myersCalcEditDistanceSemiGlobal().
+    vector<int> starts;  // Start locations, as found by affineCalcScore().
+    vector< vector<int> > lanePositions;  // End locations for each lane, as found by myersCalcEditDistanceLanes().
+};
+
+/**
+ * Search of query in target that is given in parts.
+ */
+struct EdlibStreamSearch {
+    EdlibQueryProfile* profile;
+    EdlibAlignMode mode;
+    int W;  // Size of padding in last block.
+    int maxNumBlocks;
+    // Only one of the states is used, depending on which words are used for the query (see useShortWords()).
+    SemiGlobalState<uint32_t> state32;
+    SemiGlobalState<uint64_t> state64;
+    bool bandExists;  // If false, no more hits can be found.
+    long long targetLength;  // Length of target given so far.
+    vector<unsigned char> targetPart;  // Transformed part of target.
+    vector<int> positions;  // Positions of hits, relative to start of current part of target.
+    vector<int> scores;
+    vector<EdlibHit> hits;
+    Arena arena;  // Blocks of states are allocated from it.
+};
+
+/**
+ * Index of target, in which seeds are grouped into buckets by their hash.
+ */
+struct EdlibTargetIndex {
+    vector<char> target;
+    int seedLength;
+    int bucketBits;  // There are 2^bucketBits buckets.
+    // Positions of seeds from bucket b are positions[bucketStarts[b]] to positions[bucketStarts[b + 1] - 1],
+    // in increasing order.
+    vector<int> bucketStarts;
+    vector<int> positions;
+    bool inTarget[MAX_UCHAR + 1];  // inTarget[c] is true if character c is in target.
+};
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static int myersCalcEditDistanceSemiGlobal(const Word* Peq, int W, int maxNumBlocks,
                                            int queryLength,
                                            const unsigned char* target, int targetLength,
-                                           int k, EdlibAlignMode mode,
-                                           int* bestScore_, int** positions_, int* numPositions_);
+                                           int k, EdlibAlignMode mode, Arena& arena,
+                                           int* bestScore_, vector<int>* positions_, vector<int>* scores_,
+                                           WorkCounters* counters);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void initSemiGlobalState(int maxNumBlocks, int queryLength, int k,
+                                Block<Word>* blocks, SemiGlobalState<Word>* state);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static bool calcSemiGlobalColumns(const Word* Peq, int W, int maxNumBlocks,
+                                  const unsigned char* target, int targetLength,
+                                  EdlibAlignMode mode, SemiGlobalState<Word>* state,
+                                  vector<int>* positions_, vector<int>* scores_, WorkCounters* counters);
 
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void finishSemiGlobal(int W, int maxNumBlocks, int endPosition, SemiGlobalState<Word>* state,
+                             vector<int>* positions_, vector<int>* scores_);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static int myersCalcEditDistanceNW(const Word* Peq, int W, int maxNumBlocks,
                                    int queryLength,
                                    const unsigned char* target, int targetLength,
-                                   int k, int* bestScore_,
+                                   int k, Arena& arena, int* bestScore_,
                                    int* position_, bool findAlignment,
-                                   AlignmentData** alignData, int targetStopPosition);
+                                   AlignmentData<Word>* alignData, int targetStopPosition,
+                                   NWCheckpoints<Word>* checkpoints, WorkCounters* counters);
 
 
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static int obtainAlignment(
         const unsigned char* query, const unsigned char* rQuery, int queryLength,
         const unsigned char* target, const unsigned char* rTarget, int targetLength,
         const EqualityDefinition& equalityDefinition, int alphabetLength, int bestScore,
-        unsigned char** alignment, int* alignmentLength);
+        const Word* Peq, const Word* rPeq, Arena& arena, int numThreads, int parallelCutoff,
+        long long tracebackMemoryBudget, WorkCounters* counters, int depth,
+        unsigned char* alignment, int* alignmentLength);
 
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static int obtainAlignmentHirschberg(
         const unsigned char* query, const unsigned char* rQuery, int queryLength,
         const unsigned char* target, const unsigned char* rTarget, int targetLength,
         const EqualityDefinition& equalityDefinition, int alphabetLength, int bestScore,
-        unsigned char** alignment, int* alignmentLength);
+        const Word* Peq, const Word* rPeq, Arena& arena, int numThreads, int parallelCutoff,
+        long long tracebackMemoryBudget, WorkCounters* counters, int depth,
+        unsigned char* alignment, int* alignmentLength);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static int obtainAlignmentCheckpointed(
+        const unsigned char* query, int queryLength, const unsigned char* target, int targetLength,
+        const EqualityDefinition& equalityDefinition, int alphabetLength, int bestScore,
+        const Word* Peq, Arena& arena, WorkCounters* counters,
+        unsigned char* alignment, int* alignmentLength);
+
+template <typename Word>
+struct TracebackSegments;
 
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static int obtainAlignmentTraceback(int queryLength, int targetLength,
-                                    int bestScore, const AlignmentData* alignData,
-                                    unsigned char** alignment, int* alignmentLength);
+                                    int bestScore, const AlignmentData<Word>* alignData,
+                                    TracebackSegments<Word>* segments,
+                                    unsigned char* alignment, int* alignmentLength);
 
 static string transformSequences(const char* queryOriginal, int queryLength,
                                  const char* targetOriginal, int targetLength,
                                  unsigned char** queryTransformed,
-                                 unsigned char** targetTransformed);
+                                 unsigned char** targetTransformed, Arena& arena);
+
+static string transformSequencesBatch(const char* queryOriginal, int queryLength,
+                                      const char* const* targetsOriginal, const int* targetLengths,
+                                      int numTargets,
+                                      unsigned char** queryTransformed,
+                                      unsigned char** targetsTransformed,
+                                      const unsigned char** targets, Arena& arena);
+
+static int countAlphabet(const char* query, int queryLength, const char* target, int targetLength);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static int getNumLanes(int maxNumBlocks, int k, EdlibAlignMode mode);
+
+#ifdef EDLIB_X86_SIMD
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void myersCalcEditDistanceLanes(
+        const Word* Peq, int W, int maxNumBlocks, int queryLength,
+        const unsigned char* const* targets, const int* targetLengths, int numTargets,
+        int k, EdlibAlignMode mode, int numLanes, Arena& arena,
+        int* bestScores_, vector<int>* positions_);
+#endif
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void alignWithWords(const unsigned char* query, const unsigned char* rQuery, int queryLength,
+                           const unsigned char* target, int targetLength,
+                           const EqualityDefinition& equalityDefinition, int alphabetLength,
+                           const Word* Peq, const Word* rPeq,
+                           const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                           EdlibAlignResult* result);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void alignBatchWithWords(const unsigned char* query, const char* queryOriginal, int queryLength,
+                                const unsigned char* const* targets, const char* const* targetsOriginal,
+                                const int* targetLengths, int numTargets, const string& alphabet,
+                                const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                                EdlibAlignResult* results);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void findHitsWithWords(const unsigned char* query, int queryLength,
+                              const unsigned char* target, int targetLength,
+                              const EqualityDefinition& equalityDefinition, int alphabetLength,
+                              int k, EdlibAlignMode mode, Arena& arena,
+                              vector<int>* positions, vector<int>* scores);
+
+static int collectHits(const vector<int>& positions, const vector<int>& scores, int suppressionRadius,
+                       EdlibHit** hits);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void feedStreamSearch(EdlibStreamSearch* search, SemiGlobalState<Word>* state, bool finish);
+
+static bool findCandidateWindows(const EdlibTargetIndex& index, const char* query, int queryLength,
+                                 const EdlibAlignConfig& config, vector< pair<int, int> >* windows);
+
+static inline int seedBucket(uint64_t seedHash, int bucketBits);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void alignLongTarget(const EdlibQueryProfile& profile, const char* target, long long targetLength,
+                            const EdlibAlignConfig& config, EdlibWorkspace& workspace, EdlibAlignResult64* result);
+
+static EdlibAlignResult64 toAlignResult64(EdlibAlignResult result);
+
+static EdlibAlignResult createEmptyAlignResult();
+
+template <typename AlignResult>
+static void setAlignmentRuns(const unsigned char* alignments, AlignResult* result);
+
+static void alignEmptySequences(int queryLength, int targetLength, EdlibAlignMode mode,
+                                const EdlibAffineCosts* affineCosts, EdlibAlignResult* result);
+
+static bool areValidAffineCosts(const EdlibAffineCosts& costs, int queryLength, int targetLength);
+
+static inline int getMaxNumAffineBandRows(int queryLength, int k, const EdlibAffineCosts& costs);
+
+static void alignAffine(const unsigned char* query, int queryLength,
+                        const unsigned char* target, int targetLength,
+                        const EqualityDefinition& equalityDefinition, const EdlibAlignConfig& config,
+                        EdlibWorkspace& workspace, EdlibAlignResult* result);
+
+static int affineCalcScore(const unsigned char* query, int queryLength,
+                           const unsigned char* target, int targetLength,
+                           const EqualityDefinition& equalityDefinition, const EdlibAffineCosts& costs,
+                           EdlibAlignMode mode, int k, Arena& arena,
+                           int* bestScore, vector<int>* positions, vector<int>* starts,
+                           AffineTrace* trace, WorkCounters* counters);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void findEditDistance(const Word* Peq, int W, int maxNumBlocks,
+                             const unsigned char* query, int queryLength,
+                             const unsigned char* target, int targetLength,
+                             const EqualityDefinition& equalityDefinition, int alphabetLength,
+                             const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                             EdlibAlignResult* result);
+
+static int qgramLowerBound(const unsigned char* query, int queryLength,
+                           const unsigned char* target, int targetLength,
+                           int alphabetLength, EdlibAlignMode mode, Arena& arena);
+
+static int diagonalTransitionEditDistance(const unsigned char* query, int queryLength,
+                                          const unsigned char* target, int targetLength,
+                                          const EqualityDefinition& equalityDefinition, EdlibAlignMode mode,
+                                          int W, int maxDistance, Arena& arena, vector<int>* positions);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static void findStartLocationsAndAlignment(const unsigned char* query, const unsigned char* rQuery,
+                                           int queryLength,
+                                           const unsigned char* target, int targetLength,
+                                           const EqualityDefinition& equalityDefinition, int alphabetLength,
+                                           const Word* Peq, const Word* rPeq,
+                                           const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                                           EdlibAlignResult* result);
 
 static inline int ceilDiv(int x, int y);
 
-static inline unsigned char* createReverseCopy(const unsigned char* seq, int length);
+static inline bool useShortWords(int queryLength);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static inline int getMaxNumBandBlocks(int maxNumBlocks, int k);
+
+static inline unsigned char* createReverseCopy(const unsigned char* seq, int length, Arena& arena);
 
+static inline uint64_t hashSequence(const unsigned char* seq, int length);
+
+static inline uint64_t hashSeed(const char* seed, int seedLength);
+
+template <typename Code, typename Function>
+static bool forEachCigarOperation(const unsigned char* alignment, int alignmentLength,
+                                  const Code* moveCodes, const Function& function);
+
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static inline Word* buildPeq(const int alphabetLength,
                              const unsigned char* query,
                              const int queryLength,
-                             const EqualityDefinition& equalityDefinition);
+                             const EqualityDefinition& equalityDefinition,
+                             Arena& arena);
 
 
 /**
@@ -146,6 +840,973 @@ static inline Word* buildPeq(const int alphabetLength,
 extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const int queryLength,
                                        const char* const targetOriginal, const int targetLength,
                                        const EdlibAlignConfig config) {
+    EdlibAlignResult result = createEmptyAlignResult();
+    if (config.stats) *config.stats = EdlibAlignStats();
+    EdlibWorkspace localWorkspace;
+    EdlibWorkspace& workspace = config.workspace ? *config.workspace : localWorkspace;
+    workspace.arena.reset();
+
+    /*------------ TRANSFORM SEQUENCES AND RECOGNIZE ALPHABET -----------*/
+    unsigned char* query, * target;
+    string alphabet = transformSequences(queryOriginal, queryLength, targetOriginal, targetLength,
+                                         &query, &target, workspace.arena);
+    result.alphabetLength = static_cast<int>(alphabet.size());
+    /*-------------------------------------------------------*/
+
+    // Handle special situation when at least one of the sequences has length 0.
+    if (queryLength == 0 || targetLength == 0) {
+        alignEmptySequences(queryLength, targetLength, config.mode, config.affineCosts, &result);
+        return result;
+    }
+
+    /*------------------ MAIN CALCULATION -------------------*/
+    EqualityDefinition equalityDefinition(alphabet, config.additionalEqualities, config.additionalEqualitiesLength);
+    if (config.affineCosts) {
+        alignAffine(query, queryLength, target, targetLength, equalityDefinition, config, workspace, &result);
+    } else if (useShortWords(queryLength)) {
+        alignWithWords<uint32_t>(query, NULL, queryLength, target, targetLength,
+                                 equalityDefinition, static_cast<int>(alphabet.size()),
+                                 static_cast<const uint32_t*>(NULL), NULL, config, workspace, &result);
+    } else {
+        alignWithWords<uint64_t>(query, NULL, queryLength, target, targetLength,
+                                 equalityDefinition, static_cast<int>(alphabet.size()),
+                                 static_cast<const uint64_t*>(NULL), NULL, config, workspace, &result);
+    }
+    /*-------------------------------------------------------*/
+
+    return result;
+}
+
+extern "C" EdlibAlignResult64 edlibAlign64(const char* const queryOriginal, const int queryLength,
+                                           const char* const targetOriginal, const long long targetLength,
+                                           const EdlibAlignConfig config_) {
+    EdlibAlignConfig config = config_;
+    config.stats = NULL;  // Stats are not collected, since long targets are not aligned as a whole.
+    // Target that is not longer than one part is aligned as a whole, and so is query of length 0,
+    // since there is nothing to calculate.
+    if (targetLength <= LONG_TARGET_PART_LENGTH || config.mode == EDLIB_MODE_NW || queryLength == 0) {
+        if (targetLength > INT_MAX) {
+            EdlibAlignResult64 result = toAlignResult64(createEmptyAlignResult());
+            result.status = EDLIB_STATUS_ERROR;
+            return result;
+        }
+        return toAlignResult64(edlibAlign(queryOriginal, queryLength, targetOriginal,
+                                          static_cast<int>(targetLength), config));
+    }
+
+    EdlibAlignResult64 result = toAlignResult64(createEmptyAlignResult());
+    if (config.affineCosts) {  // Long target is aligned in parts only with edit distance.
+        result.status = EDLIB_STATUS_ERROR;
+        return result;
+    }
+    EdlibWorkspace localWorkspace;
+    EdlibWorkspace& workspace = config.workspace ? *config.workspace : localWorkspace;
+    workspace.arena.reset();
+    EdlibQueryProfile* const profile = edlibCreateQueryProfile(queryOriginal, queryLength,
+                                                               config.additionalEqualities,
+                                                               config.additionalEqualitiesLength);
+    if (useShortWords(queryLength)) {
+        alignLongTarget<uint32_t>(*profile, targetOriginal, targetLength, config, workspace, &result);
+    } else {
+        alignLongTarget<uint64_t>(*profile, targetOriginal, targetLength, config, workspace, &result);
+    }
+    edlibFreeQueryProfile(profile);
+    return result;
+}
+
+extern "C" void edlibAlignBatch(const char* const queryOriginal, const int queryLength,
+                                const char* const* const targetsOriginal, const int* const targetLengths,
+                                const int numTargets, const EdlibAlignConfig config_,
+                                EdlibAlignResult* const results) {
+    if (numTargets <= 0) {
+        return;
+    }
+    EdlibAlignConfig config = config_;
+    config.stats = NULL;  // Targets are aligned together, so there are no stats of one alignment.
+    EdlibWorkspace localWorkspace;
+    EdlibWorkspace& workspace = config.workspace ? *config.workspace : localWorkspace;
+    workspace.arena.reset();
+
+    /*------------ TRANSFORM SEQUENCES AND RECOGNIZE ALPHABET -----------*/
+    // All targets are transformed together with query, so they share the alphabet and query profile.
+    unsigned char* query, * targetsData;
+    const unsigned char** const targets = workspace.arena.allocate<const unsigned char*>(numTargets);
+    string alphabet = transformSequencesBatch(queryOriginal, queryLength, targetsOriginal, targetLengths, numTargets,
+                                              &query, &targetsData, targets, workspace.arena);
+    /*-------------------------------------------------------*/
+
+    if (useShortWords(queryLength)) {
+        alignBatchWithWords<uint32_t>(query, queryOriginal, queryLength, targets, targetsOriginal, targetLengths,
+                                      numTargets, alphabet, config, workspace, results);
+    } else {
+        alignBatchWithWords<uint64_t>(query, queryOriginal, queryLength, targets, targetsOriginal, targetLengths,
+                                      numTargets, alphabet, config, workspace, results);
+    }
+}
+
+extern "C" EdlibQueryProfile* edlibCreateQueryProfile(const char* const queryOriginal, const int queryLength,
+                                                      const EdlibEqualityPair* const additionalEqualities,
+                                                      const int additionalEqualitiesLength) {
+    EdlibQueryProfile* profile = new EdlibQueryProfile;
+    profile->queryLength = queryLength;
+
+    // Transform query the same way as transformSequences() does. Characters from additional equalities are
+    // also added to alphabet, since they may be equal to characters from query.
+    char alphabet[MAX_UCHAR + 1];
+    int alphabetSize = 0;
+    bool inAlphabet[MAX_UCHAR + 1];
+    for (int i = 0; i < MAX_UCHAR + 1; i++) inAlphabet[i] = profile->inQuery[i] = false;
+    profile->query = profile->arena.allocate<unsigned char>(queryLength);
+    for (int i = 0; i < queryLength; i++) {
+        unsigned char c = static_cast<unsigned char>(queryOriginal[i]);
+        if (!inAlphabet[c]) {
+            inAlphabet[c] = profile->inQuery[c] = true;
+            const unsigned char idx = static_cast<unsigned char>(alphabetSize++);
+            profile->letterIdx[c] = idx;
+            alphabet[idx] = queryOriginal[i];
+        }
+        profile->query[i] = profile->letterIdx[c];
+    }
+    profile->queryAlphabetLength = alphabetSize;
+    for (int i = 0; additionalEqualities != NULL && i < 2 * additionalEqualitiesLength; i++) {
+        const char letter = i % 2 ? additionalEqualities[i / 2].second : additionalEqualities[i / 2].first;
+        unsigned char c = static_cast<unsigned char>(letter);
+        if (!inAlphabet[c]) {
+            inAlphabet[c] = true;
+            const unsigned char idx = static_cast<unsigned char>(alphabetSize++);
+            profile->letterIdx[c] = idx;
+            alphabet[idx] = letter;
+        }
+    }
+    // All other characters are never equal to any character from query, so they can share one letter.
+    // First of them is used to represent that letter in alphabet.
+    if (alphabetSize < MAX_UCHAR + 1) {
+        const unsigned char otherIdx = static_cast<unsigned char>(alphabetSize++);
+        for (int c = MAX_UCHAR; c >= 0; c--) {
+            if (!inAlphabet[c]) {
+                profile->letterIdx[c] = otherIdx;
+                alphabet[otherIdx] = static_cast<char>(c);
+            }
+        }
+    }
+    profile->alphabetLength = alphabetSize;
+    profile->equalityDefinition = new EqualityDefinition(string(alphabet, alphabetSize),
+                                                         additionalEqualities, additionalEqualitiesLength);
+
+    profile->rQuery = createReverseCopy(profile->query, queryLength, profile->arena);
+    if (useShortWords(queryLength)) {
+        profile->Peq = buildPeq<uint32_t>(alphabetSize, profile->query, queryLength, *(profile->equalityDefinition),
+                                          profile->arena);
+        profile->rPeq = buildPeq<uint32_t>(alphabetSize, profile->rQuery, queryLength,
+                                           *(profile->equalityDefinition), profile->arena);
+    } else {
+        profile->Peq = buildPeq<uint64_t>(alphabetSize, profile->query, queryLength, *(profile->equalityDefinition),
+                                          profile->arena);
+        profile->rPeq = buildPeq<uint64_t>(alphabetSize, profile->rQuery, queryLength,
+                                           *(profile->equalityDefinition), profile->arena);
+    }
+
+    return profile;
+}
+
+extern "C" EdlibAlignResult edlibAlignWithProfile(const EdlibQueryProfile* const profile,
+                                                  const char* const targetOriginal, const int targetLength,
+                                                  const EdlibAlignConfig config) {
+    EdlibAlignResult result = createEmptyAlignResult();
+    if (config.stats) *config.stats = EdlibAlignStats();
+    const int queryLength = profile->queryLength;
+    EdlibWorkspace localWorkspace;
+    EdlibWorkspace& workspace = config.workspace ? *config.workspace : localWorkspace;
+    workspace.arena.reset();
+
+    /*------------------- TRANSFORM TARGET ------------------*/
+    unsigned char* target = workspace.arena.allocate<unsigned char>(targetLength);
+    // Alphabet length is reported same as in edlibAlign(), that is number of unique characters in query and target.
+    bool inAlphabet[MAX_UCHAR + 1];
+    memcpy(inAlphabet, profile->inQuery, sizeof(inAlphabet));
+    result.alphabetLength = profile->queryAlphabetLength;
+    for (int i = 0; i < targetLength; i++) {
+        unsigned char c = static_cast<unsigned char>(targetOriginal[i]);
+        if (!inAlphabet[c]) {
+            inAlphabet[c] = true;
+            result.alphabetLength++;
+        }
+        target[i] = profile->letterIdx[c];
+    }
+    /*-------------------------------------------------------*/
+
+    // Handle special situation when at least one of the sequences has length 0.
+    if (queryLength == 0 || targetLength == 0) {
+        alignEmptySequences(queryLength, targetLength, config.mode, config.affineCosts, &result);
+        return result;
+    }
+
+    /*------------------ MAIN CALCULATION -------------------*/
+    if (config.affineCosts) {
+        alignAffine(profile->query, queryLength, target, targetLength, *(profile->equalityDefinition),
+                    config, workspace, &result);
+    } else if (useShortWords(queryLength)) {
+        alignWithWords(profile->query, profile->rQuery, queryLength, target, targetLength,
+                       *(profile->equalityDefinition), profile->alphabetLength,
+                       static_cast<const uint32_t*>(profile->Peq), static_cast<const uint32_t*>(profile->rPeq),
+                       config, workspace, &result);
+    } else {
+        alignWithWords(profile->query, profile->rQuery, queryLength, target, targetLength,
+                       *(profile->equalityDefinition), profile->alphabetLength,
+                       static_cast<const uint64_t*>(profile->Peq), static_cast<const uint64_t*>(profile->rPeq),
+                       config, workspace, &result);
+    }
+    /*-------------------------------------------------------*/
+
+    return result;
+}
+
+extern "C" void edlibFreeQueryProfile(EdlibQueryProfile* const profile) {
+    if (profile == NULL) return;
+    delete profile->equalityDefinition;
+    delete profile;
+}
+
+extern "C" void edlibAlignMany(const char* const query, const int queryLength,
+                               const char* const* const targets, const int* const targetLengths,
+                               const int numTargets, const EdlibAlignConfig config,
+                               const EdlibAlignCallback callback, void* const userData) {
+    EdlibQueryProfile* const profile = edlibCreateQueryProfile(query, queryLength, config.additionalEqualities,
+                                                               config.additionalEqualitiesLength);
+    EdlibWorkspace localWorkspace;
+    EdlibAlignConfig targetConfig = config;
+    if (!targetConfig.workspace) targetConfig.workspace = &localWorkspace;
+
+    for (int i = 0; i < numTargets; i++) {
+        EdlibAlignResult result = edlibAlignWithProfile(profile, targets[i], targetLengths[i], targetConfig);
+        const int k = callback(i, &result, userData);
+        edlibFreeAlignResult(result);
+        if (k < -1) break;
+        targetConfig.k = k;
+    }
+
+    edlibFreeQueryProfile(profile);
+}
+
+extern "C" int edlibAlignTopN(const char* const query, const int queryLength,
+                              const char* const* const targets, const int* const targetLengths,
+                              const int numTargets, const int numBest, const EdlibAlignConfig config,
+                              EdlibAlignResult* const results, int* const targetIdxs) {
+    if (numBest <= 0) return 0;
+    EdlibQueryProfile* const profile = edlibCreateQueryProfile(query, queryLength, config.additionalEqualities,
+                                                               config.additionalEqualitiesLength);
+    EdlibWorkspace localWorkspace;
+    EdlibAlignConfig targetConfig = config;
+    if (!targetConfig.workspace) targetConfig.workspace = &localWorkspace;
+
+    // Only edit distances are needed to find best targets, rest is found only for best targets at the end.
+    targetConfig.task = EDLIB_TASK_DISTANCE;
+    targetConfig.stats = NULL;
+    // Best targets found so far, as pairs of edit distance and target index, with the worst one on top.
+    priority_queue< pair<int, int> > best;
+    for (int i = 0; i < numTargets; i++) {
+        int k = config.k;
+        if (static_cast<int>(best.size()) == numBest) {
+            // Target has larger index than best targets, so it has to be strictly better than the worst of them.
+            if (best.top().first == 0) break;
+            k = best.top().first - 1;
+        }
+        targetConfig.k = k;
+        EdlibAlignResult result = edlibAlignWithProfile(profile, targets[i], targetLengths[i], targetConfig);
+        // Edit distance is not limited by k if one of sequences is empty.
+        if (result.status == EDLIB_STATUS_OK && result.editDistance >= 0 && (k < 0 || result.editDistance <= k)) {
+            best.push(make_pair(result.editDistance, i));
+            if (static_cast<int>(best.size()) > numBest) best.pop();
+        }
+        edlibFreeAlignResult(result);
+    }
+
+    const int numFound = static_cast<int>(best.size());
+    vector<int> bestScores(numFound);
+    for (int j = numFound - 1; j >= 0; j--) {
+        bestScores[j] = best.top().first;
+        targetIdxs[j] = best.top().second;
+        best.pop();
+    }
+    targetConfig.task = config.task;
+    for (int j = 0; j < numFound; j++) {
+        const int i = targetIdxs[j];
+        // Edit distance is known, so k is set to it to make alignment faster.
+        targetConfig.k = bestScores[j];
+        results[j] = edlibAlignWithProfile(profile, targets[i], targetLengths[i], targetConfig);
+    }
+
+    edlibFreeQueryProfile(profile);
+    return numFound;
+}
+
+extern "C" void edlibAlignPairs(const char* const* const queries, const int* const queryLengths,
+                                const char* const* const targets, const int* const targetLengths,
+                                const int numPairs, const EdlibAlignConfig config, const int numThreads,
+                                EdlibAlignResult* const results) {
+    // Pairs are taken in chunks, so that threads do not compete for the counter when alignments are short.
+    const int CHUNK_SIZE = 16;
+    atomic<int> nextPair(0);
+    auto alignPairs = [&]() {
+        EdlibWorkspace workspace;  // Reused for all alignments in this thread.
+        EdlibAlignConfig pairConfig = config;
+        pairConfig.workspace = &workspace;
+        pairConfig.stats = NULL;
+        while (true) {
+            const int start = nextPair.fetch_add(CHUNK_SIZE);
+            if (start >= numPairs) break;
+            const int end = min(numPairs - start, CHUNK_SIZE) + start;
+            for (int i = start; i < end; i++) {
+                results[i] = edlibAlign(queries[i], queryLengths[i], targets[i], targetLengths[i], pairConfig);
+            }
+        }
+    };
+
+    vector<std::thread> threads;
+    for (int t = 1; t < min(numThreads, (numPairs + CHUNK_SIZE - 1) / CHUNK_SIZE); t++) {
+        try {
+            threads.push_back(std::thread(alignPairs));
+        } catch (const std::system_error&) {
+            break;  // Pairs are aligned in threads that were created.
+        }
+    }
+    alignPairs();
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+}
+
+extern "C" int edlibFindHits(const char* const queryOriginal, const int queryLength,
+                             const char* const targetOriginal, const int targetLength,
+                             const EdlibAlignConfig config, const int suppressionRadius,
+                             EdlibHit** const hits) {
+    *hits = NULL;
+    if (config.k < 0 || (config.mode != EDLIB_MODE_HW && config.mode != EDLIB_MODE_SHW) || config.affineCosts) {
+        return -1;
+    }
+    EdlibWorkspace localWorkspace;
+    EdlibWorkspace& workspace = config.workspace ? *config.workspace : localWorkspace;
+    workspace.arena.reset();
+
+    unsigned char* query, * target;
+    string alphabet = transformSequences(queryOriginal, queryLength, targetOriginal, targetLength,
+                                         &query, &target, workspace.arena);
+
+    vector<int> positions, scores;
+    if (queryLength == 0 || targetLength == 0) {
+        EdlibAlignResult result = createEmptyAlignResult();
+        alignEmptySequences(queryLength, targetLength, config.mode, NULL, &result);
+        if (result.editDistance <= config.k) {
+            positions.push_back(result.endLocations[0]);
+            scores.push_back(result.editDistance);
+        }
+        edlibFreeAlignResult(result);
+    } else {
+        EqualityDefinition equalityDefinition(alphabet, config.additionalEqualities,
+                                              config.additionalEqualitiesLength);
+        if (useShortWords(queryLength)) {
+            findHitsWithWords<uint32_t>(query, queryLength, target, targetLength,
+                                        equalityDefinition, static_cast<int>(alphabet.size()),
+                                        config.k, config.mode, workspace.arena, &positions, &scores);
+        } else {
+            findHitsWithWords<uint64_t>(query, queryLength, target, targetLength,
+                                        equalityDefinition, static_cast<int>(alphabet.size()),
+                                        config.k, config.mode, workspace.arena, &positions, &scores);
+        }
+    }
+    return collectHits(positions, scores, suppressionRadius, hits);
+}
+
+/**
+ * Finds all positions in target where alignment of query ends with score of at most k.
+ * Query and target must not be empty.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] alphabetLength
+ * @param [in] k
+ * @param [in] mode  EDLIB_MODE_HW or EDLIB_MODE_SHW.
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [out] positions  Positions in target, in increasing order.
+ * @param [out] scores  Score for each of positions.
+ */
+template <typename Word, int WORD_SIZE>
+static void findHitsWithWords(const unsigned char* const query, const int queryLength,
+                              const unsigned char* const target, const int targetLength,
+                              const EqualityDefinition& equalityDefinition, const int alphabetLength,
+                              const int k, const EdlibAlignMode mode, Arena& arena,
+                              vector<int>* const positions, vector<int>* const scores) {
+    const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
+    const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    const Word* const Peq = buildPeq<Word>(alphabetLength, query, queryLength, equalityDefinition, arena);
+    int bestScore;
+    myersCalcEditDistanceSemiGlobal(Peq, W, maxNumBlocks, queryLength, target, targetLength,
+                                    k, mode, arena, &bestScore, positions, scores, NULL);
+}
+
+/**
+ * Turns found positions and their scores into array of hits, skipping those that are suppressed
+ * by better hits around them.
+ * @param [in] positions  Positions in increasing order.
+ * @param [in] scores  Score for each of positions.
+ * @param [in] suppressionRadius  See edlibFindHits().
+ * @param [out] hits  Set to array of hits, or to NULL if there are none.
+ * @return Number of hits.
+ */
+static int collectHits(const vector<int>& positions, const vector<int>& scores, const int suppressionRadius,
+                       EdlibHit** const hits) {
+    const int numPositions = static_cast<int>(positions.size());
+    vector<bool> suppressed(numPositions, false);
+    if (suppressionRadius > 0) {
+        // Minimum of scores in window before (and then after) each position is maintained in a deque of
+        // positions with increasing scores, so that each position is pushed and popped only once.
+        deque<int> window;
+        for (int i = 0; i < numPositions; i++) {
+            while (!window.empty() && positions[window.front()] < positions[i] - suppressionRadius) {
+                window.pop_front();
+            }
+            if (!window.empty() && scores[window.front()] <= scores[i]) suppressed[i] = true;
+            while (!window.empty() && scores[window.back()] >= scores[i]) window.pop_back();
+            window.push_back(i);
+        }
+        window.clear();
+        for (int i = numPositions - 1; i >= 0; i--) {
+            while (!window.empty() && positions[window.front()] > positions[i] + suppressionRadius) {
+                window.pop_front();
+            }
+            if (!window.empty() && scores[window.front()] < scores[i]) suppressed[i] = true;
+            while (!window.empty() && scores[window.back()] >= scores[i]) window.pop_back();
+            window.push_back(i);
+        }
+    }
+
+    int numHits = 0;
+    for (int i = 0; i < numPositions; i++) {
+        numHits += !suppressed[i];
+    }
+    *hits = numHits > 0 ? static_cast<EdlibHit*>(malloc(numHits * sizeof(EdlibHit))) : NULL;
+    for (int i = 0, h = 0; i < numPositions; i++) {
+        if (!suppressed[i]) {
+            (*hits)[h].endLocation = positions[i];
+            (*hits)[h].editDistance = scores[i];
+            h++;
+        }
+    }
+    return numHits;
+}
+
+extern "C" EdlibStreamSearch* edlibCreateStreamSearch(const char* const query, const int queryLength,
+                                                      const EdlibAlignConfig config) {
+    if (queryLength <= 0 || config.k < 0 || (config.mode != EDLIB_MODE_HW && config.mode != EDLIB_MODE_SHW)
+        || config.affineCosts) {
+        return NULL;
+    }
+    EdlibStreamSearch* search = new EdlibStreamSearch;
+    search->profile = edlibCreateQueryProfile(query, queryLength, config.additionalEqualities,
+                                              config.additionalEqualitiesLength);
+    search->mode = config.mode;
+    search->bandExists = true;
+    search->targetLength = 0;
+    if (useShortWords(queryLength)) {
+        search->maxNumBlocks = ceilDiv(queryLength, 32);
+        initSemiGlobalState(search->maxNumBlocks, queryLength, config.k,
+                            search->arena.allocate<Block<uint32_t> >(search->maxNumBlocks), &search->state32);
+    } else {
+        search->maxNumBlocks = ceilDiv(queryLength, 64);
+        initSemiGlobalState(search->maxNumBlocks, queryLength, config.k,
+                            search->arena.allocate<Block<uint64_t> >(search->maxNumBlocks), &search->state64);
+    }
+    search->W = search->maxNumBlocks * (useShortWords(queryLength) ? 32 : 64) - queryLength;
+    return search;
+}
+
+extern "C" int edlibStreamSearchFeed(EdlibStreamSearch* const search,
+                                     const char* const targetPart, const int targetPartLength,
+                                     const EdlibHit** const hits) {
+    search->targetPart.resize(targetPartLength);
+    for (int i = 0; i < targetPartLength; i++) {
+        search->targetPart[i] = search->profile->letterIdx[static_cast<unsigned char>(targetPart[i])];
+    }
+    if (useShortWords(search->profile->queryLength)) {
+        feedStreamSearch(search, &search->state32, false);
+    } else {
+        feedStreamSearch(search, &search->state64, false);
+    }
+    *hits = search->hits.data();
+    return static_cast<int>(search->hits.size());
+}
+
+extern "C" int edlibStreamSearchFinish(EdlibStreamSearch* const search, const EdlibHit** const hits) {
+    search->targetPart.clear();
+    if (useShortWords(search->profile->queryLength)) {
+        feedStreamSearch(search, &search->state32, true);
+    } else {
+        feedStreamSearch(search, &search->state64, true);
+    }
+    *hits = search->hits.data();
+    return static_cast<int>(search->hits.size());
+}
+
+extern "C" void edlibFreeStreamSearch(EdlibStreamSearch* const search) {
+    if (search == NULL) return;
+    edlibFreeQueryProfile(search->profile);
+    delete search;
+}
+
+extern "C" EdlibTargetIndex* edlibCreateTargetIndex(const char* const target, const int targetLength,
+                                                    const int seedLength) {
+    if (targetLength < 0 || seedLength <= 0) return NULL;
+    EdlibTargetIndex* index = new EdlibTargetIndex;
+    index->target.assign(target, target + targetLength);
+    index->seedLength = seedLength;
+    for (int c = 0; c <= MAX_UCHAR; c++) index->inTarget[c] = false;
+    for (int i = 0; i < targetLength; i++) index->inTarget[static_cast<unsigned char>(target[i])] = true;
+
+    // There are about as many buckets as seeds, so buckets are small.
+    const int numSeeds = max(targetLength - seedLength + 1, 0);
+    index->bucketBits = 1;
+    while (index->bucketBits < MAX_TARGET_INDEX_BUCKET_BITS && (1 << index->bucketBits) < numSeeds) {
+        index->bucketBits++;
+    }
+    // Seeds are hashed with rolling hash and sorted into buckets with counting sort.
+    vector<int> buckets(numSeeds);
+    uint64_t highestPower = 1;  // SEED_HASH_BASE^(seedLength - 1)
+    for (int i = 1; i < seedLength; i++) highestPower *= SEED_HASH_BASE;
+    uint64_t seedHash = numSeeds > 0 ? hashSeed(target, seedLength) : 0;
+    for (int i = 0; i < numSeeds; i++) {
+        if (i > 0) {
+            seedHash = (seedHash - highestPower * static_cast<unsigned char>(target[i - 1])) * SEED_HASH_BASE
+                + static_cast<unsigned char>(target[i + seedLength - 1]);
+        }
+        buckets[i] = seedBucket(seedHash, index->bucketBits);
+    }
+    index->bucketStarts.assign((static_cast<size_t>(1) << index->bucketBits) + 1, 0);
+    for (int i = 0; i < numSeeds; i++) index->bucketStarts[buckets[i] + 1]++;
+    for (size_t b = 1; b < index->bucketStarts.size(); b++) index->bucketStarts[b] += index->bucketStarts[b - 1];
+    index->positions.resize(numSeeds);
+    vector<int> nextIdx(index->bucketStarts.begin(), index->bucketStarts.end() - 1);
+    for (int i = 0; i < numSeeds; i++) index->positions[nextIdx[buckets[i]]++] = i;
+    return index;
+}
+
+extern "C" EdlibAlignResult edlibAlignWithIndex(const char* const query, const int queryLength,
+                                                const EdlibTargetIndex* const index,
+                                                const EdlibAlignConfig config) {
+    const char* const target = index->target.data();
+    const int targetLength = static_cast<int>(index->target.size());
+    vector< pair<int, int> > windows;
+    if (!findCandidateWindows(*index, query, queryLength, config, &windows)) {
+        windows.assign(1, make_pair(0, targetLength - 1));
+    }
+    EdlibQueryProfile* const profile = edlibCreateQueryProfile(query, queryLength, config.additionalEqualities,
+                                                               config.additionalEqualitiesLength);
+    EdlibAlignConfig windowConfig = config;
+    windowConfig.stats = NULL;
+    windowConfig.runLengthAlignment = 0;  // Alignments of windows are joined first.
+    EdlibWorkspace localWorkspace;
+    if (!windowConfig.workspace) windowConfig.workspace = &localWorkspace;
+
+    // Each window is aligned separately, and results with the best edit distance are joined.
+    // Windows do not overlap, so alignment that ends in a window and has edit distance of at most k
+    // is contained in it, and it is found there.
+    EdlibAlignResult result = createEmptyAlignResult();
+    vector<int> startLocations, endLocations;
+    vector<unsigned char> alignment;
+    vector<int> alignmentLengths;
+    const int maxAlignments = config.maxAlignments < 0 ? INT_MAX : max(config.maxAlignments, 1);
+    for (const pair<int, int>& window : windows) {
+        if (result.editDistance >= 0) windowConfig.k = result.editDistance;
+        // Alignments are found only for as many locations as are still needed.
+        const int numMissingAlignments = maxAlignments - static_cast<int>(alignmentLengths.size());
+        windowConfig.task = config.task == EDLIB_TASK_PATH && numMissingAlignments <= 0
+            ? EDLIB_TASK_LOC : config.task;
+        windowConfig.maxAlignments = config.maxAlignments < 0 ? config.maxAlignments : numMissingAlignments;
+        EdlibAlignResult windowResult = edlibAlignWithProfile(profile, target + window.first,
+                                                              window.second - window.first + 1, windowConfig);
+        if (windowResult.status != EDLIB_STATUS_OK) {
+            result.status = windowResult.status;
+            edlibFreeAlignResult(windowResult);
+            break;
+        }
+        if (windowResult.editDistance >= 0 && (result.editDistance < 0
+                                               || windowResult.editDistance < result.editDistance)) {
+            if (windowConfig.task != config.task) {
+                // Alignments were not needed for worse edit distance found before, but they are now.
+                windowConfig.k = windowResult.editDistance;
+                windowConfig.task = config.task;
+                windowConfig.maxAlignments = config.maxAlignments;
+                edlibFreeAlignResult(windowResult);
+                windowResult = edlibAlignWithProfile(profile, target + window.first,
+                                                     window.second - window.first + 1, windowConfig);
+            }
+            result.editDistance = windowResult.editDistance;
+            startLocations.clear();
+            endLocations.clear();
+            alignment.clear();
+            alignmentLengths.clear();
+        }
+        if (windowResult.editDistance >= 0 && windowResult.editDistance == result.editDistance) {
+            for (int i = 0; i < windowResult.numLocations; i++) {
+                // Position -1 of empty alignment is not shifted.
+                const int shift = windowResult.endLocations[i] >= 0 ? window.first : 0;
+                endLocations.push_back(windowResult.endLocations[i] + shift);
+                if (windowResult.startLocations) startLocations.push_back(windowResult.startLocations[i] + shift);
+            }
+            size_t alignmentStart = 0;
+            for (int i = 0; i < windowResult.numAlignments; i++) {
+                alignmentLengths.push_back(windowResult.alignmentLengths[i]);
+                alignmentStart += windowResult.alignmentLengths[i];
+            }
+            alignment.insert(alignment.end(), windowResult.alignment, windowResult.alignment + alignmentStart);
+        }
+        edlibFreeAlignResult(windowResult);
+    }
+
+    // Alphabet length is reported same as in edlibAlign(), that is number of unique characters in query and target.
+    bool inAlphabet[MAX_UCHAR + 1];
+    memcpy(inAlphabet, index->inTarget, sizeof(inAlphabet));
+    for (int i = 0; i < queryLength; i++) inAlphabet[static_cast<unsigned char>(query[i])] = true;
+    for (int c = 0; c <= MAX_UCHAR; c++) result.alphabetLength += inAlphabet[c];
+    if (result.status == EDLIB_STATUS_OK && result.editDistance >= 0) {
+        result.numLocations = static_cast<int>(endLocations.size());
+        result.endLocations = static_cast<int *>(malloc(sizeof(int) * result.numLocations));
+        copy(endLocations.begin(), endLocations.end(), result.endLocations);
+        // Start locations and alignments are not found if one of sequences is empty.
+        if (!startLocations.empty()) {
+            result.startLocations = static_cast<int *>(malloc(sizeof(int) * result.numLocations));
+            copy(startLocations.begin(), startLocations.end(), result.startLocations);
+        }
+        if (!alignmentLengths.empty()) {
+            result.numAlignments = min(static_cast<int>(alignmentLengths.size()), maxAlignments);
+            result.alignmentLengths = static_cast<int *>(malloc(sizeof(int) * result.numAlignments));
+            copy(alignmentLengths.begin(), alignmentLengths.begin() + result.numAlignments, result.alignmentLengths);
+            result.alignmentLength = alignmentLengths[0];
+            if (config.runLengthAlignment) {
+                setAlignmentRuns(alignment.data(), &result);
+            } else {
+                result.alignment = static_cast<unsigned char *>(malloc(max(alignment.size(), static_cast<size_t>(1))));
+                copy(alignment.begin(), alignment.end(), result.alignment);
+            }
+        }
+    }
+    edlibFreeQueryProfile(profile);
+    return result;
+}
+
+extern "C" int edlibFindHitsWithIndex(const char* const query, const int queryLength,
+                                      const EdlibTargetIndex* const index,
+                                      const EdlibAlignConfig config, const int suppressionRadius,
+                                      EdlibHit** const hits) {
+    *hits = NULL;
+    if (config.k < 0 || (config.mode != EDLIB_MODE_HW && config.mode != EDLIB_MODE_SHW) || config.affineCosts) {
+        return -1;
+    }
+    const char* const target = index->target.data();
+    const int targetLength = static_cast<int>(index->target.size());
+    vector< pair<int, int> > windows;
+    if (!findCandidateWindows(*index, query, queryLength, config, &windows)) {
+        return edlibFindHits(query, queryLength, target, targetLength, config, suppressionRadius, hits);
+    }
+
+    // Hit with edit distance of at most k is found in the window that it ends in, with same edit distance.
+    vector<int> positions, scores;
+    for (const pair<int, int>& window : windows) {
+        EdlibHit* windowHits;
+        const int numWindowHits = edlibFindHits(query, queryLength, target + window.first,
+                                                window.second - window.first + 1, config, 0, &windowHits);
+        for (int i = 0; i < numWindowHits; i++) {
+            positions.push_back(static_cast<int>(windowHits[i].endLocation) + window.first);
+            scores.push_back(windowHits[i].editDistance);
+        }
+        free(windowHits);
+    }
+    return collectHits(positions, scores, suppressionRadius, hits);
+}
+
+extern "C" void edlibFreeTargetIndex(EdlibTargetIndex* const index) {
+    delete index;
+}
+
+/**
+ * Finds parts of target that contain all alignments of query with edit distance of at most k,
+ * as described for EdlibTargetIndex.
+ * @param [in] index
+ * @param [in] query
+ * @param [in] queryLength
+ * @param [in] config
+ * @param [out] windows  Parts of target, as pairs of first and last position, sorted and not overlapping.
+ * @return False if index can not be used for given query and config, in which case whole target
+ *         has to be searched.
+ */
+static bool findCandidateWindows(const EdlibTargetIndex& index, const char* const query, const int queryLength,
+                                 const EdlibAlignConfig& config, vector< pair<int, int> >* const windows) {
+    const int seedLength = index.seedLength;
+    const int k = config.k;
+    // With additional equalities, characters that are not the same can match, which index does not know about.
+    if (config.mode != EDLIB_MODE_HW || k < 0 || config.additionalEqualitiesLength > 0 || config.affineCosts
+        || queryLength / seedLength <= k) {
+        return false;
+    }
+    // Any k + 1 non-overlapping seeds of query are enough, so those from the smallest buckets are used.
+    const int numSeeds = queryLength / seedLength;
+    vector< pair<int, int> > seeds(numSeeds);  // Pairs of bucket size and position in query.
+    vector<int> seedBuckets(numSeeds);
+    for (int i = 0; i < numSeeds; i++) {
+        seedBuckets[i] = seedBucket(hashSeed(query + i * seedLength, seedLength), index.bucketBits);
+        seeds[i] = make_pair(index.bucketStarts[seedBuckets[i] + 1] - index.bucketStarts[seedBuckets[i]], i);
+    }
+    nth_element(seeds.begin(), seeds.begin() + k, seeds.end());
+
+    const int targetLength = static_cast<int>(index.target.size());
+    windows->clear();
+    for (int s = 0; s <= k; s++) {
+        const int seedIdx = seeds[s].second;
+        const char* const seed = query + seedIdx * seedLength;
+        const int queryPosition = seedIdx * seedLength;
+        const int bucket = seedBuckets[seedIdx];
+        for (int i = index.bucketStarts[bucket]; i < index.bucketStarts[bucket + 1]; i++) {
+            const int position = index.positions[i];
+            if (memcmp(index.target.data() + position, seed, seedLength) != 0) continue;  // Hash collision.
+            // Alignment that contains seed on this diagonal, with at most k insertions and deletions.
+            const long long first = static_cast<long long>(position) - queryPosition - k;
+            const long long last = static_cast<long long>(position) - queryPosition + queryLength - 1 + k;
+            windows->push_back(make_pair(static_cast<int>(max(first, 0LL)),
+                                         static_cast<int>(min(last, static_cast<long long>(targetLength - 1)))));
+        }
+    }
+    sort(windows->begin(), windows->end());
+    int numWindows = 0;
+    for (const pair<int, int>& window : *windows) {
+        if (numWindows > 0 && window.first <= (*windows)[numWindows - 1].second) {
+            (*windows)[numWindows - 1].second = max((*windows)[numWindows - 1].second, window.second);
+        } else {
+            (*windows)[numWindows++] = window;
+        }
+    }
+    windows->resize(numWindows);
+    return true;
+}
+
+/**
+ * Calculates columns for the current part of target in stream search and sets hits that were found.
+ * @param [in,out] search
+ * @param [in,out] state  State of search that is used for its query.
+ * @param [in] finish  If true, target has ended, and hits in its last positions are found instead.
+ */
+template <typename Word, int WORD_SIZE>
+static void feedStreamSearch(EdlibStreamSearch* const search, SemiGlobalState<Word>* const state,
+                             const bool finish) {
+    search->positions.clear();
+    search->scores.clear();
+    search->hits.clear();
+    if (!search->bandExists) return;
+
+    if (finish) {
+        finishSemiGlobal(search->W, search->maxNumBlocks, 0, state, &search->positions, &search->scores);
+    } else {
+        search->bandExists = calcSemiGlobalColumns(static_cast<const Word*>(search->profile->Peq),
+                                                   search->W, search->maxNumBlocks,
+                                                   search->targetPart.data(),
+                                                   static_cast<int>(search->targetPart.size()),
+                                                   search->mode, state, &search->positions, &search->scores,
+                                                   NULL);
+    }
+    for (size_t i = 0; i < search->positions.size(); i++) {
+        const EdlibHit hit = {search->targetLength + search->positions[i], search->scores[i]};
+        search->hits.push_back(hit);
+    }
+    search->targetLength += static_cast<long long>(search->targetPart.size());
+}
+
+/**
+ * Does the work of edlibAlign64() for HW and SHW, when target is longer than one part.
+ * Target is transformed and processed part by part, keeping state of Myers' algorithm between parts.
+ * Start locations and alignments are then found in parts of target that end at end locations,
+ * which are at most queryLength + editDistance long.
+ * @param [in] profile  Profile of query, which is not empty.
+ * @param [in] target  Original target.
+ * @param [in] targetLength
+ * @param [in] config
+ * @param [in] workspace  Temporary memory is allocated from it.
+ * @param [out] result
+ */
+template <typename Word, int WORD_SIZE>
+static void alignLongTarget(const EdlibQueryProfile& profile, const char* const target, const long long targetLength,
+                            const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                            EdlibAlignResult64* const result) {
+    const int queryLength = profile.queryLength;
+    const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
+    const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    const Word* const Peq = static_cast<const Word*>(profile.Peq);
+    Arena& arena = workspace.arena;
+    ArenaScope arenaScope(arena);
+    unsigned char* const targetPart = arena.allocate<unsigned char>(LONG_TARGET_PART_LENGTH);
+    Block<Word>* const blocks = arena.allocate<Block<Word> >(maxNumBlocks);
+    vector<int>& positions = workspace.positions;
+
+    // Alphabet length is reported same as in edlibAlign(), so characters of target are counted in first pass.
+    bool inAlphabet[MAX_UCHAR + 1];
+    memcpy(inAlphabet, profile.inQuery, sizeof(inAlphabet));
+    result->alphabetLength = profile.queryAlphabetLength;
+    long long countedLength = 0;  // Length of start of target whose characters were counted.
+
+    //------------ Find edit distance and end locations, auto-adjusting k as findEditDistance() does ------------//
+    vector<long long> endLocations;
+    const bool dynamicK = config.k < 0;
+    int k = dynamicK ? WORD_SIZE : config.k;
+    SemiGlobalState<Word> state;
+    do {
+        initSemiGlobalState(maxNumBlocks, queryLength, k, blocks, &state);
+        endLocations.clear();
+        bool bandExists = true;
+        for (long long partStart = 0; partStart < targetLength && bandExists; partStart += LONG_TARGET_PART_LENGTH) {
+            const int partLength = static_cast<int>(min<long long>(LONG_TARGET_PART_LENGTH, targetLength - partStart));
+            for (int i = 0; i < partLength; i++) {
+                targetPart[i] = profile.letterIdx[static_cast<unsigned char>(target[partStart + i])];
+            }
+            for (; countedLength < partStart + partLength; countedLength++) {
+                const unsigned char c = static_cast<unsigned char>(target[countedLength]);
+                if (!inAlphabet[c]) {
+                    inAlphabet[c] = true;
+                    result->alphabetLength++;
+                }
+            }
+            // Positions are relative to the part, and are cleared if better score is found in it.
+            const int bestScore = state.bestScore;
+            positions.clear();
+            bandExists = calcSemiGlobalColumns(Peq, W, maxNumBlocks, targetPart, partLength, config.mode, &state,
+                                               &positions, static_cast<vector<int>*>(NULL), NULL);
+            if (state.bestScore != bestScore) endLocations.clear();
+            for (size_t i = 0; i < positions.size(); i++) {
+                endLocations.push_back(partStart + positions[i]);
+            }
+        }
+        if (bandExists) {
+            const int bestScore = state.bestScore;
+            positions.clear();
+            finishSemiGlobal(W, maxNumBlocks, 0, &state, &positions, static_cast<vector<int>*>(NULL));
+            if (state.bestScore != bestScore) endLocations.clear();
+            for (size_t i = 0; i < positions.size(); i++) {
+                endLocations.push_back(targetLength + positions[i]);
+            }
+        }
+        k = k > INT_MAX / 2 ? INT_MAX : 2 * k;
+    } while (dynamicK && state.bestScore == -1);
+    for (; countedLength < targetLength; countedLength++) {
+        const unsigned char c = static_cast<unsigned char>(target[countedLength]);
+        if (!inAlphabet[c]) {
+            inAlphabet[c] = true;
+            result->alphabetLength++;
+        }
+    }
+
+    result->editDistance = state.bestScore;
+    if (result->editDistance == -1) return;
+    result->numLocations = static_cast<int>(endLocations.size());
+    result->endLocations = static_cast<long long*>(malloc(result->numLocations * sizeof(long long)));
+    copy(endLocations.begin(), endLocations.end(), result->endLocations);
+    if (config.task == EDLIB_TASK_DISTANCE) return;
+    //------------------------------------------------------------------------------------------------------------//
+
+    if (static_cast<long long>(queryLength) + result->editDistance > INT_MAX) {
+        result->status = EDLIB_STATUS_ERROR;
+        return;
+    }
+    // Alignment that ends at end location starts at most queryLength + editDistance characters before it
+    // (and at 0 for SHW), so start location and alignment are found in that part of target.
+    const int numAlignments = config.task != EDLIB_TASK_PATH ? 0 : config.maxAlignments < 0 ? result->numLocations
+        : min(max(config.maxAlignments, 1), result->numLocations);
+    result->startLocations = static_cast<long long*>(malloc(result->numLocations * sizeof(long long)));
+    vector<unsigned char> alignments;
+    vector<int> alignmentLengths;
+    EdlibAlignConfig locationConfig = config;
+    locationConfig.maxAlignments = 1;
+    locationConfig.runLengthAlignment = 0;  // Alignments of locations are joined first.
+    for (int i = 0; i < result->numLocations; i++) {
+        ArenaScope locationScope(arena);
+        const long long endLocation = result->endLocations[i];
+        const long long windowStart = config.mode == EDLIB_MODE_SHW ? 0
+            : max(0LL, endLocation + 1 - (queryLength + result->editDistance));
+        const int windowLength = static_cast<int>(endLocation - windowStart + 1);
+        unsigned char* const window = arena.allocate<unsigned char>(windowLength);
+        for (int j = 0; j < windowLength; j++) {
+            window[j] = profile.letterIdx[static_cast<unsigned char>(target[windowStart + j])];
+        }
+
+        EdlibAlignResult locationResult = createEmptyAlignResult();
+        locationResult.editDistance = result->editDistance;
+        locationResult.numLocations = 1;
+        locationResult.endLocations = static_cast<int*>(malloc(sizeof(int)));
+        locationResult.endLocations[0] = static_cast<int>(endLocation - windowStart);
+        locationConfig.task = i < numAlignments ? EDLIB_TASK_PATH : EDLIB_TASK_LOC;
+        findStartLocationsAndAlignment(profile.query, profile.rQuery, queryLength, window, windowLength,
+                                       *(profile.equalityDefinition), profile.alphabetLength,
+                                       Peq, static_cast<const Word*>(profile.rPeq),
+                                       locationConfig, workspace, &locationResult);
+        if (locationResult.status == EDLIB_STATUS_ERROR) {
+            result->status = EDLIB_STATUS_ERROR;
+            edlibFreeAlignResult(locationResult);
+            return;
+        }
+        result->startLocations[i] = windowStart + locationResult.startLocations[0];
+        if (i < numAlignments) {
+            alignments.insert(alignments.end(), locationResult.alignment,
+                              locationResult.alignment + locationResult.alignmentLength);
+            alignmentLengths.push_back(locationResult.alignmentLength);
+        }
+        edlibFreeAlignResult(locationResult);
+    }
+
+    if (numAlignments > 0) {
+        result->alignmentLengths = static_cast<int*>(malloc(numAlignments * sizeof(int)));
+        copy(alignmentLengths.begin(), alignmentLengths.end(), result->alignmentLengths);
+        result->alignmentLength = alignmentLengths[0];
+        result->numAlignments = numAlignments;
+        if (config.runLengthAlignment) {
+            setAlignmentRuns(alignments.data(), result);
+        } else {
+            result->alignment = static_cast<unsigned char*>(malloc(alignments.size() * sizeof(unsigned char)));
+            copy(alignments.begin(), alignments.end(), result->alignment);
+        }
+    }
+}
+
+/**
+ * @return Result with same values as given result, with locations converted to 64 bits.
+ *         Given result is consumed: its arrays are either moved to returned result or freed.
+ */
+static EdlibAlignResult64 toAlignResult64(const EdlibAlignResult result) {
+    EdlibAlignResult64 result64;
+    result64.status = result.status;
+    result64.editDistance = result.editDistance;
+    result64.numLocations = result.numLocations;
+    result64.endLocations = result64.startLocations = NULL;
+    if (result.endLocations) {
+        result64.endLocations = static_cast<long long*>(malloc(result.numLocations * sizeof(long long)));
+        copy(result.endLocations, result.endLocations + result.numLocations, result64.endLocations);
+        free(result.endLocations);
+    }
+    if (result.startLocations) {
+        result64.startLocations = static_cast<long long*>(malloc(result.numLocations * sizeof(long long)));
+        copy(result.startLocations, result.startLocations + result.numLocations, result64.startLocations);
+        free(result.startLocations);
+    }
+    result64.alignment = result.alignment;
+    result64.alignmentLength = result.alignmentLength;
+    result64.alignmentLengths = result.alignmentLengths;
+    result64.numAlignments = result.numAlignments;
+    result64.alignmentRuns = result.alignmentRuns;
+    result64.alignmentNumRuns = result.alignmentNumRuns;
+    result64.alphabetLength = result.alphabetLength;
+    return result64;
+}
+
+/**
+ * @return Result with no solution.
+ */
+static EdlibAlignResult createEmptyAlignResult() {
     EdlibAlignResult result;
     result.status = EDLIB_STATUS_OK;
     result.editDistance = -1;
@@ -153,47 +1814,247 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
     result.numLocations = 0;
     result.alignment = NULL;
     result.alignmentLength = 0;
+    result.alignmentLengths = NULL;
+    result.numAlignments = 0;
+    result.alignmentRuns = NULL;
+    result.alignmentNumRuns = NULL;
     result.alphabetLength = 0;
+    return result;
+}
 
-    /*------------ TRANSFORM SEQUENCES AND RECOGNIZE ALPHABET -----------*/
-    unsigned char* query, * target;
-    string alphabet = transformSequences(queryOriginal, queryLength, targetOriginal, targetLength,
-                                         &query, &target);
-    result.alphabetLength = static_cast<int>(alphabet.size());
-    /*-------------------------------------------------------*/
+/**
+ * Sets alignment runs of result to runs of same operations in given alignments, which are stored
+ * one after another, with their number and lengths already set in result.
+ */
+template <typename AlignResult>
+static void setAlignmentRuns(const unsigned char* const alignments, AlignResult* const result) {
+    size_t numRuns = 0;
+    size_t alignmentStart = 0;
+    for (int a = 0; a < result->numAlignments; a++) {
+        const unsigned char* const alignment = alignments + alignmentStart;
+        for (int i = 0; i < result->alignmentLengths[a]; i++) {
+            if (i == 0 || alignment[i] != alignment[i - 1]) numRuns++;
+        }
+        alignmentStart += static_cast<size_t>(result->alignmentLengths[a]);
+    }
+    result->alignmentRuns = static_cast<EdlibAlignmentRun*>(malloc(max(numRuns, static_cast<size_t>(1))
+                                                                   * sizeof(EdlibAlignmentRun)));
+    result->alignmentNumRuns = static_cast<int*>(malloc(max(result->numAlignments, 1) * sizeof(int)));
+    EdlibAlignmentRun* run = result->alignmentRuns;
+    alignmentStart = 0;
+    for (int a = 0; a < result->numAlignments; a++) {
+        const unsigned char* const alignment = alignments + alignmentStart;
+        const EdlibAlignmentRun* const firstRun = run;
+        for (int i = 0; i < result->alignmentLengths[a]; i++) {
+            if (i == 0 || alignment[i] != alignment[i - 1]) {
+                run->operation = alignment[i];
+                run->length = 0;
+                run++;
+            }
+            (run - 1)->length++;
+        }
+        result->alignmentNumRuns[a] = static_cast<int>(run - firstRun);
+        alignmentStart += static_cast<size_t>(result->alignmentLengths[a]);
+    }
+}
 
-    // Handle special situation when at least one of the sequences has length 0.
-    if (queryLength == 0 || targetLength == 0) {
-        if (config.mode == EDLIB_MODE_NW) {
-            result.editDistance = std::max(queryLength, targetLength);
-            result.endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
-            result.endLocations[0] = targetLength - 1;
-            result.numLocations = 1;
-        } else if (config.mode == EDLIB_MODE_SHW || config.mode == EDLIB_MODE_HW) {
-            result.editDistance = queryLength;
-            result.endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
-            result.endLocations[0] = -1;
-            result.numLocations = 1;
+/**
+ * Handles special situation when at least one of the sequences has length 0.
+ * @param [in] queryLength
+ * @param [in] targetLength
+ * @param [in] mode
+ * @param [in] affineCosts  If not NULL, cost of gap is calculated with them.
+ * @param [out] result  Edit distance and end locations are set, or status if mode or costs are not valid.
+ */
+static void alignEmptySequences(const int queryLength, const int targetLength, const EdlibAlignMode mode,
+                                const EdlibAffineCosts* const affineCosts, EdlibAlignResult* const result) {
+    if (affineCosts && !areValidAffineCosts(*affineCosts, queryLength, targetLength)) {
+        result->status = EDLIB_STATUS_ERROR;
+        return;
+    }
+    // Alignment consists of one gap, if any.
+    const auto gapCost = [affineCosts](const int length) {
+        return length == 0 || !affineCosts ? length : affineCosts->gapOpen + length * affineCosts->gapExtend;
+    };
+    if (mode == EDLIB_MODE_NW) {
+        result->editDistance = gapCost(std::max(queryLength, targetLength));
+        result->endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
+        result->endLocations[0] = targetLength - 1;
+        result->numLocations = 1;
+    } else if (mode == EDLIB_MODE_SHW || mode == EDLIB_MODE_HW) {
+        result->editDistance = gapCost(queryLength);
+        result->endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
+        result->endLocations[0] = -1;
+        result->numLocations = 1;
+    } else {
+        result->status = EDLIB_STATUS_ERROR;
+    }
+}
+
+/**
+ * Finds edit distance, and start locations and alignment depending on the task.
+ * Query and target must not be empty.
+ * @param [in] query  Transformed query.
+ * @param [in] rQuery  Reversed query, or NULL if it should be created when needed.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] alphabetLength
+ * @param [in] Peq  Query profile, or NULL if it should be built here.
+ * @param [in] rPeq  Profile of reversed query, or NULL if it should be built when needed.
+ * @param [in] config
+ * @param [in] workspace  Temporary memory is allocated from it.
+ * @param [out] result
+ */
+template <typename Word, int WORD_SIZE>
+static void alignWithWords(const unsigned char* const query, const unsigned char* const rQuery,
+                           const int queryLength,
+                           const unsigned char* const target, const int targetLength,
+                           const EqualityDefinition& equalityDefinition, const int alphabetLength,
+                           const Word* const Peq_, const Word* const rPeq,
+                           const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                           EdlibAlignResult* const result) {
+    const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE); // bmax in Myers
+    const int W = maxNumBlocks * WORD_SIZE - queryLength; // number of redundant cells in last level blocks
+    const Word* const Peq = Peq_ ? Peq_
+        : buildPeq<Word>(alphabetLength, query, queryLength, equalityDefinition, workspace.arena);
+
+    findEditDistance(Peq, W, maxNumBlocks, query, queryLength, target, targetLength,
+                     equalityDefinition, alphabetLength, config, workspace, result);
+    if (result->editDistance >= 0) {  // If there is solution.
+        findStartLocationsAndAlignment(query, rQuery, queryLength, target, targetLength,
+                                       equalityDefinition, alphabetLength, Peq, rPeq,
+                                       config, workspace, result);
+    }
+    if (config.stats) {
+        config.stats->blockSize = WORD_SIZE;
+        config.stats->bytesAllocated = static_cast<long long>(workspace.arena.allocatedBytes());
+        config.stats->peakBytes = static_cast<long long>(workspace.arena.peakBytes());
+    }
+}
+
+/**
+ * Does the work of edlibAlignBatch() once query and targets are transformed.
+ * @param [in] query  Transformed query.
+ * @param [in] queryOriginal
+ * @param [in] queryLength
+ * @param [in] targets  Transformed targets.
+ * @param [in] targetsOriginal
+ * @param [in] targetLengths
+ * @param [in] numTargets
+ * @param [in] alphabet  Alphabet shared by query and all targets.
+ * @param [in] config
+ * @param [in] workspace  Temporary memory is allocated from it.
+ * @param [out] results  Array of numTargets results.
+ */
+template <typename Word, int WORD_SIZE>
+static void alignBatchWithWords(const unsigned char* const query, const char* const queryOriginal,
+                                const int queryLength,
+                                const unsigned char* const* const targets, const char* const* const targetsOriginal,
+                                const int* const targetLengths, const int numTargets, const string& alphabet,
+                                const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                                EdlibAlignResult* const results) {
+    const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
+    const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    EqualityDefinition equalityDefinition(alphabet, config.additionalEqualities, config.additionalEqualitiesLength);
+    Word* Peq = queryLength > 0
+        ? buildPeq<Word>(static_cast<int>(alphabet.size()), query, queryLength, equalityDefinition, workspace.arena)
+        : NULL;
+
+    // Targets that will be calculated in SIMD lanes, longest first so that targets of similar lengths
+    // end up in the same group of lanes.
+    int* const laneTargets = workspace.arena.allocate<int>(numTargets);
+    int numLaneTargets = 0;
+    const int numLanes = getNumLanes<Word>(maxNumBlocks, config.k, config.mode);
+
+    for (int i = 0; i < numTargets; i++) {
+        results[i] = createEmptyAlignResult();
+        results[i].alphabetLength = countAlphabet(queryOriginal, queryLength, targetsOriginal[i], targetLengths[i]);
+        if (queryLength == 0 || targetLengths[i] == 0) {
+            alignEmptySequences(queryLength, targetLengths[i], config.mode, config.affineCosts, &results[i]);
+        } else if (config.affineCosts) {
+            alignAffine(query, queryLength, targets[i], targetLengths[i], equalityDefinition, config, workspace,
+                        &results[i]);
+        } else if (numLanes > 1) {
+            laneTargets[numLaneTargets++] = i;
         } else {
-            result.status = EDLIB_STATUS_ERROR;
+            findEditDistance(Peq, W, maxNumBlocks, query, queryLength, targets[i], targetLengths[i],
+                             equalityDefinition, static_cast<int>(alphabet.size()), config, workspace, &results[i]);
         }
+    }
 
-        free(query);
-        free(target);
-        return result;
+#ifdef EDLIB_X86_SIMD
+    if (numLaneTargets > 0) {
+        ArenaScope lanesScope(workspace.arena);
+        sort(laneTargets, laneTargets + numLaneTargets, [targetLengths](int a, int b) {
+            return targetLengths[a] > targetLengths[b] || (targetLengths[a] == targetLengths[b] && a < b);
+        });
+        const unsigned char** const groupTargets = workspace.arena.allocate<const unsigned char*>(numLanes);
+        int* const groupTargetLengths = workspace.arena.allocate<int>(numLanes);
+        int* const groupScores = workspace.arena.allocate<int>(numLanes);
+        vector< vector<int> >& groupPositions = workspace.lanePositions;
+        groupPositions.resize(max(groupPositions.size(), static_cast<size_t>(numLanes)));
+        for (int start = 0; start < numLaneTargets; start += numLanes) {
+            const int groupSize = min(numLaneTargets - start, numLanes);
+            for (int l = 0; l < groupSize; l++) {
+                groupTargets[l] = targets[laneTargets[start + l]];
+                groupTargetLengths[l] = targetLengths[laneTargets[start + l]];
+            }
+            myersCalcEditDistanceLanes(Peq, W, maxNumBlocks, queryLength,
+                                       groupTargets, groupTargetLengths, groupSize,
+                                       config.k, config.mode, numLanes, workspace.arena,
+                                       groupScores, groupPositions.data());
+            for (int l = 0; l < groupSize; l++) {
+                EdlibAlignResult* const result = &results[laneTargets[start + l]];
+                result->editDistance = groupScores[l];
+                if (groupScores[l] >= 0 && config.mode != EDLIB_MODE_NW) {
+                    result->numLocations = static_cast<int>(groupPositions[l].size());
+                    result->endLocations = static_cast<int *>(malloc(sizeof(int) * result->numLocations));
+                    copy(groupPositions[l].begin(), groupPositions[l].end(), result->endLocations);
+                }
+            }
+        }
     }
+#endif
 
-    /*--------------------- INITIALIZATION ------------------*/
-    int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE); // bmax in Myers
-    int W = maxNumBlocks * WORD_SIZE - queryLength; // number of redundant cells in last level blocks
-    EqualityDefinition equalityDefinition(alphabet, config.additionalEqualities, config.additionalEqualitiesLength);
-    Word* Peq = buildPeq(static_cast<int>(alphabet.size()), query, queryLength, equalityDefinition);
-    /*-------------------------------------------------------*/
+    for (int i = 0; i < numTargets && !config.affineCosts; i++) {
+        if (results[i].editDistance >= 0 && queryLength > 0 && targetLengths[i] > 0) {
+            findStartLocationsAndAlignment<Word>(query, NULL, queryLength, targets[i], targetLengths[i],
+                                                 equalityDefinition, static_cast<int>(alphabet.size()), Peq, NULL,
+                                                 config, workspace, &results[i]);
+        }
+    }
+}
 
-    /*------------------ MAIN CALCULATION -------------------*/
+/**
+ * Finds edit distance and end locations, auto-adjusting k if it is not given.
+ * Query and target must not be empty.
+ * @param [in] Peq  Query profile.
+ * @param [in] W  Size of padding in last block.
+ * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] alphabetLength
+ * @param [in] config  If stats are set in it, number of rounds and stats of this phase are filled.
+ * @param [in] workspace  Temporary memory is allocated from it.
+ * @param [out] result  Edit distance and end locations are set. Edit distance is -1 if there is no solution.
+ */
+template <typename Word, int WORD_SIZE>
+static void findEditDistance(const Word* const Peq, const int W, const int maxNumBlocks,
+                             const unsigned char* const query, const int queryLength,
+                             const unsigned char* const target, const int targetLength,
+                             const EqualityDefinition& equalityDefinition, const int alphabetLength,
+                             const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                             EdlibAlignResult* const result) {
+    const std::chrono::steady_clock::time_point startTime = config.stats
+        ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    WorkCounters counters;
     // TODO: Store alignment data only after k is determined? That could make things faster.
     int positionNW; // Used only when mode is NW.
-    AlignmentData* alignData = NULL;
     bool dynamicK = false;
     int k = config.k;
     if (k < 0) { // If valid k is not given, auto-adjust k until solution is found.
@@ -201,110 +2062,838 @@ extern "C" EdlibAlignResult edlibAlign(const char* const queryOriginal, const in
         k = WORD_SIZE; // Gives better results than smaller k.
     }
 
-    do {
+    // Once edit distance is not found in the first round, sequences are not similar, so instead of doubling k
+    // many times and calculating again each time, k is moved close to edit distance right away,
+    // using its lower bound. Lower bound is not calculated before first round, since for similar sequences
+    // it would take about as long as the whole calculation.
+    bool lowerBoundUsed = false;
+    const auto moveKToLowerBound = [&]() {
+        lowerBoundUsed = true;
+        if (!equalityDefinition.isIdentity()) return;
+        const long long lowerBound = qgramLowerBound(query, queryLength, target, targetLength,
+                                                     alphabetLength, config.mode, workspace.arena);
+        k = static_cast<int>(max(static_cast<long long>(k),
+                                 min(lowerBound * K_LOWER_BOUND_FACTOR, static_cast<long long>(INT_MAX))));
+    };
+
+    int numKRounds = 0;
+    int lastK = k;
+    bool calculated = false;
+    EdlibAlignEngine engine = EDLIB_ENGINE_BIT_VECTOR;
+    if (config.engine == EDLIB_ENGINE_DIAGONAL_TRANSITION
+        || (config.engine == EDLIB_ENGINE_AUTO && config.mode != EDLIB_MODE_HW && maxNumBlocks > 1)) {
+        // Edit distance is never larger than this, so there is always solution below it.
+        const int maxEditDistance = config.mode == EDLIB_MODE_NW ? max(queryLength, targetLength) : queryLength;
+        const int maxK = dynamicK ? maxEditDistance : min(k, maxEditDistance);
+        int maxDistance = maxK;
+        if (config.engine == EDLIB_ENGINE_AUTO) {
+            // Diagonal transition takes about maxDistance^2 steps, which is compared to one round of
+            // bit-vector algorithm, that takes about queryLength steps on similar sequences.
+            maxDistance = min(maxDistance, static_cast<int>(
+                std::sqrt(static_cast<double>(DIAGONAL_TRANSITION_FACTOR) * queryLength)));
+        }
+        result->editDistance = diagonalTransitionEditDistance(query, queryLength, target, targetLength,
+                                                              equalityDefinition, config.mode, W, maxDistance,
+                                                              workspace.arena, &(workspace.positions));
+        // If it gave up below k, bit-vector algorithm continues as if this was its first round.
+        calculated = result->editDistance != -1 || maxDistance == maxK;
+        if (calculated) {
+            engine = EDLIB_ENGINE_DIAGONAL_TRANSITION;
+            numKRounds = 1;
+            lastK = maxDistance;
+        } else if (dynamicK) {
+            k = max(k, maxDistance > INT_MAX / 2 ? INT_MAX : 2 * maxDistance);
+            moveKToLowerBound();
+        }
+    }
+
+    while (!calculated) {
         if (config.mode == EDLIB_MODE_HW || config.mode == EDLIB_MODE_SHW) {
             myersCalcEditDistanceSemiGlobal(Peq, W, maxNumBlocks,
                                             queryLength, target, targetLength,
-                                            k, config.mode, &(result.editDistance),
-                                            &(result.endLocations), &(result.numLocations));
+                                            k, config.mode, workspace.arena, &(result->editDistance),
+                                            &(workspace.positions), NULL,
+                                            config.stats ? &counters : NULL);
         } else {  // mode == EDLIB_MODE_NW
-            myersCalcEditDistanceNW(Peq, W, maxNumBlocks,
-                                    queryLength, target, targetLength,
-                                    k, &(result.editDistance), &positionNW,
-                                    false, &alignData, -1);
-        }
-        k *= 2;
-    } while(dynamicK && result.editDistance == -1);
-
-    if (result.editDistance >= 0) {  // If there is solution.
-        // If NW mode, set end location explicitly.
-        if (config.mode == EDLIB_MODE_NW) {
-            result.endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
-            result.endLocations[0] = targetLength - 1;
-            result.numLocations = 1;
-        }
-
-        // Find starting locations.
-        if (config.task == EDLIB_TASK_LOC || config.task == EDLIB_TASK_PATH) {
-            result.startLocations = static_cast<int *>(malloc(result.numLocations * sizeof(int)));
-            if (config.mode == EDLIB_MODE_HW) {  // If HW, I need to calculate start locations.
-                const unsigned char* rTarget = createReverseCopy(target, targetLength);
-                const unsigned char* rQuery  = createReverseCopy(query, queryLength);
-                // Peq for reversed query.
-                Word* rPeq = buildPeq(static_cast<int>(alphabet.size()), rQuery, queryLength, equalityDefinition);
-                for (int i = 0; i < result.numLocations; i++) {
-                    int endLocation = result.endLocations[i];
-                    if (endLocation == -1) {
-                        // NOTE: Sometimes one of optimal solutions is that query starts before target, like this:
-                        //                       AAGG <- target
-                        //                   CCTT     <- query
-                        //   It will never be only optimal solution and it does not happen often, however it is
-                        //   possible and in that case end location will be -1. What should we do with that?
-                        //   Should we just skip reporting such end location, although it is a solution?
-                        //   If we do report it, what is the start location? -4? -1? Nothing?
-                        // TODO: Figure this out. This has to do in general with how we think about start
-                        //   and end locations.
-                        //   Also, we have alignment later relying on this locations to limit the space of it's
-                        //   search -> how can it do it right if these locations are negative or incorrect?
-                        result.startLocations[i] = 0;  // I put 0 for now, but it does not make much sense.
+            myersCalcEditDistanceNW<Word>(Peq, W, maxNumBlocks,
+                                          queryLength, target, targetLength,
+                                          k, workspace.arena, &(result->editDistance), &positionNW,
+                                          false, NULL, -1, NULL, config.stats ? &counters : NULL);
+        }
+        numKRounds++;
+        lastK = k;
+        k = k > INT_MAX / 2 ? INT_MAX : 2 * k;
+        if (dynamicK && result->editDistance == -1 && !lowerBoundUsed) {
+            moveKToLowerBound();
+        }
+        calculated = !dynamicK || result->editDistance != -1;
+    }
+
+    if (config.stats) {
+        config.stats->engine = engine;
+        config.stats->numKRounds = numKRounds;
+        config.stats->k = lastK;
+        counters.getStats(startTime, &config.stats->distance);
+    }
+
+    if (result->editDistance != -1 && config.mode != EDLIB_MODE_NW) {
+        result->numLocations = static_cast<int>(workspace.positions.size());
+        result->endLocations = static_cast<int *>(malloc(sizeof(int) * result->numLocations));
+        copy(workspace.positions.begin(), workspace.positions.end(), result->endLocations);
+    }
+}
+
+/**
+ * Finds lower bound of edit distance from q-grams (substrings of length q) of query that are not in target.
+ * One edit operation changes at most q q-grams, so if d q-grams of query (counted with multiplicity) are not
+ * in target, edit distance is at least d / q. In NW mode, same holds for q-grams of target that are not in query.
+ * q is chosen so that there are many more possible q-grams than there are q-grams in sequences,
+ * since otherwise q-grams of unrelated sequences would often be same by chance.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] alphabetLength
+ * @param [in] mode
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @return Lower bound of edit distance, 0 if it can not be found cheaply.
+ */
+static int qgramLowerBound(const unsigned char* const query, const int queryLength,
+                           const unsigned char* const target, const int targetLength_,
+                           const int alphabetLength, const EdlibAlignMode mode, Arena& arena) {
+    int targetLength = targetLength_;
+    if (mode == EDLIB_MODE_SHW) {
+        // Edit distance is at most queryLength, so alignment spans at most 2 * queryLength characters of target.
+        targetLength = static_cast<int>(min(static_cast<long long>(targetLength), 2LL * queryLength));
+    } else if (mode == EDLIB_MODE_HW && targetLength / 2 > queryLength) {
+        // Long target has most q-grams of query somewhere by chance.
+        return 0;
+    }
+
+    // Q-gram is index in table of counts, with each letter taking letterBits bits of it.
+    int letterBits = 0;
+    while ((1 << letterBits) < alphabetLength) letterBits++;
+    const long long maxTableSize = min(QGRAM_TABLE_SIZE_FACTOR * (static_cast<long long>(queryLength) + targetLength),
+                                       static_cast<long long>(MAX_QGRAM_TABLE_SIZE));
+    int q = 0;
+    while (letterBits > 0 && (1LL << (letterBits * (q + 1))) <= maxTableSize) q++;
+    if (q < 2 || queryLength < q) return 0;
+    const int tableSize = 1 << (letterBits * q);
+    const unsigned int mask = static_cast<unsigned int>(tableSize - 1);
+
+    ArenaScope arenaScope(arena);
+    int* const counts = arena.allocate<int>(tableSize);
+    std::fill(counts, counts + tableSize, 0);
+    // Each q-gram of query adds 1 to its count, and each q-gram of target subtracts 1.
+    unsigned int qgram = 0;
+    for (int i = 0; i < queryLength; i++) {
+        qgram = ((qgram << letterBits) | query[i]) & mask;
+        if (i >= q - 1) counts[qgram]++;
+    }
+    qgram = 0;
+    for (int i = 0; i < targetLength; i++) {
+        qgram = ((qgram << letterBits) | target[i]) & mask;
+        if (i >= q - 1) counts[qgram]--;
+    }
+    long long notInTarget = 0, notInQuery = 0;
+    for (int i = 0; i < tableSize; i++) {
+        if (counts[i] > 0) {
+            notInTarget += counts[i];
+        } else {
+            notInQuery -= counts[i];
+        }
+    }
+    const long long notShared = mode == EDLIB_MODE_NW ? std::max(notInTarget, notInQuery) : notInTarget;
+    return static_cast<int>((notShared + q - 1) / q);
+}
+
+/**
+ * Moves along diagonal of dynamic programming matrix while characters of query and target are equal.
+ * @param [in] i  Position in query where moving starts.
+ * @param [in] j  Position in target where moving starts.
+ * @return Position in query where moving stopped.
+ */
+static inline int slideDiagonal(const unsigned char* const query, const int queryLength,
+                                const unsigned char* const target, const int targetLength,
+                                const EqualityDefinition& equalityDefinition, int i, int j) {
+    if (equalityDefinition.isIdentity()) {
+        // Characters usually differ right away, otherwise 8 of them are compared at once,
+        // until the first block in which they differ.
+        if (i < queryLength && j < targetLength && query[i] != target[j]) return i;
+        while (i + 8 <= queryLength && j + 8 <= targetLength) {
+            uint64_t queryChars, targetChars;
+            memcpy(&queryChars, query + i, 8);
+            memcpy(&targetChars, target + j, 8);
+            if (queryChars != targetChars) break;
+            i += 8;
+            j += 8;
+        }
+        while (i < queryLength && j < targetLength && query[i] == target[j]) {
+            i++;
+            j++;
+        }
+    } else {
+        while (i < queryLength && j < targetLength && equalityDefinition.areEqual(query[i], target[j])) {
+            i++;
+            j++;
+        }
+    }
+    return i;
+}
+
+/**
+ * Uses diagonal transition algorithm (Ukkonen, Myers' O(ND) algorithm) to find edit distance.
+ * For each distance d, it finds how far along each diagonal (target position - query position) of
+ * dynamic programming matrix cells with distance d reach: from the furthest cells with distance d - 1
+ * on the same and neighbouring diagonals, it makes one edit and then moves along the diagonal while
+ * characters are equal. Edit distance is the first d for which the last row (last cell for NW) is reached.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] mode
+ * @param [in] W  Size of padding in last block of bit-vector algorithm. Position -1 (before the first character
+ *                of target) is found only if it is not 0, since that is how bit-vector algorithm finds it.
+ * @param [in] maxDistance  Calculation stops if edit distance is larger than this.
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [out] positions  0-indexed positions in target at which best score was found, for HW and SHW.
+ * @return Edit distance, or -1 if it is larger than maxDistance.
+ */
+static int diagonalTransitionEditDistance(const unsigned char* const query, const int queryLength,
+                                          const unsigned char* const target, const int targetLength,
+                                          const EqualityDefinition& equalityDefinition, const EdlibAlignMode mode,
+                                          const int W, const int maxDistance, Arena& arena,
+                                          vector<int>* const positions) {
+    positions->clear();
+    // Diagonal is position in target - position in query, and for each of them, furthest position in query
+    // is stored. Diagonals below -maxDistance can not be reached. In HW, alignment may start on any diagonal.
+    const int minDiagonal = -min(queryLength, maxDistance);
+    const int maxDiagonal = mode == EDLIB_MODE_HW ? targetLength : min(targetLength, maxDistance);
+    const int UNREACHED = INT_MIN / 2;  // Stays below all positions when 1 is added to it.
+    ArenaScope arenaScope(arena);
+    // There is one more diagonal on each side, that is never reached.
+    const int numDiagonals = maxDiagonal - minDiagonal + 3;
+    int* furthest = arena.allocate<int>(numDiagonals) - minDiagonal + 1;
+    int* prevFurthest = arena.allocate<int>(numDiagonals) - minDiagonal + 1;
+    std::fill(furthest + minDiagonal - 1, furthest + maxDiagonal + 2, UNREACHED);
+    std::fill(prevFurthest + minDiagonal - 1, prevFurthest + maxDiagonal + 2, UNREACHED);
+
+    int lo = 0;
+    int hi = mode == EDLIB_MODE_HW ? targetLength : 0;
+    for (int diagonal = lo; diagonal <= hi; diagonal++) {
+        furthest[diagonal] = slideDiagonal(query, queryLength, target, targetLength, equalityDefinition,
+                                           0, diagonal);
+    }
+    for (int d = 0; ; d++) {
+        if (d > 0) {
+            std::swap(furthest, prevFurthest);
+            lo = max(lo - 1, minDiagonal);
+            hi = min(hi + 1, maxDiagonal);
+            for (int diagonal = lo; diagonal <= hi; diagonal++) {
+                // Mismatch and insertion move down in query, deletion moves only in target.
+                int i = max(max(prevFurthest[diagonal], prevFurthest[diagonal + 1]) + 1, prevFurthest[diagonal - 1]);
+                i = min(i, min(queryLength, targetLength - diagonal));
+                if (i >= max(0, -diagonal)) {
+                    i = slideDiagonal(query, queryLength, target, targetLength, equalityDefinition,
+                                      i, i + diagonal);
+                }
+                furthest[diagonal] = i;
+            }
+        }
+
+        if (mode == EDLIB_MODE_NW) {
+            const int lastDiagonal = targetLength - queryLength;
+            if (lo <= lastDiagonal && lastDiagonal <= hi && furthest[lastDiagonal] == queryLength) return d;
+        } else {
+            for (int diagonal = lo; diagonal <= hi; diagonal++) {
+                const int position = queryLength + diagonal - 1;
+                if (furthest[diagonal] == queryLength && (position >= 0 || W > 0)) {
+                    positions->push_back(position);
+                }
+            }
+            if (!positions->empty()) return d;
+        }
+        if (d == maxDistance) return -1;
+    }
+}
+
+/**
+ * @return True if costs are valid, and costs of alignments of sequences of given lengths fit into int
+ *         and are lower than AFFINE_INF.
+ */
+static bool areValidAffineCosts(const EdlibAffineCosts& costs, const int queryLength, const int targetLength) {
+    if (costs.mismatch < 0 || costs.gapOpen < 0 || costs.gapExtend < 1) return false;
+    const long long maxCostPerPosition = static_cast<long long>(costs.mismatch) + costs.gapOpen + costs.gapExtend;
+    return (static_cast<long long>(queryLength) + targetLength + 1) * maxCostPerPosition < INT_MAX / 4;
+}
+
+/**
+ * @return Upper bound for number of rows in one column of band, as calculated by affineCalcScore() in NW.
+ */
+static inline int getMaxNumAffineBandRows(const int queryLength, const int k, const EdlibAffineCosts& costs) {
+    // Rows of previous column that can be in alignment are at most maxGapLength away from the diagonal
+    // that ends in the last cell. Below them, there are at most maxGapLength + 2 rows reached with insertions.
+    const int maxGapLength = k / costs.gapExtend;
+    return static_cast<int>(min(static_cast<long long>(queryLength) + 1, 3ll * maxGapLength + 3));
+}
+
+/**
+ * Does the work of edlibAlign() when affine gap costs are set: finds the lowest cost and end locations,
+ * and start locations and alignment paths depending on the task.
+ * Query and target must not be empty.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] config  Its affineCosts are set. If stats are set in it, they are filled.
+ * @param [in] workspace  Temporary memory is allocated from it.
+ * @param [out] result
+ */
+static void alignAffine(const unsigned char* const query, const int queryLength,
+                        const unsigned char* const target, const int targetLength,
+                        const EqualityDefinition& equalityDefinition, const EdlibAlignConfig& config,
+                        EdlibWorkspace& workspace, EdlibAlignResult* const result) {
+    const EdlibAffineCosts& costs = *config.affineCosts;
+    if (!areValidAffineCosts(costs, queryLength, targetLength)) {
+        result->status = EDLIB_STATUS_ERROR;
+        return;
+    }
+    std::chrono::steady_clock::time_point startTime = config.stats
+        ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    WorkCounters counters;
+    Arena& arena = workspace.arena;
+
+    // Alignment that consists only of gaps is never better than the best one.
+    const int maxCost = config.mode == EDLIB_MODE_NW
+        ? 2 * costs.gapOpen + (queryLength + targetLength) * costs.gapExtend
+        : costs.gapOpen + queryLength * costs.gapExtend;
+    const bool dynamicK = config.k < 0;
+    const long long initialK = static_cast<long long>(AFFINE_INITIAL_NUM_EDITS)
+        * max(costs.mismatch, costs.gapOpen + costs.gapExtend);
+    int k = dynamicK ? static_cast<int>(min(initialK, static_cast<long long>(maxCost))) : min(config.k, maxCost);
+    // Start locations are needed only in HW, since in other modes alignments start at 0.
+    const bool findStarts = config.mode == EDLIB_MODE_HW
+        && (config.task == EDLIB_TASK_LOC || config.task == EDLIB_TASK_PATH);
+    vector<int>& positions = workspace.positions;
+    vector<int>& starts = workspace.starts;
+    int numKRounds = 0;
+    while (true) {
+        affineCalcScore(query, queryLength, target, targetLength, equalityDefinition, costs, config.mode, k, arena,
+                        &(result->editDistance), &positions, findStarts ? &starts : NULL, NULL,
+                        config.stats ? &counters : NULL);
+        numKRounds++;
+        if (result->editDistance != -1 || !dynamicK || k == maxCost) break;
+        k = k > maxCost / 2 ? maxCost : 2 * k;
+    }
+    if (config.stats) {
+        config.stats->blockSize = 1;
+        config.stats->numKRounds = numKRounds;
+        config.stats->k = k;
+        counters.getStats(startTime, &config.stats->distance);
+    }
+    if (result->editDistance == -1) return;
+
+    result->numLocations = static_cast<int>(positions.size());
+    result->endLocations = static_cast<int *>(malloc(sizeof(int) * result->numLocations));
+    copy(positions.begin(), positions.end(), result->endLocations);
+    if (config.task == EDLIB_TASK_LOC || config.task == EDLIB_TASK_PATH) {
+        result->startLocations = static_cast<int *>(malloc(sizeof(int) * result->numLocations));
+        for (int i = 0; i < result->numLocations; i++) {
+            result->startLocations[i] = findStarts ? starts[i] : 0;
+        }
+    }
+
+    if (config.task == EDLIB_TASK_PATH) {
+        if (config.stats) startTime = std::chrono::steady_clock::now();
+        WorkCounters alignmentCounters;
+        const int numAlignments = config.maxAlignments < 0 ? result->numLocations
+            : min(max(config.maxAlignments, 1), result->numLocations);
+        // Each alignment is found as NW alignment of query to part of target between its start and end location,
+        // traced back from the band of matrix, which has to fit into budget.
+        const long long tracebackMemoryBudget = config.tracebackMemoryBudget > 0
+            ? config.tracebackMemoryBudget : EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET;
+        const int numColumnBandRows = getMaxNumAffineBandRows(queryLength, result->editDistance, costs);
+        size_t maxTotalLength = 0;
+        for (int i = 0; i < numAlignments; i++) {
+            const int alnTargetLength = result->endLocations[i] - result->startLocations[i] + 1;
+            if (AffineTrace::size(alnTargetLength + 1, static_cast<long long>(numColumnBandRows)
+                                  * (alnTargetLength + 1)) > tracebackMemoryBudget) {
+                result->status = EDLIB_STATUS_ERROR;
+                return;
+            }
+            maxTotalLength += static_cast<size_t>(queryLength) + alnTargetLength;
+        }
+        // Runs are made from alignments in arena, so alignments are not allocated for result.
+        unsigned char* const alignments = config.runLengthAlignment
+            ? arena.allocate<unsigned char>(max(maxTotalLength, static_cast<size_t>(1)))
+            : static_cast<unsigned char*>(malloc(max(maxTotalLength, static_cast<size_t>(1))));
+        result->alignmentLengths = static_cast<int*>(malloc(numAlignments * sizeof(int)));
+        result->numAlignments = numAlignments;
+        size_t totalLength = 0;
+        for (int i = 0; i < numAlignments; i++) {
+            const unsigned char* const alnTarget = target + result->startLocations[i];
+            const int alnTargetLength = result->endLocations[i] - result->startLocations[i] + 1;
+            unsigned char* const alignment = alignments + totalLength;
+            int alignmentLength = 0;
+            int i_ = queryLength, j = alnTargetLength;
+            if (alnTargetLength > 0) {
+                ArenaScope traceScope(arena);
+                AffineTrace trace(alnTargetLength + 1,
+                                  static_cast<size_t>(numColumnBandRows) * (alnTargetLength + 1), arena);
+                int score;
+                if (affineCalcScore(query, queryLength, alnTarget, alnTargetLength, equalityDefinition, costs,
+                                    EDLIB_MODE_NW, result->editDistance, arena, &score, &positions, NULL, &trace,
+                                    config.stats ? &alignmentCounters : NULL) != EDLIB_STATUS_OK) {
+                    if (!config.runLengthAlignment) free(alignments);
+                    result->status = EDLIB_STATUS_ERROR;
+                    return;
+                }
+                // Alignment is traced back from the last cell, and then reversed.
+                AffineMove state = AFFINE_FROM_DIAGONAL;
+                while (i_ > 0 && j > 0) {
+                    const unsigned char cell = trace.get(i_, j);
+                    if (state == AFFINE_FROM_DIAGONAL) {
+                        state = static_cast<AffineMove>(cell & 3);
+                        if (state == AFFINE_FROM_DIAGONAL) {
+                            i_--;
+                            j--;
+                            alignment[alignmentLength++] = equalityDefinition.areEqual(query[i_], alnTarget[j])
+                                ? EDLIB_EDOP_MATCH : EDLIB_EDOP_MISMATCH;
+                        }
+                    } else if (state == AFFINE_FROM_INSERTION) {
+                        if (cell & AFFINE_INSERTION_OPENED) state = AFFINE_FROM_DIAGONAL;
+                        i_--;
+                        alignment[alignmentLength++] = EDLIB_EDOP_INSERT;
                     } else {
-                        int bestScoreSHW, numPositionsSHW;
-                        int* positionsSHW;
-                        myersCalcEditDistanceSemiGlobal(
-                                rPeq, W, maxNumBlocks,
-                                queryLength, rTarget + targetLength - endLocation - 1, endLocation + 1,
-                                result.editDistance, EDLIB_MODE_SHW,
-                                &bestScoreSHW, &positionsSHW, &numPositionsSHW);
-                        // Taking last location as start ensures that alignment will not start with insertions
-                        // if it can start with mismatches instead.
-                        result.startLocations[i] = endLocation - positionsSHW[numPositionsSHW - 1];
-                        free(positionsSHW);
+                        if (cell & AFFINE_DELETION_OPENED) state = AFFINE_FROM_DIAGONAL;
+                        j--;
+                        alignment[alignmentLength++] = EDLIB_EDOP_DELETE;
                     }
                 }
-                delete[] rTarget;
-                delete[] rQuery;
-                delete[] rPeq;
-            } else {  // If mode is SHW or NW
-                for (int i = 0; i < result.numLocations; i++) {
-                    result.startLocations[i] = 0;
+            }
+            // What is left is gap at the start.
+            for (; i_ > 0; i_--) alignment[alignmentLength++] = EDLIB_EDOP_INSERT;
+            for (; j > 0; j--) alignment[alignmentLength++] = EDLIB_EDOP_DELETE;
+            std::reverse(alignment, alignment + alignmentLength);
+            result->alignmentLengths[i] = alignmentLength;
+            totalLength += alignmentLength;
+        }
+        result->alignmentLength = result->alignmentLengths[0];
+        if (config.runLengthAlignment) {
+            setAlignmentRuns(alignments, result);
+        } else {
+            result->alignment = static_cast<unsigned char*>(
+                realloc(alignments, max(totalLength, static_cast<size_t>(1))));
+        }
+        if (config.stats) alignmentCounters.getStats(startTime, &config.stats->alignment);
+    }
+    if (config.stats) {
+        config.stats->bytesAllocated = static_cast<long long>(arena.allocatedBytes());
+        config.stats->peakBytes = static_cast<long long>(arena.peakBytes());
+    }
+}
+
+/**
+ * Uses Gotoh's algorithm to find the lowest cost of alignment with affine gap costs, and end locations
+ * in target where alignments with that cost end.
+ * Matrix is calculated column by column, and only cells that may have cost of at most k are calculated
+ * (Ukkonen's cut-off): in each column, those are the rows from the first to the last one whose cost in
+ * previous column was at most k, and the following rows that are reached with insertions.
+ * In NW, extension cost of gap that is still needed to reach the last cell is also taken into account.
+ * @param [in] query  Transformed query.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] costs  Valid costs, see areValidAffineCosts().
+ * @param [in] mode
+ * @param [in] k  Non-negative. Alignments with higher cost are not found.
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [out] bestScore  The lowest cost, or -1 if it is larger than k.
+ * @param [out] positions  0-indexed positions in target where alignments with the lowest cost end,
+ *                         in increasing order (-1 if alignment in SHW or HW consists only of insertions).
+ * @param [out] starts  If not NULL, start location of one of such alignments is added for each position.
+ *                      If there are more, the earliest one is taken. Used only for HW.
+ * @param [out] trace  If not NULL, moves of all calculated cells are stored in it. Used only for NW,
+ *                     and it has to have room for columns 0 to targetLength with getMaxNumAffineBandRows() cells.
+ * @param [in,out] counters  Calculated cells are counted in it, if it is not NULL.
+ * @return Status.
+ */
+static int affineCalcScore(const unsigned char* const query, const int queryLength,
+                           const unsigned char* const target, const int targetLength,
+                           const EqualityDefinition& equalityDefinition, const EdlibAffineCosts& costs,
+                           const EdlibAlignMode mode, int k, Arena& arena,
+                           int* const bestScore, vector<int>* const positions, vector<int>* const starts,
+                           AffineTrace* const trace, WorkCounters* const counters) {
+    ArenaScope arenaScope(arena);
+    BlockCounter blockCounter(counters);
+    const int mismatch = costs.mismatch;
+    const int gapOpen = costs.gapOpen;
+    const int gapExtend = costs.gapExtend;
+    *bestScore = -1;
+    positions->clear();
+    if (starts) starts->clear();
+    if (trace) trace->numCells = 0;
+
+    // Costs of the best alignments of query prefixes to target prefix that ends in current column (H),
+    // and of the best of those that end with deletion (D), for each row.
+    int* const H = arena.allocate<int>(queryLength + 1);
+    int* const D = arena.allocate<int>(queryLength + 1);
+    // Start locations of those alignments, if they are needed.
+    int* const HStart = starts ? arena.allocate<int>(queryLength + 1) : NULL;
+    int* const DStart = starts ? arena.allocate<int>(queryLength + 1) : NULL;
+
+    // Cell with higher cost than k, increased by cost of gap to the last cell in NW, can not be in alignment.
+    const auto canBeInAlignment = [&](const int row, const int column) {
+        if (H[row] > k) return false;
+        if (mode != EDLIB_MODE_NW) return true;
+        // Gap may already be opened, so only its extension is surely paid for.
+        const int gapLength = abs((queryLength - row) - (targetLength - column));
+        return static_cast<long long>(H[row]) + static_cast<long long>(gapLength) * gapExtend <= k;
+    };
+    const auto addPosition = [&](const int position, const int start) {
+        if (*bestScore == -1 || H[queryLength] < *bestScore) {
+            *bestScore = k = H[queryLength];  // Only equal or lower costs are looked for from now on.
+            positions->clear();
+            if (starts) starts->clear();
+        }
+        positions->push_back(position);
+        if (starts) starts->push_back(start);
+    };
+
+    // First column, where alignments consist of insertions.
+    int firstRow = 0;
+    int lastRow = 0;
+    H[0] = 0;
+    D[0] = AFFINE_INF;
+    if (starts) HStart[0] = DStart[0] = 0;
+    while (lastRow < queryLength && gapOpen + (lastRow + 1) * gapExtend <= k) {
+        lastRow++;
+        H[lastRow] = gapOpen + lastRow * gapExtend;
+        D[lastRow] = AFFINE_INF;
+        if (starts) HStart[lastRow] = DStart[lastRow] = 0;
+    }
+    if (trace) {
+        if (static_cast<size_t>(lastRow) + 1 > trace->capacity) {
+            return EDLIB_STATUS_ERROR;  // Band is wider than expected, which should never happen.
+        }
+        trace->columnStarts[0] = 0;
+        trace->firstRows[0] = 0;
+        fill(trace->cells, trace->cells + lastRow + 1, static_cast<unsigned char>(AFFINE_FROM_INSERTION));
+        trace->numCells = static_cast<size_t>(lastRow) + 1;
+    }
+    blockCounter.addColumn(firstRow, lastRow);
+    while (firstRow <= lastRow && !canBeInAlignment(firstRow, 0)) firstRow++;
+    while (lastRow >= firstRow && !canBeInAlignment(lastRow, 0)) lastRow--;
+    if (mode != EDLIB_MODE_NW && firstRow <= lastRow && lastRow == queryLength) addPosition(-1, 0);
+
+    for (int c = 1; c <= targetLength && firstRow <= lastRow; c++) {
+        const unsigned char targetChar = target[c - 1];
+        const int prevLastRow = lastRow;
+        int row = firstRow;
+        // Values from previous row: H of previous column, and H and alignment ending with insertion of this one.
+        int diagonal = AFFINE_INF, diagonalStart = 0;
+        int above = AFFINE_INF, aboveStart = 0;
+        int insertion = AFFINE_INF, insertionStart = 0;
+        if (trace) {
+            trace->columnStarts[c] = trace->numCells;
+            trace->firstRows[c] = firstRow;
+        }
+        if (row == 0) {
+            diagonal = H[0];
+            if (starts) diagonalStart = HStart[0];
+            // Gap before query is not penalized in HW.
+            H[0] = mode == EDLIB_MODE_HW ? 0 : min(gapOpen + c * gapExtend, AFFINE_INF);
+            if (starts) HStart[0] = c;
+            above = H[0];
+            aboveStart = c;
+            if (trace) {
+                if (trace->numCells == trace->capacity) return EDLIB_STATUS_ERROR;
+                trace->cells[trace->numCells++] = AFFINE_FROM_DELETION;
+            }
+            row++;
+        }
+        for (; row <= queryLength; row++) {
+            const bool inPrevColumn = row <= prevLastRow;
+            const int left = inPrevColumn ? H[row] : AFFINE_INF;
+            const int leftStart = starts && inPrevColumn ? HStart[row] : 0;
+            unsigned char move = 0;
+
+            // Alignment ending with deletion, extending gap or opening it.
+            int deletion = AFFINE_INF, deletionStart = 0;
+            if (inPrevColumn) {
+                deletion = D[row] + gapExtend;
+                if (starts) deletionStart = DStart[row];
+                const int opened = left + gapOpen + gapExtend;
+                if (opened < deletion || (starts && opened == deletion && leftStart < deletionStart)) {
+                    deletion = opened;
+                    deletionStart = leftStart;
+                    move |= AFFINE_DELETION_OPENED;
                 }
+                deletion = min(deletion, AFFINE_INF);
+            }
+            // Alignment ending with insertion.
+            insertion += gapExtend;
+            const int opened = above + gapOpen + gapExtend;
+            if (opened < insertion || (starts && opened == insertion && aboveStart < insertionStart)) {
+                insertion = opened;
+                insertionStart = aboveStart;
+                move |= AFFINE_INSERTION_OPENED;
+            }
+            insertion = min(insertion, AFFINE_INF);
+            // The best alignment, which prefers match or mismatch, then insertion and then deletion.
+            int best = diagonal + (equalityDefinition.areEqual(query[row - 1], targetChar) ? 0 : mismatch);
+            int bestStart = diagonalStart;
+            if (insertion < best || (starts && insertion == best && insertionStart < bestStart)) {
+                best = insertion;
+                bestStart = insertionStart;
+                move |= AFFINE_FROM_INSERTION;
             }
+            if (deletion < best || (starts && deletion == best && deletionStart < bestStart)) {
+                best = deletion;
+                bestStart = deletionStart;
+                move = (move & ~3) | AFFINE_FROM_DELETION;
+            }
+            best = min(best, AFFINE_INF);
+
+            diagonal = left;
+            diagonalStart = leftStart;
+            H[row] = above = best;
+            D[row] = deletion;
+            if (starts) {
+                HStart[row] = aboveStart = bestStart;
+                DStart[row] = deletionStart;
+            }
+            if (trace) {
+                if (trace->numCells == trace->capacity) return EDLIB_STATUS_ERROR;
+                trace->cells[trace->numCells++] = move;
+            }
+            // Below the last row of previous column, cells can be reached only with insertions,
+            // whose costs are not lower than cost of this cell.
+            if (!inPrevColumn && best > k) break;
         }
+        lastRow = min(row, queryLength);
+        blockCounter.addColumn(firstRow, lastRow);
 
-        // Find alignment -> all comes down to finding alignment for NW.
-        // Currently we return alignment only for first pair of locations.
-        if (config.task == EDLIB_TASK_PATH) {
-            int alnStartLocation = result.startLocations[0];
-            int alnEndLocation = result.endLocations[0];
-            const unsigned char* alnTarget = target + alnStartLocation;
-            const int alnTargetLength = alnEndLocation - alnStartLocation + 1;
-            const unsigned char* rAlnTarget = createReverseCopy(alnTarget, alnTargetLength);
-            const unsigned char* rQuery  = createReverseCopy(query, queryLength);
-            obtainAlignment(query, rQuery, queryLength,
-                            alnTarget, rAlnTarget, alnTargetLength,
-                            equalityDefinition, static_cast<int>(alphabet.size()), result.editDistance,
-                            &(result.alignment), &(result.alignmentLength));
-            delete[] rAlnTarget;
-            delete[] rQuery;
+        while (firstRow <= lastRow && !canBeInAlignment(firstRow, c)) firstRow++;
+        while (lastRow >= firstRow && !canBeInAlignment(lastRow, c)) lastRow--;
+        if (firstRow <= lastRow && lastRow == queryLength && (mode != EDLIB_MODE_NW || c == targetLength)) {
+            addPosition(c - 1, starts ? HStart[queryLength] : 0);
         }
     }
-    /*-------------------------------------------------------*/
+    return EDLIB_STATUS_OK;
+}
 
-    //--- Free memory ---//
-    delete[] Peq;
-    free(query);
-    free(target);
-    if (alignData) delete alignData;
-    //-------------------//
+/**
+ * Once edit distance and end locations are known, finds start locations and alignment path,
+ * depending on the task.
+ * Query and target must not be empty.
+ * @param [in] query  Transformed query.
+ * @param [in] rQuery  Reversed query, or NULL if it should be created here.
+ * @param [in] queryLength
+ * @param [in] target  Transformed target.
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] alphabetLength
+ * @param [in] Peq  Query profile.
+ * @param [in] rPeq  Profile of reversed query, or NULL if it should be built here.
+ * @param [in] config  If stats are set in it, stats of finding start locations and alignments are filled.
+ * @param [in] workspace  Temporary memory is allocated from it.
+ * @param [in,out] result  Result with edit distance (which is not -1) and end locations (not set for NW).
+ */
+template <typename Word, int WORD_SIZE>
+static void findStartLocationsAndAlignment(const unsigned char* const query, const unsigned char* const rQuery_,
+                                           const int queryLength,
+                                           const unsigned char* const target, const int targetLength,
+                                           const EqualityDefinition& equalityDefinition, const int alphabetLength,
+                                           const Word* const Peq, const Word* const rPeq_,
+                                           const EdlibAlignConfig& config, EdlibWorkspace& workspace,
+                                           EdlibAlignResult* const result) {
+    const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
+    const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    Arena& arena = workspace.arena;
+    ArenaScope arenaScope(arena);
 
-    return result;
+    const unsigned char* const rQuery = rQuery_ ? rQuery_ : createReverseCopy(query, queryLength, arena);
+    const Word* rPeq = rPeq_;
+
+    // If NW mode, set end location explicitly.
+    if (config.mode == EDLIB_MODE_NW) {
+        result->endLocations = static_cast<int *>(malloc(sizeof(int) * 1));
+        result->endLocations[0] = targetLength - 1;
+        result->numLocations = 1;
+    }
+
+    // Find starting locations.
+    if (config.task == EDLIB_TASK_LOC || config.task == EDLIB_TASK_PATH) {
+        result->startLocations = static_cast<int *>(malloc(result->numLocations * sizeof(int)));
+        if (config.mode == EDLIB_MODE_HW) {  // If HW, I need to calculate start locations.
+            const std::chrono::steady_clock::time_point startTime = config.stats
+                ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            WorkCounters counters;
+            const unsigned char* rTarget = createReverseCopy(target, targetLength, arena);
+            // Peq for reversed query.
+            if (!rPeq) {
+                rPeq = buildPeq<Word>(alphabetLength, rQuery, queryLength, equalityDefinition, arena);
+            }
+            for (int i = 0; i < result->numLocations; i++) {
+                int endLocation = result->endLocations[i];
+                if (endLocation == -1) {
+                    // NOTE: Sometimes one of optimal solutions is that query starts before target, like this:
+                    //                       AAGG <- target
+                    //                   CCTT     <- query
+                    //   It will never be only optimal solution and it does not happen often, however it is
+                    //   possible and in that case end location will be -1. What should we do with that?
+                    //   Should we just skip reporting such end location, although it is a solution?
+                    //   If we do report it, what is the start location? -4? -1? Nothing?
+                    // TODO: Figure this out. This has to do in general with how we think about start
+                    //   and end locations.
+                    //   Also, we have alignment later relying on this locations to limit the space of it's
+                    //   search -> how can it do it right if these locations are negative or incorrect?
+                    result->startLocations[i] = 0;  // I put 0 for now, but it does not make much sense.
+                } else {
+                    int bestScoreSHW;
+                    vector<int>& positionsSHW = workspace.positions;
+                    // Alignment with score k can not be longer than queryLength + k in target,
+                    // so there is no need to look further back than that.
+                    const int maxAlnTargetLength = min(endLocation + 1, queryLength + result->editDistance);
+                    myersCalcEditDistanceSemiGlobal(
+                            rPeq, W, maxNumBlocks,
+                            queryLength, rTarget + targetLength - endLocation - 1, maxAlnTargetLength,
+                            result->editDistance, EDLIB_MODE_SHW, arena,
+                            &bestScoreSHW, &positionsSHW, NULL, config.stats ? &counters : NULL);
+                    // Taking last location as start ensures that alignment will not start with insertions
+                    // if it can start with mismatches instead.
+                    result->startLocations[i] = endLocation - positionsSHW.back();
+                }
+            }
+            if (config.stats) counters.getStats(startTime, &config.stats->start);
+        } else {  // If mode is SHW or NW
+            for (int i = 0; i < result->numLocations; i++) {
+                result->startLocations[i] = 0;
+            }
+        }
+    }
+
+    // Find alignments -> all comes down to finding alignment for NW.
+    if (config.task == EDLIB_TASK_PATH) {
+        const std::chrono::steady_clock::time_point startTime = config.stats
+            ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        WorkCounters counters;
+        const int numAlignments = config.maxAlignments < 0 ? result->numLocations
+            : min(max(config.maxAlignments, 1), result->numLocations);
+        // Budget that is not given (e.g. in zero-initialized config) is the default one.
+        const long long tracebackMemoryBudget = config.tracebackMemoryBudget > 0
+            ? config.tracebackMemoryBudget : EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET;
+        size_t maxTotalLength = 0;
+        for (int i = 0; i < numAlignments; i++) {
+            const long long maxAlignmentLength = static_cast<long long>(queryLength)
+                + (result->endLocations[i] - result->startLocations[i] + 1);
+            if (maxAlignmentLength > INT_MAX) {  // Length of alignment might not fit into int.
+                result->status = EDLIB_STATUS_ERROR;
+                return;
+            }
+            maxTotalLength += static_cast<size_t>(maxAlignmentLength);
+        }
+        // Runs are made from alignments in arena, so alignments are not allocated for result.
+        unsigned char* const alignments = config.runLengthAlignment ? arena.allocate<unsigned char>(maxTotalLength)
+            : static_cast<unsigned char*>(malloc(maxTotalLength * sizeof(unsigned char)));
+        result->alignmentLengths = static_cast<int*>(malloc(numAlignments * sizeof(int)));
+        result->numAlignments = numAlignments;
+
+        // When query matches repeated part of target, parts of target where alignments are found are often same,
+        // so alignment is found only for first of same parts and copied to others.
+        // Alignments of different parts are kept in a hash table with open addressing by hash of their part,
+        // where each slot is index of alignment, or -1 if slot is empty.
+        const bool findSame = numAlignments > 1;
+        size_t* alignmentStarts = NULL;
+        uint64_t* alignmentHashes = NULL;
+        int* hashTable = NULL;
+        size_t hashTableMask = 0;
+        if (findSame) {
+            alignmentStarts = arena.allocate<size_t>(numAlignments);
+            alignmentHashes = arena.allocate<uint64_t>(numAlignments);
+            size_t hashTableSize = 1;
+            while (hashTableSize < 2 * static_cast<size_t>(numAlignments)) {
+                hashTableSize *= 2;
+            }
+            hashTable = arena.allocate<int>(hashTableSize);
+            fill(hashTable, hashTable + hashTableSize, -1);
+            hashTableMask = hashTableSize - 1;
+        }
+        size_t totalLength = 0;
+        for (int i = 0; i < numAlignments; i++) {
+            const unsigned char* alnTarget = target + result->startLocations[i];
+            const int alnTargetLength = result->endLocations[i] - result->startLocations[i] + 1;
+            unsigned char* const alignment = alignments + totalLength;
+            int same = -1;
+            size_t slot = 0;
+            if (findSame) {
+                alignmentHashes[i] = hashSequence(alnTarget, alnTargetLength);
+                for (slot = alignmentHashes[i] & hashTableMask; hashTable[slot] != -1;
+                     slot = (slot + 1) & hashTableMask) {
+                    const int a = hashTable[slot];
+                    if (alignmentHashes[a] == alignmentHashes[i]
+                        && result->endLocations[a] - result->startLocations[a] + 1 == alnTargetLength
+                        && memcmp(target + result->startLocations[a], alnTarget, alnTargetLength) == 0) {
+                        same = a;
+                        break;
+                    }
+                }
+            }
+            if (same != -1) {
+                result->alignmentLengths[i] = result->alignmentLengths[same];
+                memcpy(alignment, alignments + alignmentStarts[same], result->alignmentLengths[i]);
+            } else {
+                ArenaScope alignmentScope(arena);
+                const unsigned char* rAlnTarget = createReverseCopy(alnTarget, alnTargetLength, arena);
+                obtainAlignment(query, rQuery, queryLength,
+                                alnTarget, rAlnTarget, alnTargetLength,
+                                equalityDefinition, alphabetLength, result->editDistance, Peq, rPeq, arena,
+                                max(config.numThreads, 1), config.parallelCutoff, tracebackMemoryBudget,
+                                config.stats ? &counters : NULL, 0, alignment, &(result->alignmentLengths[i]));
+                if (findSame) {
+                    hashTable[slot] = i;  // Slot is empty, since search for same part stopped at it.
+                }
+            }
+            if (findSame) {
+                alignmentStarts[i] = totalLength;
+            }
+            totalLength += result->alignmentLengths[i];
+        }
+        result->alignmentLength = result->alignmentLengths[0];
+        if (config.runLengthAlignment) {
+            setAlignmentRuns(alignments, result);
+        } else {
+            result->alignment = static_cast<unsigned char*>(realloc(alignments, totalLength * sizeof(unsigned char)));
+        }
+        if (config.stats) {
+            counters.getStats(startTime, &config.stats->alignment);
+            config.stats->hirschbergDepth = counters.hirschbergDepth;
+        }
+    }
 }
 
 extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, const int alignmentLength,
                                        const EdlibCigarFormat cigarFormat) {
-    if (cigarFormat != EDLIB_CIGAR_EXTENDED && cigarFormat != EDLIB_CIGAR_STANDARD) {
+    // Length of cigar is found first, so that it can be written directly into memory of right size.
+    const int cigarLength = edlibAlignmentToCigarBuffer(alignment, alignmentLength, cigarFormat, NULL, 0);
+    if (cigarLength < 0) {
         return 0;
     }
+    char* cigar = static_cast<char *>(malloc((static_cast<size_t>(cigarLength) + 1) * sizeof(char)));
+    edlibAlignmentToCigarBuffer(alignment, alignmentLength, cigarFormat, cigar, cigarLength + 1);
+    return cigar;
+}
+
+extern "C" int edlibAlignmentToCigarBuffer(const unsigned char* const alignment, const int alignmentLength,
+                                           const EdlibCigarFormat cigarFormat,
+                                           char* const cigar, const int cigarCapacity) {
+    if (cigarFormat != EDLIB_CIGAR_EXTENDED && cigarFormat != EDLIB_CIGAR_STANDARD) {
+        return -1;
+    }
 
     // Maps move code from alignment to char in cigar.
     //                        0    1    2    3
@@ -313,55 +2902,105 @@ extern "C" char* edlibAlignmentToCigar(const unsigned char* const alignment, con
         moveCodeToChar[0] = moveCodeToChar[3] = 'M';
     }
 
-    vector<char> cigar;
-    char lastMove = 0;  // Char of last move. 0 if there was no previous move.
-    int numOfSameMoves = 0;
-    for (int i = 0; i <= alignmentLength; i++) {
-        // if new sequence of same moves started
-        if (i == alignmentLength || (moveCodeToChar[alignment[i]] != lastMove && lastMove != 0)) {
-            // Write number of moves to cigar string.
-            int numDigits = 0;
-            for (; numOfSameMoves; numOfSameMoves /= 10) {
-                cigar.push_back('0' + numOfSameMoves % 10);
-                numDigits++;
-            }
-            reverse(cigar.end() - numDigits, cigar.end());
-            // Write code of move to cigar string.
-            cigar.push_back(lastMove);
-            // If not at the end, start new sequence of moves.
-            if (i < alignmentLength) {
-                // Check if alignment has valid values.
-                if (alignment[i] > 3) {
-                    return 0;
-                }
-                numOfSameMoves = 0;
+    long long cigarLength = 0;
+    const bool valid = forEachCigarOperation(alignment, alignmentLength, moveCodeToChar,
+                                             [&](const char move, const int numOfSameMoves) {
+        int numDigits = 1;
+        int power = 1;  // Power of 10 of most significant digit.
+        for (; numOfSameMoves / power >= 10; power *= 10) {
+            numDigits++;
+        }
+        // Write number of moves and code of move to cigar string, if there is room for them and null character.
+        if (cigar && cigarLength + numDigits + 1 < cigarCapacity) {
+            for (; power; power /= 10) {
+                cigar[cigarLength++] = static_cast<char>('0' + numOfSameMoves / power % 10);
+            }
+            cigar[cigarLength++] = move;
+        } else {
+            cigarLength += numDigits + 1;
+        }
+        return cigarLength < INT_MAX;  // Length of cigar has to fit into int.
+    });
+    if (!valid) {
+        return -1;
+    }
+    if (cigar && cigarLength < cigarCapacity) {
+        cigar[cigarLength] = 0;  // Null character termination.
+    }
+    return static_cast<int>(cigarLength);
+}
+
+extern "C" int edlibAlignmentToPackedCigar(const unsigned char* const alignment, const int alignmentLength,
+                                           const EdlibCigarFormat cigarFormat,
+                                           uint32_t* const cigar, const int cigarCapacity) {
+    if (cigarFormat != EDLIB_CIGAR_EXTENDED && cigarFormat != EDLIB_CIGAR_STANDARD) {
+        return -1;
+    }
+
+    // Maps move code from alignment to code of operation in BAM: M, I, D, N, S, H, P, =, X are 0 to 8.
+    //                            0  1  2  3
+    uint32_t moveCodeToBamOp[] = {7, 1, 2, 8};
+    if (cigarFormat == EDLIB_CIGAR_STANDARD) {
+        moveCodeToBamOp[0] = moveCodeToBamOp[3] = 0;
+    }
+
+    // Length of operation has 28 bits in BAM, so longer sequences of same moves are split into more operations.
+    const int MAX_OPERATION_LENGTH = (1 << 28) - 1;
+    int numOperations = 0;
+    const bool valid = forEachCigarOperation(alignment, alignmentLength, moveCodeToBamOp,
+                                             [&](const uint32_t op, const int numOfSameMoves) {
+        for (int remaining = numOfSameMoves; remaining > 0; remaining -= MAX_OPERATION_LENGTH) {
+            if (cigar && numOperations < cigarCapacity) {
+                cigar[numOperations] = static_cast<uint32_t>(min(remaining, MAX_OPERATION_LENGTH)) << 4 | op;
             }
+            numOperations++;
         }
-        if (i < alignmentLength) {
-            lastMove = moveCodeToChar[alignment[i]];
+        return true;
+    });
+    return valid ? numOperations : -1;
+}
+
+/**
+ * Calls given function for each sequence of same moves in alignment, in order,
+ * with code of those moves (mapped through moveCodes) and their number.
+ * Consecutive moves with same mapped code form one sequence.
+ * @return False if alignment has invalid values or if function returned false, true otherwise.
+ */
+template <typename Code, typename Function>
+static bool forEachCigarOperation(const unsigned char* const alignment, const int alignmentLength,
+                                  const Code* const moveCodes, const Function& function) {
+    for (int i = 0; i < alignmentLength;) {
+        // Check if alignment has valid values.
+        if (alignment[i] > 3) {
+            return false;
+        }
+        const Code code = moveCodes[alignment[i]];
+        int numOfSameMoves = 0;
+        for (; i < alignmentLength && alignment[i] <= 3 && moveCodes[alignment[i]] == code; i++) {
             numOfSameMoves++;
         }
+        if (!function(code, numOfSameMoves)) {
+            return false;
+        }
     }
-    cigar.push_back(0);  // Null character termination.
-    char* cigar_ = static_cast<char *>(malloc(cigar.size() * sizeof(char)));
-    memcpy(cigar_, cigar.data(), cigar.size() * sizeof(char));
-
-    return cigar_;
+    return true;
 }
 
 /**
  * Build Peq table for given query and alphabet.
  * Peq is table of dimensions alphabetLength+1 x maxNumBlocks.
  * Bit i of Peq[s * maxNumBlocks + b] is 1 if i-th symbol from block b of query equals symbol s, otherwise it is 0.
- * NOTICE: free returned array with delete[]!
+ * NOTICE: returned array is allocated from arena!
  */
+template <typename Word, int WORD_SIZE>
 static inline Word* buildPeq(const int alphabetLength,
                              const unsigned char* const query,
                              const int queryLength,
-                             const EqualityDefinition& equalityDefinition) {
+                             const EqualityDefinition& equalityDefinition,
+                             Arena& arena) {
     int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
     // table of dimensions alphabetLength+1 x maxNumBlocks. Last symbol is wildcard.
-    Word* Peq = new Word[(alphabetLength + 1) * maxNumBlocks];
+    Word* Peq = arena.allocate<Word>((alphabetLength + 1) * maxNumBlocks);
 
     // Build Peq (1 is match, 0 is mismatch). NOTE: last column is wildcard(symbol that matches anything) with just 1s
     for (int symbol = 0; symbol <= alphabetLength; symbol++) {
@@ -386,16 +3025,47 @@ static inline Word* buildPeq(const int alphabetLength,
 
 /**
  * Returns new sequence that is reverse of given sequence.
- * Free returned array with delete[].
+ * Returned array is allocated from arena.
  */
-static inline unsigned char* createReverseCopy(const unsigned char* const seq, const int length) {
-    unsigned char* rSeq = new unsigned char[length];
+static inline unsigned char* createReverseCopy(const unsigned char* const seq, const int length, Arena& arena) {
+    unsigned char* rSeq = arena.allocate<unsigned char>(length);
     for (int i = 0; i < length; i++) {
         rSeq[i] = seq[length - i - 1];
     }
     return rSeq;
 }
 
+/**
+ * @return FNV-1a hash of given sequence.
+ */
+static inline uint64_t hashSequence(const unsigned char* const seq, const int length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ seq[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @return Polynomial hash of seed, which is sum of seed[i] * SEED_HASH_BASE^(seedLength - 1 - i),
+ *         so that it can be rolled along target.
+ */
+static inline uint64_t hashSeed(const char* const seed, const int seedLength) {
+    uint64_t hash = 0;
+    for (int i = 0; i < seedLength; i++) {
+        hash = hash * SEED_HASH_BASE + static_cast<unsigned char>(seed[i]);
+    }
+    return hash;
+}
+
+/**
+ * @return Bucket of target index for seed with given hash, which is taken from the highest bits of
+ *         hash multiplied by odd constant, so that all characters of seed affect it.
+ */
+static inline int seedBucket(const uint64_t seedHash, const int bucketBits) {
+    return static_cast<int>((seedHash * 0x9E3779B97F4A7C15ULL) >> (64 - bucketBits));
+}
+
 /**
  * Corresponds to Advance_Block function from Myers.
  * Calculates one word(block), which is part of a column.
@@ -409,6 +3079,7 @@ static inline unsigned char* createReverseCopy(const unsigned char* const seq, c
  * @param [out] MvOut  Bitset, MvOut[i] == 1 if vout is -1, otherwise MvOut[i] == 0.
  * @param [out] hout  Will be +1, 0 or -1.
  */
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
 static inline int calculateBlock(Word Pv, Word Mv, Word Eq, const int hin,
                                  Word &PvOut, Word &MvOut) {
     // hin can be 1, -1 or 0.
@@ -416,7 +3087,8 @@ static inline int calculateBlock(Word Pv, Word Mv, Word Eq, const int hin,
     // 0  -> 00...00
     // -1 -> 11...11 (2-complement)
 
-    Word hinIsNeg = static_cast<Word>(hin >> 2) & WORD_1; // 00...001 if hin is -1, 00...000 if 0 or 1
+    const Word HIGH_BIT_MASK = static_cast<Word>(1) << (WORD_SIZE - 1);  // 100..00
+    Word hinIsNeg = static_cast<Word>(hin >> 2) & static_cast<Word>(1); // 00...001 if hin is -1, 00...000 if 0 or 1
 
     Word Xv = Eq | Mv;
     // This is instruction below written using 'if': if (hin < 0) Eq |= (Word)1;
@@ -443,7 +3115,250 @@ static inline int calculateBlock(Word Pv, Word Mv, Word Eq, const int hin,
     PvOut = Mh | ~(Xv | Ph);
     MvOut = Ph & Xv;
 
-    return hout;
+    return hout;
+}
+
+/**
+ * Calculates blocks from firstBlock to lastBlock (both inclusive) of one column, one by one,
+ * passing hout of each block as hin to the block below it. Score of each block is updated.
+ * @param [in,out] blocks  Blocks of the column, indexed from the top of the column.
+ * @param [in] Peq_c  Query profile for the target character of this column, indexed by blocks.
+ * @param [in] firstBlock
+ * @param [in] lastBlock
+ * @param [in] hin  hin of the first block. Will be +1, 0 or -1.
+ * @return hout of the last block.
+ */
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static inline int calculateBlocksScalar(Block<Word>* const blocks, const Word* const Peq_c,
+                                        const int firstBlock, const int lastBlock, int hin) {
+    for (int b = firstBlock; b <= lastBlock; b++) {
+        hin = calculateBlock(blocks[b].P, blocks[b].M, Peq_c[b], hin, blocks[b].P, blocks[b].M);
+        blocks[b].score += hin;
+    }
+    return hin;
+}
+
+#ifdef EDLIB_X86_SIMD
+/*
+ * Multi-block kernels.
+ * N consecutive blocks of a column are equivalent to one block of N * WORD_SIZE cells:
+ * hout of the block is hin of the block below it, which in one wide block corresponds to the carry of the
+ * addition and to the bit that is shifted from one word into the next one.
+ * Therefore we calculate N blocks at once as one wide word that is spread over N SIMD lanes,
+ * doing the carry propagation between lanes explicitly. hout of each lane is still extracted,
+ * since we need it to update the score of each block.
+ */
+
+/**
+ * Calculates 4 consecutive blocks starting with bl[0] as one 256-bit word.
+ * @param [in,out] bl  First of the 4 blocks.
+ * @param [in] Eqs  Query profile for the first of the 4 blocks.
+ * @param [in] hin  hin of the first block. Will be +1, 0 or -1.
+ * @return hout of the last (fourth) block.
+ */
+__attribute__((target("avx2")))
+static inline int calculate4Blocks(Block<uint64_t>* const bl, const uint64_t* const Eqs, const int hin) {
+    const __m256i allOnes = _mm256_set1_epi64x(-1);
+    const __m256i highBits = _mm256_set1_epi64x(static_cast<long long>(1ull << 63));
+    const __m256i laneBits = _mm256_set_epi64x(8, 4, 2, 1);
+    const long long hinIsNeg = (hin >> 2) & 1;
+    const long long hinIsPos = (hin + 1) >> 1;
+
+    const __m256i Pv = _mm256_set_epi64x(static_cast<long long>(bl[3].P), static_cast<long long>(bl[2].P),
+                                         static_cast<long long>(bl[1].P), static_cast<long long>(bl[0].P));
+    const __m256i Mv = _mm256_set_epi64x(static_cast<long long>(bl[3].M), static_cast<long long>(bl[2].M),
+                                         static_cast<long long>(bl[1].M), static_cast<long long>(bl[0].M));
+    __m256i Eq = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Eqs));
+
+    const __m256i Xv = _mm256_or_si256(Eq, Mv);
+    Eq = _mm256_or_si256(Eq, _mm256_set_epi64x(0, 0, 0, hinIsNeg));
+    const __m256i EqAndPv = _mm256_and_si256(Eq, Pv);
+
+    // 256-bit addition (Eq & Pv) + Pv. Lane generates carry if its sum overflowed,
+    // and propagates incoming carry if its sum is all 1s. We resolve carries for all lanes at once by
+    // adding lane masks as integers: that way carry ripples through propagating lanes same as it would through bits.
+    __m256i sum = _mm256_add_epi64(EqAndPv, Pv);
+    const int generated = _mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_cmpgt_epi64(_mm256_xor_si256(Pv, highBits), _mm256_xor_si256(sum, highBits))));
+    const int propagated = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(sum, allOnes)));
+    const int carries = (((generated << 1) + propagated) ^ propagated) & 0xF;
+    const __m256i carriesMask = _mm256_and_si256(_mm256_set1_epi64x(carries), laneBits);
+    sum = _mm256_add_epi64(sum, _mm256_srli_epi64(_mm256_cmpeq_epi64(carriesMask, laneBits), 63));
+
+    const __m256i Xh = _mm256_or_si256(_mm256_xor_si256(sum, Pv), Eq);
+    __m256i Ph = _mm256_or_si256(Mv, _mm256_andnot_si256(_mm256_or_si256(Xh, Pv), allOnes));
+    __m256i Mh = _mm256_and_si256(Pv, Xh);
+
+    const __m256i PhHigh = _mm256_srli_epi64(Ph, 63);
+    const __m256i MhHigh = _mm256_srli_epi64(Mh, 63);
+    alignas(32) long long hout[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(hout), _mm256_sub_epi64(PhHigh, MhHigh));
+
+    // Shift left by 1 over the whole 256-bit word: high bit of each lane goes into the lane above it,
+    // while first lane receives hin.
+    Ph = _mm256_or_si256(_mm256_slli_epi64(Ph, 1),
+                         _mm256_blend_epi32(_mm256_permute4x64_epi64(PhHigh, 0x93),
+                                            _mm256_set_epi64x(0, 0, 0, hinIsPos), 0x03));
+    Mh = _mm256_or_si256(_mm256_slli_epi64(Mh, 1),
+                         _mm256_blend_epi32(_mm256_permute4x64_epi64(MhHigh, 0x93),
+                                            _mm256_set_epi64x(0, 0, 0, hinIsNeg), 0x03));
+
+    alignas(32) uint64_t PvOut[4];
+    alignas(32) uint64_t MvOut[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(PvOut),
+                       _mm256_or_si256(Mh, _mm256_andnot_si256(_mm256_or_si256(Xv, Ph), allOnes)));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(MvOut), _mm256_and_si256(Ph, Xv));
+    for (int i = 0; i < 4; i++) {
+        bl[i].P = PvOut[i];
+        bl[i].M = MvOut[i];
+        bl[i].score += static_cast<int>(hout[i]);
+    }
+    return static_cast<int>(hout[3]);
+}
+
+// Some versions of GCC give false positive warnings for AVX-512 intrinsics (GCC bug 105593).
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/**
+ * Same as calculate4Blocks(), but calculates 8 consecutive blocks as one 512-bit word.
+ */
+__attribute__((target("avx512f")))
+static inline int calculate8Blocks(Block<uint64_t>* const bl, const uint64_t* const Eqs, const int hin) {
+    const __m512i allOnes = _mm512_set1_epi64(-1);
+    const long long hinIsNeg = (hin >> 2) & 1;
+    const long long hinIsPos = (hin + 1) >> 1;
+
+    const __m512i Pv = _mm512_set_epi64(
+        static_cast<long long>(bl[7].P), static_cast<long long>(bl[6].P),
+        static_cast<long long>(bl[5].P), static_cast<long long>(bl[4].P),
+        static_cast<long long>(bl[3].P), static_cast<long long>(bl[2].P),
+        static_cast<long long>(bl[1].P), static_cast<long long>(bl[0].P));
+    const __m512i Mv = _mm512_set_epi64(
+        static_cast<long long>(bl[7].M), static_cast<long long>(bl[6].M),
+        static_cast<long long>(bl[5].M), static_cast<long long>(bl[4].M),
+        static_cast<long long>(bl[3].M), static_cast<long long>(bl[2].M),
+        static_cast<long long>(bl[1].M), static_cast<long long>(bl[0].M));
+    __m512i Eq = _mm512_loadu_si512(Eqs);
+
+    const __m512i Xv = _mm512_or_si512(Eq, Mv);
+    Eq = _mm512_mask_or_epi64(Eq, 1, Eq, _mm512_set1_epi64(hinIsNeg));
+    const __m512i EqAndPv = _mm512_and_si512(Eq, Pv);
+
+    // 512-bit addition (Eq & Pv) + Pv, carries are resolved same as in calculate4Blocks().
+    __m512i sum = _mm512_add_epi64(EqAndPv, Pv);
+    const unsigned generated = _mm512_cmplt_epu64_mask(sum, Pv);
+    const unsigned propagated = _mm512_cmpeq_epi64_mask(sum, allOnes);
+    const __mmask8 carries = static_cast<__mmask8>(((generated << 1) + propagated) ^ propagated);
+    sum = _mm512_mask_add_epi64(sum, carries, sum, _mm512_set1_epi64(1));
+
+    const __m512i Xh = _mm512_or_si512(_mm512_xor_si512(sum, Pv), Eq);
+    __m512i Ph = _mm512_or_si512(Mv, _mm512_andnot_si512(_mm512_or_si512(Xh, Pv), allOnes));
+    __m512i Mh = _mm512_and_si512(Pv, Xh);
+
+    const __m512i PhHigh = _mm512_srli_epi64(Ph, 63);
+    const __m512i MhHigh = _mm512_srli_epi64(Mh, 63);
+    alignas(64) long long hout[8];
+    _mm512_store_si512(hout, _mm512_sub_epi64(PhHigh, MhHigh));
+
+    // Shift left by 1 over the whole 512-bit word, first lane receives hin.
+    Ph = _mm512_or_si512(_mm512_slli_epi64(Ph, 1), _mm512_alignr_epi64(PhHigh, _mm512_set1_epi64(hinIsPos), 7));
+    Mh = _mm512_or_si512(_mm512_slli_epi64(Mh, 1), _mm512_alignr_epi64(MhHigh, _mm512_set1_epi64(hinIsNeg), 7));
+
+    alignas(64) uint64_t PvOut[8];
+    alignas(64) uint64_t MvOut[8];
+    _mm512_store_si512(PvOut, _mm512_or_si512(Mh, _mm512_andnot_si512(_mm512_or_si512(Xv, Ph), allOnes)));
+    _mm512_store_si512(MvOut, _mm512_and_si512(Ph, Xv));
+    for (int i = 0; i < 8; i++) {
+        bl[i].P = PvOut[i];
+        bl[i].M = MvOut[i];
+        bl[i].score += static_cast<int>(hout[i]);
+    }
+    return static_cast<int>(hout[7]);
+}
+
+/**
+ * Same as calculateBlocksScalar(), but calculates 4 blocks at once while possible.
+ */
+__attribute__((target("avx2")))
+static int calculateBlocksAvx2(Block<uint64_t>* const blocks, const uint64_t* const Peq_c,
+                               const int firstBlock, const int lastBlock, int hin) {
+    int b = firstBlock;
+    for (; b + 3 <= lastBlock; b += 4) {
+        hin = calculate4Blocks(blocks + b, Peq_c + b, hin);
+    }
+    return calculateBlocksScalar(blocks, Peq_c, b, lastBlock, hin);
+}
+
+/**
+ * Same as calculateBlocksScalar(), but calculates 8 blocks at once while possible.
+ */
+__attribute__((target("avx512f")))
+static int calculateBlocksAvx512(Block<uint64_t>* const blocks, const uint64_t* const Peq_c,
+                                 const int firstBlock, const int lastBlock, int hin) {
+    int b = firstBlock;
+    for (; b + 7 <= lastBlock; b += 8) {
+        hin = calculate8Blocks(blocks + b, Peq_c + b, hin);
+    }
+    for (; b + 3 <= lastBlock; b += 4) {
+        hin = calculate4Blocks(blocks + b, Peq_c + b, hin);
+    }
+    return calculateBlocksScalar(blocks, Peq_c, b, lastBlock, hin);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+/**
+ * @return Best SIMD instruction set that is supported by this CPU and that we have kernels for.
+ *         It is detected only once.
+ */
+static SimdLevel getSimdLevel() {
+#ifdef EDLIB_X86_SIMD
+    static const SimdLevel simdLevel =
+        __builtin_cpu_supports("avx512f") ? SIMD_AVX512
+        : __builtin_cpu_supports("avx2") ? SIMD_AVX2
+        : SIMD_NONE;
+    return simdLevel;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+/**
+ * Calculates blocks from firstBlock to lastBlock (both inclusive) of one column.
+ * Same as calculateBlocksScalar(), but uses multi-block SIMD kernel when it is supported by CPU
+ * and there is enough blocks for it to pay off.
+ * @param [in] simdLevel  Obtained with getSimdLevel().
+ */
+static inline int calculateBlocks(Block<uint64_t>* const blocks, const uint64_t* const Peq_c,
+                                  const int firstBlock, const int lastBlock, const int hin,
+                                  const SimdLevel simdLevel) {
+#ifdef EDLIB_X86_SIMD
+    const int numBlocks = lastBlock - firstBlock + 1;
+    if (simdLevel == SIMD_AVX512 && numBlocks >= 8) {
+        return calculateBlocksAvx512(blocks, Peq_c, firstBlock, lastBlock, hin);
+    }
+    if (simdLevel != SIMD_NONE && numBlocks >= 4) {
+        return calculateBlocksAvx2(blocks, Peq_c, firstBlock, lastBlock, hin);
+    }
+#else
+    (void) simdLevel;
+#endif
+    return calculateBlocksScalar(blocks, Peq_c, firstBlock, lastBlock, hin);
+}
+
+/**
+ * Same as calculateBlocks() above, for words for which there are no multi-block kernels.
+ */
+template <typename Word>
+static inline int calculateBlocks(Block<Word>* const blocks, const Word* const Peq_c,
+                                  const int firstBlock, const int lastBlock, const int hin, SimdLevel) {
+    return calculateBlocksScalar(blocks, Peq_c, firstBlock, lastBlock, hin);
 }
 
 /**
@@ -454,6 +3369,28 @@ static inline int ceilDiv(const int x, const int y) {
     return x % y ? x / y + 1 : x / y;
 }
 
+/**
+ * @return True if query is aligned using 32-bit words instead of 64-bit ones.
+ *         Query that fits into 32 bits would use only part of 64-bit word,
+ *         while with 32-bit words multi-target kernel aligns twice as many targets at once.
+ */
+static inline bool useShortWords(const int queryLength) {
+    return queryLength <= 32;
+}
+
+/**
+ * @return Upper bound for number of blocks in one column of band, as calculated by myersCalcEditDistanceNW().
+ */
+template <typename Word, int WORD_SIZE>
+static inline int getMaxNumBandBlocks(const int maxNumBlocks, const int k) {
+    // Block stays in band only if score of its last cell is smaller than k + WORD_SIZE,
+    // and score of cell in row r and column c is at least |r - c|. Therefore last cell of first block
+    // is in row c - k - WORD_SIZE + 1 or lower, and last cell of last block is in row c + k + WORD_SIZE - 1
+    // or higher, which gives at most 2k + 3 * WORD_SIZE - 2 rows in band.
+    const long long numRows = 2ll * k + 3 * WORD_SIZE - 2;
+    return static_cast<int>(std::min(static_cast<long long>(maxNumBlocks), (numRows + WORD_SIZE - 1) / WORD_SIZE));
+}
+
 static inline int min(const int x, const int y) {
     return x < y ? x : y;
 }
@@ -467,10 +3404,11 @@ static inline int max(const int x, const int y) {
  * @param [in] block
  * @return Values of cells in block, starting with bottom cell in block.
  */
-static inline std::array<int, WORD_SIZE> getBlockCellValues(const Block block) {
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static inline std::array<int, WORD_SIZE> getBlockCellValues(const Block<Word> block) {
     std::array<int, WORD_SIZE> scores;
     int score = block.score;
-    Word mask = HIGH_BIT_MASK;
+    Word mask = static_cast<Word>(1) << (WORD_SIZE - 1);
     for (int i = 0; i < WORD_SIZE - 1; i++) {
         scores[i] = score;
         if (block.P & mask) score--;
@@ -486,9 +3424,10 @@ static inline std::array<int, WORD_SIZE> getBlockCellValues(const Block block) {
  * @param [in] block
  * @param [out] dest  Array into which cell values are written. Must have size of at least WORD_SIZE.
  */
-static inline void readBlock(const Block block, int* const dest) {
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static inline void readBlock(const Block<Word> block, int* const dest) {
     int score = block.score;
-    Word mask = HIGH_BIT_MASK;
+    Word mask = static_cast<Word>(1) << (WORD_SIZE - 1);
     for (int i = 0; i < WORD_SIZE - 1; i++) {
         dest[WORD_SIZE - 1 - i] = score;
         if (block.P & mask) score--;
@@ -503,9 +3442,10 @@ static inline void readBlock(const Block block, int* const dest) {
  * @param [in] block
  * @param [out] dest  Array into which cell values are written. Must have size of at least WORD_SIZE.
  */
-static inline void readBlockReverse(const Block block, int* const dest) {
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static inline void readBlockReverse(const Block<Word> block, int* const dest) {
     int score = block.score;
-    Word mask = HIGH_BIT_MASK;
+    Word mask = static_cast<Word>(1) << (WORD_SIZE - 1);
     for (int i = 0; i < WORD_SIZE - 1; i++) {
         dest[i] = score;
         if (block.P & mask) score--;
@@ -520,7 +3460,8 @@ static inline void readBlockReverse(const Block block, int* const dest) {
  * @param [in] k
  * @return True if all cells in block have value larger than k, otherwise false.
  */
-static inline bool allBlockCellsLarger(const Block block, const int k) {
+template <typename Word, int WORD_SIZE = sizeof(Word) * 8>
+static inline bool allBlockCellsLarger(const Block<Word> block, const int k) {
     std::array<int, WORD_SIZE> scores = getBlockCellValues(block);
     for (int i = 0; i < WORD_SIZE; i++) {
         if (scores[i] <= k) return false;
@@ -530,77 +3471,89 @@ static inline bool allBlockCellsLarger(const Block block, const int k) {
 
 
 /**
- * Uses Myers' bit-vector algorithm to find edit distance for one of semi-global alignment methods.
- * @param [in] Peq  Query profile.
- * @param [in] W  Size of padding in last block.
- *                TODO: Calculate this directly from query, instead of passing it.
- * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
- *                           TODO: Calculate this directly from query, instead of passing it.
+ * Initializes state of semi-global alignment before the first column.
+ * @param [in] maxNumBlocks
  * @param [in] queryLength
- * @param [in] target
- * @param [in] targetLength
  * @param [in] k
- * @param [in] mode  EDLIB_MODE_HW or EDLIB_MODE_SHW
- * @param [out] bestScore_  Edit distance.
- * @param [out] positions_  Array of 0-indexed positions in target at which best score was found.
-                            Make sure to free this array with free().
- * @param [out] numPositions_  Number of positions in the positions_ array.
- * @return Status.
+ * @param [in] blocks  Array of maxNumBlocks blocks, which is used by state.
+ * @param [out] state
  */
-static int myersCalcEditDistanceSemiGlobal(
-        const Word* const Peq, const int W, const int maxNumBlocks,
-        const int queryLength,
-        const unsigned char* const target, const int targetLength,
-        int k, const EdlibAlignMode mode,
-        int* const bestScore_, int** const positions_, int* const numPositions_) {
-    *positions_ = NULL;
-    *numPositions_ = 0;
-
-    // firstBlock is 0-based index of first block in Ukkonen band.
-    // lastBlock is 0-based index of last block in Ukkonen band.
-    int firstBlock = 0;
-    int lastBlock = min(ceilDiv(k + 1, WORD_SIZE), maxNumBlocks) - 1; // y in Myers
-    Block* blocks = new Block[maxNumBlocks];
-
-    // For HW, solution will never be larger then queryLength.
-    if (mode == EDLIB_MODE_HW) {
-        k = min(queryLength, k);
-    }
-
-    // Each STRONG_REDUCE_NUM column is reduced in more expensive way.
-    // This gives speed up of about 2 times for small k.
-    const int STRONG_REDUCE_NUM = 2048;
+template <typename Word, int WORD_SIZE>
+static void initSemiGlobalState(const int maxNumBlocks, const int queryLength, const int k,
+                                Block<Word>* const blocks, SemiGlobalState<Word>* const state) {
+    state->blocks = blocks;
+    state->firstBlock = 0;
+    // Solution will never be larger then queryLength (for SHW, query can always be aligned to first
+    // character of target), so k is limited to it, which also keeps k + WORD_SIZE from overflowing.
+    state->k = min(queryLength, k);
+    state->lastBlock = min(state->k / WORD_SIZE + 1, maxNumBlocks) - 1; // y in Myers
+    state->bestScore = -1;
+    state->strongReducePhase = 0;
 
     // Initialize P, M and score
-    for (int b = 0; b <= lastBlock; b++) {
+    for (int b = 0; b <= state->lastBlock; b++) {
         blocks[b].score = (b + 1) * WORD_SIZE;
         blocks[b].P = static_cast<Word>(-1); // All 1s
         blocks[b].M = static_cast<Word>(0);
     }
+}
 
-    int bestScore = -1;
-    int bl = 0; // Current block index
-    vector<int> positions;
+/**
+ * Calculates columns of semi-global alignment for given part of target,
+ * continuing from the state after the previous part.
+ * @param [in] Peq  Query profile.
+ * @param [in] W  Size of padding in last block.
+ * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
+ * @param [in] target  Part of target.
+ * @param [in] targetLength  Length of part of target.
+ * @param [in] mode  EDLIB_MODE_HW or EDLIB_MODE_SHW
+ * @param [in,out] state
+ * @param [in,out] positions  0-indexed positions, relative to start of this part of target, at which best score
+ *                            was found are added to it, or it is cleared and filled again when better score is found.
+ *                            Positions can be negative (down to -W), if they are in one of previous parts.
+ * @param [in,out] scores  If NULL, only positions with best score are found, and k is lowered to best score.
+ *                         Otherwise, all positions with score of at most k are added to positions,
+ *                         and their scores are added to it.
+ * @param [in,out] counters  Calculated blocks are counted in it, if it is not NULL.
+ * @return False if band stopped to exist, so no more positions can be found, otherwise true.
+ */
+template <typename Word, int WORD_SIZE>
+static bool calcSemiGlobalColumns(const Word* const Peq, const int W, const int maxNumBlocks,
+                                  const unsigned char* const target, const int targetLength,
+                                  const EdlibAlignMode mode, SemiGlobalState<Word>* const state,
+                                  vector<int>* const positions_, vector<int>* const scores_,
+                                  WorkCounters* const counters) {
+    vector<int>& positions = *positions_;
+    BlockCounter blockCounter(counters);
+    Block<Word>* const blocks = state->blocks;
+    int firstBlock = state->firstBlock;
+    int lastBlock = state->lastBlock;
+    int k = state->k;
+    int bestScore = state->bestScore;
+    const int strongReducePhase = state->strongReducePhase;
+
+    // Each STRONG_REDUCE_NUM column is reduced in more expensive way.
+    // This gives speed up of about 2 times for small k.
+    const int STRONG_REDUCE_NUM = 2048;
+
+    int bl = lastBlock; // Current block index
+    const SimdLevel simdLevel = getSimdLevel();
     const int startHout = mode == EDLIB_MODE_HW ? 0 : 1; // If 0 then gap before query is not penalized;
     const unsigned char* targetChar = target;
+    bool bandExists = true;
     for (int c = 0; c < targetLength; c++) { // for each column
         const Word* Peq_c = Peq + (*targetChar) * maxNumBlocks;
 
         //----------------------- Calculate column -------------------------//
-        int hout = startHout;
-        bl = firstBlock;
-        Peq_c += firstBlock;
-        for (int b = firstBlock; b <= lastBlock; b++) {
-            hout = calculateBlock(blocks[bl].P, blocks[bl].M, *Peq_c, hout, blocks[bl].P, blocks[bl].M);
-            blocks[bl].score += hout;
-            bl++; Peq_c++;
-        }
-        bl--; Peq_c--;
+        int hout = calculateBlocks(blocks, Peq_c, firstBlock, lastBlock, startHout, simdLevel);
+        blockCounter.addColumn(firstBlock, lastBlock);
+        bl = lastBlock;
+        Peq_c += lastBlock;
         //------------------------------------------------------------------//
 
         //---------- Adjust number of blocks according to Ukkonen ----------//
         if ((lastBlock < maxNumBlocks - 1) && (blocks[bl].score - hout <= k) // bl is pointing to last block
-            && ((*(Peq_c + 1) & WORD_1) || hout < 0)) { // Peq_c is pointing to last block
+            && ((*(Peq_c + 1) & static_cast<Word>(1)) || hout < 0)) { // Peq_c is pointing to last block
             // If score of left block is not too big, calculate one more block
             lastBlock++; bl++; Peq_c++;
             blocks[bl].P = static_cast<Word>(-1); // All 1s
@@ -616,7 +3569,8 @@ static int myersCalcEditDistanceSemiGlobal(
         // This is important!
         //
         // Reduce the band by decreasing last block if possible.
-        if (c % STRONG_REDUCE_NUM == 0) {
+        const bool strongReduce = (strongReducePhase + c) % STRONG_REDUCE_NUM == 0;
+        if (strongReduce) {
             while (lastBlock >= 0 && lastBlock >= firstBlock && allBlockCellsLarger(blocks[bl], k)) {
                 lastBlock--; bl--; Peq_c--;
             }
@@ -634,7 +3588,7 @@ static int myersCalcEditDistanceSemiGlobal(
             while (firstBlock <= lastBlock && blocks[firstBlock].score >= k + WORD_SIZE) {
                 firstBlock++;
             }
-            if (c % STRONG_REDUCE_NUM == 0) { // Do strong reduction every some blocks
+            if (strongReduce) { // Do strong reduction every some blocks
                 while (firstBlock <= lastBlock && allBlockCellsLarger(blocks[firstBlock], k)) {
                     firstBlock++;
                 }
@@ -643,14 +3597,8 @@ static int myersCalcEditDistanceSemiGlobal(
 
         // If band stops to exist finish
         if (lastBlock < firstBlock) {
-            *bestScore_ = bestScore;
-            if (bestScore != -1) {
-                *positions_ = static_cast<int *>(malloc(sizeof(int) * static_cast<int>(positions.size())));
-                *numPositions_ = static_cast<int>(positions.size());
-                copy(positions.begin(), positions.end(), *positions_);
-            }
-            delete[] blocks;
-            return EDLIB_STATUS_OK;
+            bandExists = false;
+            break;
         }
         //------------------------------------------------------------------//
 
@@ -659,7 +3607,11 @@ static int myersCalcEditDistanceSemiGlobal(
             int colScore = blocks[bl].score;
             if (colScore <= k) { // Scores > k dont have correct values (so we cannot use them), but are certainly > k.
                 // NOTE: Score that I find in column c is actually score from column c-W
-                if (bestScore == -1 || colScore <= bestScore) {
+                if (scores_) {  // k stays same, since all scores up to it are needed.
+                    positions.push_back(c - W);
+                    scores_->push_back(colScore);
+                    if (bestScore == -1 || colScore < bestScore) bestScore = colScore;
+                } else if (bestScore == -1 || colScore <= bestScore) {
                     if (colScore != bestScore) {
                         positions.clear();
                         bestScore = colScore;
@@ -676,30 +3628,90 @@ static int myersCalcEditDistanceSemiGlobal(
         targetChar++;
     }
 
+    state->firstBlock = firstBlock;
+    state->lastBlock = lastBlock;
+    state->k = k;
+    state->bestScore = bestScore;
+    state->strongReducePhase = (strongReducePhase + targetLength) % STRONG_REDUCE_NUM;
+    return bandExists;
+}
 
-    // Obtain results for last W columns from last column.
-    if (lastBlock == maxNumBlocks - 1) {
-        std::array<int, WORD_SIZE> blockScores = getBlockCellValues(blocks[bl]);
+/**
+ * Once all columns of semi-global alignment are calculated, obtains results for last W positions of target
+ * from the last column.
+ * @param [in] W  Size of padding in last block.
+ * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
+ * @param [in] endPosition  Position right after the last position of target, to which added positions are relative.
+ * @param [in,out] state
+ * @param [in,out] positions  See calcSemiGlobalColumns().
+ * @param [in,out] scores  See calcSemiGlobalColumns().
+ */
+template <typename Word, int WORD_SIZE>
+static void finishSemiGlobal(const int W, const int maxNumBlocks, const int endPosition,
+                             SemiGlobalState<Word>* const state,
+                             vector<int>* const positions_, vector<int>* const scores_) {
+    vector<int>& positions = *positions_;
+    if (state->lastBlock == maxNumBlocks - 1) {
+        std::array<int, WORD_SIZE> blockScores = getBlockCellValues(state->blocks[state->lastBlock]);
         for (int i = 0; i < W; i++) {
             int colScore = blockScores[i + 1];
-            if (colScore <= k && (bestScore == -1 || colScore <= bestScore)) {
-                if (colScore != bestScore) {
+            if (scores_ && colScore <= state->k) {
+                positions.push_back(endPosition - W + i);
+                scores_->push_back(colScore);
+                if (state->bestScore == -1 || colScore < state->bestScore) state->bestScore = colScore;
+            } else if (colScore <= state->k && (state->bestScore == -1 || colScore <= state->bestScore)) {
+                if (colScore != state->bestScore) {
                     positions.clear();
-                    k = bestScore = colScore;
+                    state->k = state->bestScore = colScore;
                 }
-                positions.push_back(targetLength - W + i);
+                positions.push_back(endPosition - W + i);
             }
         }
     }
+}
 
-    *bestScore_ = bestScore;
-    if (bestScore != -1) {
-        *positions_ = static_cast<int *>(malloc(sizeof(int) * static_cast<int>(positions.size())));
-        *numPositions_ = static_cast<int>(positions.size());
-        copy(positions.begin(), positions.end(), *positions_);
+/**
+ * Uses Myers' bit-vector algorithm to find edit distance for one of semi-global alignment methods.
+ * @param [in] Peq  Query profile.
+ * @param [in] W  Size of padding in last block.
+ *                TODO: Calculate this directly from query, instead of passing it.
+ * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
+ *                           TODO: Calculate this directly from query, instead of passing it.
+ * @param [in] queryLength
+ * @param [in] target
+ * @param [in] targetLength
+ * @param [in] k
+ * @param [in] mode  EDLIB_MODE_HW or EDLIB_MODE_SHW
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [out] bestScore_  Edit distance.
+ * @param [out] positions_  0-indexed positions in target at which best score was found.
+ *                          Empty if best score was not found.
+ * @param [out] scores_  If NULL, only positions with best score are found.
+ *                       Otherwise, all positions with score of at most k are found, in increasing order,
+ *                       and their scores are stored in it.
+ * @param [in,out] counters  Calculated blocks are counted in it, if it is not NULL.
+ * @return Status.
+ */
+template <typename Word, int WORD_SIZE>
+static int myersCalcEditDistanceSemiGlobal(
+        const Word* const Peq, const int W, const int maxNumBlocks,
+        const int queryLength,
+        const unsigned char* const target, const int targetLength,
+        const int k, const EdlibAlignMode mode, Arena& arena,
+        int* const bestScore_, vector<int>* const positions_, vector<int>* const scores_,
+        WorkCounters* const counters) {
+    ArenaScope arenaScope(arena);
+    positions_->clear();
+    if (scores_) scores_->clear();
+
+    SemiGlobalState<Word> state;
+    initSemiGlobalState(maxNumBlocks, queryLength, k, arena.allocate<Block<Word> >(maxNumBlocks), &state);
+    if (calcSemiGlobalColumns(Peq, W, maxNumBlocks, target, targetLength, mode, &state, positions_, scores_,
+                              counters)) {
+        finishSemiGlobal(W, maxNumBlocks, targetLength, &state, positions_, scores_);
     }
 
-    delete[] blocks;
+    *bestScore_ = state.bestScore;
     return EDLIB_STATUS_OK;
 }
 
@@ -715,24 +3727,34 @@ static int myersCalcEditDistanceSemiGlobal(
  * @param [in] target
  * @param [in] targetLength
  * @param [in] k
+ * @param [in] arena  Temporary memory is allocated from it.
  * @param [out] bestScore_  Edit distance.
  * @param [out] position_  0-indexed position in target at which best score was found.
- * @param [in] findAlignment  If true, whole matrix is remembered and alignment data is returned.
- *                            Quadratic amount of memory is consumed.
+ * @param [in] findAlignment  If true, whole band is remembered and alignment data is returned.
+ *                            Amount of memory proportional to area of band is consumed.
  * @param [out] alignData  Data needed for alignment traceback (for reconstruction of alignment).
- *                         Set only if findAlignment is set to true, otherwise it is NULL.
- *                         Make sure to free this array using delete[].
+ *                         Used only if findAlignment is set to true or targetStopPosition is set,
+ *                         in which case it has to be created for targetLength columns of
+ *                         getMaxNumBandBlocks() blocks each, or for 1 column of maxNumBlocks blocks, respectively.
+ *                         Otherwise it can be NULL.
  * @param [out] targetStopPosition  If set to -1, whole calculation is performed normally, as expected.
  *         If set to p, calculation is performed up to position p in target (inclusive)
  *         and column p is returned as the only column in alignData.
+ * @param [in,out] checkpoints  If not NULL and findAlignment is false, checkpoint columns are saved into it.
+ *         If not NULL and findAlignment is true, only columns of matrix that fit into alignData are calculated
+ *         and stored, starting with column alignData->firstColumn, which has to be 0 or a checkpoint.
+ *         Calculation then starts from that checkpoint instead of from the beginning.
+ * @param [in,out] counters  Calculated blocks are counted in it, if it is not NULL.
  * @return Status.
  */
+template <typename Word, int WORD_SIZE>
 static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int maxNumBlocks,
                                    const int queryLength,
                                    const unsigned char* const target, const int targetLength,
-                                   int k, int* const bestScore_,
+                                   int k, Arena& arena, int* const bestScore_,
                                    int* const position_, const bool findAlignment,
-                                   AlignmentData** const alignData, const int targetStopPosition) {
+                                   AlignmentData<Word>* const alignData, const int targetStopPosition,
+                                   NWCheckpoints<Word>* const checkpoints, WorkCounters* const counters) {
     if (targetStopPosition > -1 && findAlignment) {
         // They can not be both set at the same time!
         return EDLIB_STATUS_ERROR;
@@ -752,8 +3774,12 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
     // lastBlock is 0-based index of last block in Ukkonen band.
     int firstBlock = 0;
     // This is optimal now, by my formula.
-    int lastBlock = min(maxNumBlocks, ceilDiv(min(k, (k + queryLength - targetLength) / 2) + 1, WORD_SIZE)) - 1;
-    Block* blocks = new Block[maxNumBlocks];
+    // Calculated in 64 bits, since k and lengths can be close to INT_MAX.
+    int lastBlock = min(static_cast<long long>(maxNumBlocks),
+                        min(static_cast<long long>(k), (static_cast<long long>(k) + queryLength - targetLength) / 2)
+                        / WORD_SIZE + 1) - 1;
+    ArenaScope arenaScope(arena);
+    Block<Word>* blocks = arena.allocate<Block<Word> >(maxNumBlocks);
 
     // Initialize P, M and score
     for (int b = 0; b <= lastBlock; b++) {
@@ -762,36 +3788,48 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
         blocks[b].M = static_cast<Word>(0);
     }
 
-    // If we want to find alignment, we have to store needed data.
-    if (findAlignment)
-        *alignData = new AlignmentData(maxNumBlocks, targetLength);
-    else if (targetStopPosition > -1)
-        *alignData = new AlignmentData(maxNumBlocks, 1);
-    else
-        *alignData = NULL;
+    // If only part of matrix is calculated, start with checkpoint that is its first column.
+    int firstColumn = 0;
+    int lastColumn = targetLength - 1;
+    if (findAlignment && checkpoints) {
+        firstColumn = alignData->firstColumn;
+        lastColumn = min(lastColumn, firstColumn + alignData->columnCapacity - 1);
+        if (firstColumn > 0) {
+            const int checkpoint = (firstColumn + 1) / checkpoints->interval - 1;
+            k = checkpoints->ks[checkpoint];
+            firstBlock = checkpoints->columns.firstBlocks[checkpoint];
+            lastBlock = checkpoints->columns.lastBlocks[checkpoint];
+            checkpoints->columns.loadColumn(checkpoint, blocks);
+            if (alignData->saveColumn(0, blocks, firstBlock, lastBlock) != EDLIB_STATUS_OK) {
+                return EDLIB_STATUS_ERROR;
+            }
+            firstColumn++;
+        }
+    }
 
     int bl = 0; // Current block index
-    const unsigned char* targetChar = target;
-    for (int c = 0; c < targetLength; c++) { // for each column
+    const SimdLevel simdLevel = getSimdLevel();
+    BlockCounter blockCounter(counters);
+    const unsigned char* targetChar = target + firstColumn;
+    for (int c = firstColumn; c <= lastColumn; c++) { // for each column
         const Word* Peq_c = Peq + *targetChar * maxNumBlocks;
 
         //----------------------- Calculate column -------------------------//
-        int hout = 1;
-        bl = firstBlock;
-        for (int b = firstBlock; b <= lastBlock; b++) {
-            hout = calculateBlock(blocks[bl].P, blocks[bl].M, Peq_c[b], hout, blocks[bl].P, blocks[bl].M);
-            blocks[bl].score += hout;
-            bl++;
-        }
-        bl--;
+        int hout = calculateBlocks(blocks, Peq_c, firstBlock, lastBlock, 1, simdLevel);
+        blockCounter.addColumn(firstBlock, lastBlock);
+        bl = lastBlock;
         //------------------------------------------------------------------//
         // bl now points to last block
 
+        // Band conditions below are calculated in 64 bits, starting with diagonal shift of this column,
+        // since scores, k and lengths can all be close to INT_MAX.
+        const long long diagonalShift = static_cast<long long>(queryLength) - targetLength + c;
+
         // Update k. I do it only on end of column because it would slow calculation too much otherwise.
         // NOTICE: I add W when in last block because it is actually result from W cells to the left and W cells up.
-        k = min(k, blocks[bl].score
-                + max(targetLength - c - 1, queryLength - ((1 + lastBlock) * WORD_SIZE - 1) - 1)
-                + (lastBlock == maxNumBlocks - 1 ? W : 0));
+        k = static_cast<int>(min(static_cast<long long>(k), static_cast<long long>(blocks[bl].score)
+                                 + max(targetLength - c - 1, queryLength - ((1 + lastBlock) * WORD_SIZE - 1) - 1)
+                                 + (lastBlock == maxNumBlocks - 1 ? W : 0)));
 
         //---------- Adjust number of blocks according to Ukkonen ----------//
         //--- Adjust last block ---//
@@ -799,7 +3837,7 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
         if (lastBlock + 1 < maxNumBlocks
             && !(//score[lastBlock] >= k + WORD_SIZE ||  // NOTICE: this condition could be satisfied if above block also!
                  ((lastBlock + 1) * WORD_SIZE - 1
-                  > k - blocks[bl].score + 2 * WORD_SIZE - 2 - targetLength + c + queryLength))) {
+                  > diagonalShift + k - blocks[bl].score + 2 * WORD_SIZE - 2))) {
             lastBlock++; bl++;
             blocks[bl].P = static_cast<Word>(-1); // All 1s
             blocks[bl].M = static_cast<Word>(0);
@@ -812,10 +3850,10 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
         // NOTE: Condition used here is more loose than the one from the article, since I simplified the max() part of it.
         // I could consider adding that max part, for optimal performance.
         while (lastBlock >= firstBlock
-               && (blocks[bl].score >= k + WORD_SIZE
+               && (blocks[bl].score - WORD_SIZE >= k
                    || ((lastBlock + 1) * WORD_SIZE - 1 >
                        // TODO: Does not work if do not put +1! Why???
-                       k - blocks[bl].score + 2 * WORD_SIZE - 2 - targetLength + c + queryLength + 1))) {
+                       diagonalShift + k - blocks[bl].score + 2 * WORD_SIZE - 2 + 1))) {
             lastBlock--; bl--;
         }
         //-------------------------//
@@ -823,9 +3861,9 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
         //--- Adjust first block ---//
         // While outside of band, advance block
         while (firstBlock <= lastBlock
-               && (blocks[firstBlock].score >= k + WORD_SIZE
+               && (blocks[firstBlock].score - WORD_SIZE >= k
                    || ((firstBlock + 1) * WORD_SIZE - 1 <
-                       blocks[firstBlock].score - k - targetLength + queryLength + c))) {
+                       diagonalShift + blocks[firstBlock].score - k))) {
             firstBlock++;
         }
         //--------------------------/
@@ -841,7 +3879,7 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
                 bool reduce = true;
                 for (int i = WORD_SIZE - numCells; i < WORD_SIZE; i++) {
                     // TODO: Does not work if do not put +1! Why???
-                    if (scores[i] <= k && r <= k - scores[i] - targetLength + c + queryLength + 1) {
+                    if (scores[i] <= k && r <= diagonalShift + k - scores[i] + 1) {
                         reduce = false;
                         break;
                     }
@@ -858,7 +3896,7 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
                 int r = firstBlock * WORD_SIZE + numCells - 1;
                 bool reduce = true;
                 for (int i = WORD_SIZE - numCells; i < WORD_SIZE; i++) {
-                    if (scores[i] <= k && r >= scores[i] - k - targetLength + c + queryLength) {
+                    if (scores[i] <= k && r >= diagonalShift + scores[i] - k) {
                         reduce = false;
                         break;
                     }
@@ -873,37 +3911,32 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
         // If band stops to exist finish
         if (lastBlock < firstBlock) {
             *bestScore_ = *position_ = -1;
-            delete[] blocks;
             return EDLIB_STATUS_OK;
         }
         //------------------------------------------------------------------//
 
 
         //---- Save column so it can be used for reconstruction ----//
-        if (findAlignment && c < targetLength) {
-            bl = firstBlock;
-            for (int b = firstBlock; b <= lastBlock; b++) {
-                (*alignData)->Ps[maxNumBlocks * c + b] = blocks[bl].P;
-                (*alignData)->Ms[maxNumBlocks * c + b] = blocks[bl].M;
-                (*alignData)->scores[maxNumBlocks * c + b] = blocks[bl].score;
-                bl++;
+        if (findAlignment) {
+            if (alignData->saveColumn(c - alignData->firstColumn, blocks, firstBlock, lastBlock) != EDLIB_STATUS_OK) {
+                return EDLIB_STATUS_ERROR;
+            }
+        } else if (checkpoints && (c + 1) % checkpoints->interval == 0
+                   && (c + 1) / checkpoints->interval <= checkpoints->numCheckpoints) {
+            const int checkpoint = (c + 1) / checkpoints->interval - 1;
+            if (checkpoints->columns.saveColumn(checkpoint, blocks, firstBlock, lastBlock) != EDLIB_STATUS_OK) {
+                return EDLIB_STATUS_ERROR;
             }
-            (*alignData)->firstBlocks[c] = firstBlock;
-            (*alignData)->lastBlocks[c] = lastBlock;
+            checkpoints->ks[checkpoint] = k;
         }
         //----------------------------------------------------------//
         //---- If this is stop column, save it and finish ----//
         if (c == targetStopPosition) {
-            for (int b = firstBlock; b <= lastBlock; b++) {
-                (*alignData)->Ps[b] = (blocks + b)->P;
-                (*alignData)->Ms[b] = (blocks + b)->M;
-                (*alignData)->scores[b] = (blocks + b)->score;
+            if (alignData->saveColumn(0, blocks, firstBlock, lastBlock) != EDLIB_STATUS_OK) {
+                return EDLIB_STATUS_ERROR;
             }
-            (*alignData)->firstBlocks[0] = firstBlock;
-            (*alignData)->lastBlocks[0] = lastBlock;
             *bestScore_ = -1;
             *position_ = targetStopPosition;
-            delete[] blocks;
             return EDLIB_STATUS_OK;
         }
         //----------------------------------------------------//
@@ -911,59 +3944,356 @@ static int myersCalcEditDistanceNW(const Word* const Peq, const int W, const int
         targetChar++;
     }
 
+    if (lastColumn < targetLength - 1) {  // If only part of matrix was calculated
+        *bestScore_ = *position_ = -1;
+        return EDLIB_STATUS_OK;
+    }
+
     if (lastBlock == maxNumBlocks - 1) { // If last block of last column was calculated
         // Obtain best score from block -> it is complicated because query is padded with W cells
         int bestScore = getBlockCellValues(blocks[lastBlock])[W];
         if (bestScore <= k) {
             *bestScore_ = bestScore;
             *position_ = targetLength - 1;
-            delete[] blocks;
             return EDLIB_STATUS_OK;
         }
     }
 
     *bestScore_ = *position_ = -1;
-    delete[] blocks;
     return EDLIB_STATUS_OK;
 }
 
 
+#ifdef EDLIB_X86_SIMD
+/*
+ * Multi-target kernels.
+ * When query is short, column has just a few blocks and multi-block kernels can not be used.
+ * Instead, we align query against multiple targets at once, each target in its own SIMD lane.
+ * Lanes are written using GCC vector extensions, so same code is compiled for AVX2 and AVX-512,
+ * and for both sizes of words: with 32-bit words there is twice as many lanes.
+ */
+typedef uint64_t Lanes4x64 __attribute__((vector_size(32)));
+typedef uint64_t Lanes8x64 __attribute__((vector_size(64)));
+typedef uint32_t Lanes8x32 __attribute__((vector_size(32)));
+typedef uint32_t Lanes16x32 __attribute__((vector_size(64)));
+
+/**
+ * Uses Myers' bit-vector algorithm to find edit distance of query against up to L targets at once,
+ * each target being in its own lane.
+ * Unlike myersCalcEditDistanceSemiGlobal() and myersCalcEditDistanceNW(), there is no banding:
+ * all blocks of each column are calculated. That is why it should be used only for short queries,
+ * where band covers most of the column anyway.
+ * Results are same as those that myersCalcEditDistanceSemiGlobal() or myersCalcEditDistanceNW() would give
+ * for each target, with k being auto-adjusted if not given.
+ * @param [in] Peq  Query profile.
+ * @param [in] W  Size of padding in last block.
+ * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
+ * @param [in] queryLength
+ * @param [in] targets  Transformed targets, none of them empty, sorted by length in descending order.
+ * @param [in] targetLengths
+ * @param [in] numTargets  Number of targets, at most L.
+ * @param [in] k  If negative, it is not limited.
+ * @param [in] mode
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [out] bestScores_  Edit distance for each target, -1 if it is larger than k.
+ * @param [out] positions_  For each target, 0-indexed positions in target at which best score was found.
+ *                          Not set if mode is EDLIB_MODE_NW.
+ */
+template <typename Lanes, int L, typename Word, int WORD_SIZE = sizeof(Word) * 8>
+__attribute__((always_inline))
+static inline void myersCalcEditDistanceLanesImpl(
+        const Word* const Peq, const int W, const int maxNumBlocks,
+        const int queryLength,
+        const unsigned char* const* const targets, const int* const targetLengths, const int numTargets,
+        const int k, const EdlibAlignMode mode, Arena& arena,
+        int* const bestScores_, vector<int>* const positions_) {
+    ArenaScope arenaScope(arena);
+    // P and M of block b in lane l are at [b * L + l].
+    const size_t numWords = static_cast<size_t>(maxNumBlocks) * L;
+    Word* const Ps = arena.allocate<Word>(numWords);
+    Word* const Ms = arena.allocate<Word>(numWords);
+    fill(Ps, Ps + numWords, static_cast<Word>(-1)); // All 1s
+    fill(Ms, Ms + numWords, static_cast<Word>(0));
+    const Lanes startHout = Lanes{} + static_cast<Word>(mode == EDLIB_MODE_HW ? 0 : 1);
+    Lanes scores = Lanes{} + static_cast<Word>(maxNumBlocks * WORD_SIZE);  // Score of last block.
+
+    // Best score is looked for only among scores <= ks[l]. Lanes of targets that
+    // were already finished get all 1s, so that they never satisfy that condition.
+    int laneK[L];
+    Lanes ks = Lanes{};
+    const Word* Peq_c[L];
+    for (int l = 0; l < L; l++) {
+        laneK[l] = k < 0 ? max(queryLength, targetLengths[0]) : k;  // Edit distance is never larger.
+        if (mode == EDLIB_MODE_HW) {
+            laneK[l] = min(queryLength, laneK[l]);
+        }
+        ks[l] = l < numTargets ? static_cast<Word>(laneK[l]) : static_cast<Word>(-1);
+        Peq_c[l] = Peq;
+        if (l < numTargets) {
+            bestScores_[l] = -1;
+            positions_[l].clear();
+        }
+    }
+
+    int numActive = numTargets;  // Targets [0, numActive) are not yet finished.
+    for (int c = 0; numActive > 0; c++) { // for each column
+        for (int l = 0; l < numActive; l++) {
+            Peq_c[l] = Peq + targets[l][c] * maxNumBlocks;
+        }
+
+        //----------------------- Calculate column -------------------------//
+        Lanes hin = startHout;
+        for (int b = 0; b < maxNumBlocks; b++) {
+            Lanes Pv, Mv, Eq;
+            Word eqs[L];
+            for (int l = 0; l < L; l++) {
+                eqs[l] = Peq_c[l][b];
+            }
+            memcpy(&Pv, &Ps[b * L], sizeof(Lanes));
+            memcpy(&Mv, &Ms[b * L], sizeof(Lanes));
+            memcpy(&Eq, eqs, sizeof(Lanes));
+
+            // Same as calculateBlock(), for each lane.
+            const Lanes hinIsNeg = hin >> (WORD_SIZE - 1);
+            const Lanes hinIsPos = (hin + static_cast<Word>(1)) >> 1;
+            const Lanes Xv = Eq | Mv;
+            Eq |= hinIsNeg;
+            const Lanes Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+            Lanes Ph = Mv | ~(Xh | Pv);
+            Lanes Mh = Pv & Xh;
+            hin = (Ph >> (WORD_SIZE - 1)) - (Mh >> (WORD_SIZE - 1));
+            Ph = (Ph << 1) | hinIsPos;
+            Mh = (Mh << 1) | hinIsNeg;
+            const Lanes PvOut = Mh | ~(Xv | Ph);
+            const Lanes MvOut = Ph & Xv;
+            memcpy(&Ps[b * L], &PvOut, sizeof(Lanes));
+            memcpy(&Ms[b * L], &MvOut, sizeof(Lanes));
+        }
+        scores += hin;
+        //------------------------------------------------------------------//
+
+        //------------------------- Update best score ----------------------//
+        if (mode != EDLIB_MODE_NW) {
+            // Top bit is set for lanes where score > k (scores and k are small enough for that to be correct).
+            const Lanes larger = ks - scores;
+            Word allLarger = static_cast<Word>(1) << (WORD_SIZE - 1);
+            for (int l = 0; l < L; l++) {
+                allLarger &= larger[l];
+            }
+            if (!allLarger) {
+                for (int l = 0; l < numActive; l++) {
+                    const int colScore = static_cast<int>(scores[l]);
+                    if (colScore <= laneK[l]) {
+                        // NOTE: Score that I find in column c is actually score from column c-W
+                        if (bestScores_[l] == -1 || colScore <= bestScores_[l]) {
+                            if (colScore != bestScores_[l]) {
+                                positions_[l].clear();
+                                bestScores_[l] = colScore;
+                                laneK[l] = colScore;
+                                ks[l] = static_cast<Word>(colScore);
+                            }
+                            positions_[l].push_back(c - W);
+                        }
+                    }
+                }
+            }
+        }
+        //------------------------------------------------------------------//
+
+        //---------------------- Finish ended targets ----------------------//
+        while (numActive > 0 && targetLengths[numActive - 1] == c + 1) {
+            const int l = --numActive;
+            const Block<Word> lastBlock(Ps[(maxNumBlocks - 1) * L + l], Ms[(maxNumBlocks - 1) * L + l],
+                                  static_cast<int>(scores[l]));
+            std::array<int, WORD_SIZE> blockScores = getBlockCellValues(lastBlock);
+            if (mode == EDLIB_MODE_NW) {
+                bestScores_[l] = blockScores[W] <= laneK[l] ? blockScores[W] : -1;
+            } else {
+                // Obtain results for last W columns from last column.
+                for (int i = 0; i < W; i++) {
+                    const int colScore = blockScores[i + 1];
+                    if (colScore <= laneK[l] && (bestScores_[l] == -1 || colScore <= bestScores_[l])) {
+                        if (colScore != bestScores_[l]) {
+                            positions_[l].clear();
+                            laneK[l] = bestScores_[l] = colScore;
+                        }
+                        positions_[l].push_back(targetLengths[l] - W + i);
+                    }
+                }
+            }
+            ks[l] = static_cast<Word>(-1);
+        }
+        //------------------------------------------------------------------//
+    }
+}
+
+__attribute__((target("avx2")))
+static void myersCalcEditDistanceLanesAvx2(
+        const uint64_t* const Peq, const int W, const int maxNumBlocks, const int queryLength,
+        const unsigned char* const* const targets, const int* const targetLengths, const int numTargets,
+        const int k, const EdlibAlignMode mode, Arena& arena,
+        int* const bestScores_, vector<int>* const positions_) {
+    myersCalcEditDistanceLanesImpl<Lanes4x64, 4>(Peq, W, maxNumBlocks, queryLength, targets, targetLengths,
+                                                 numTargets, k, mode, arena, bestScores_, positions_);
+}
+
+__attribute__((target("avx2")))
+static void myersCalcEditDistanceLanesAvx2(
+        const uint32_t* const Peq, const int W, const int maxNumBlocks, const int queryLength,
+        const unsigned char* const* const targets, const int* const targetLengths, const int numTargets,
+        const int k, const EdlibAlignMode mode, Arena& arena,
+        int* const bestScores_, vector<int>* const positions_) {
+    myersCalcEditDistanceLanesImpl<Lanes8x32, 8>(Peq, W, maxNumBlocks, queryLength, targets, targetLengths,
+                                                 numTargets, k, mode, arena, bestScores_, positions_);
+}
+
+__attribute__((target("avx512f")))
+static void myersCalcEditDistanceLanesAvx512(
+        const uint64_t* const Peq, const int W, const int maxNumBlocks, const int queryLength,
+        const unsigned char* const* const targets, const int* const targetLengths, const int numTargets,
+        const int k, const EdlibAlignMode mode, Arena& arena,
+        int* const bestScores_, vector<int>* const positions_) {
+    myersCalcEditDistanceLanesImpl<Lanes8x64, 8>(Peq, W, maxNumBlocks, queryLength, targets, targetLengths,
+                                                 numTargets, k, mode, arena, bestScores_, positions_);
+}
+
+__attribute__((target("avx512f")))
+static void myersCalcEditDistanceLanesAvx512(
+        const uint32_t* const Peq, const int W, const int maxNumBlocks, const int queryLength,
+        const unsigned char* const* const targets, const int* const targetLengths, const int numTargets,
+        const int k, const EdlibAlignMode mode, Arena& arena,
+        int* const bestScores_, vector<int>* const positions_) {
+    myersCalcEditDistanceLanesImpl<Lanes16x32, 16>(Peq, W, maxNumBlocks, queryLength, targets, targetLengths,
+                                                   numTargets, k, mode, arena, bestScores_, positions_);
+}
+
+/**
+ * Aligns query against multiple targets at once, see myersCalcEditDistanceLanesImpl().
+ * @param [in] numLanes  Obtained with getNumLanes(), must be larger than 1.
+ */
+template <typename Word, int WORD_SIZE>
+static void myersCalcEditDistanceLanes(
+        const Word* const Peq, const int W, const int maxNumBlocks, const int queryLength,
+        const unsigned char* const* const targets, const int* const targetLengths, const int numTargets,
+        const int k, const EdlibAlignMode mode, const int numLanes, Arena& arena,
+        int* const bestScores_, vector<int>* const positions_) {
+    if (numLanes == 512 / WORD_SIZE) {
+        myersCalcEditDistanceLanesAvx512(Peq, W, maxNumBlocks, queryLength, targets, targetLengths, numTargets,
+                                         k, mode, arena, bestScores_, positions_);
+    } else {
+        myersCalcEditDistanceLanesAvx2(Peq, W, maxNumBlocks, queryLength, targets, targetLengths, numTargets,
+                                       k, mode, arena, bestScores_, positions_);
+    }
+}
+#endif
+
+/**
+ * @param [in] maxNumBlocks  Number of blocks needed to cover the whole query.
+ * @param [in] k  Maximal edit distance, negative if not given.
+ * @param [in] mode
+ * @return Number of targets that should be aligned at once with myersCalcEditDistanceLanes(),
+ *         or 1 if targets should be aligned one by one.
+ */
+template <typename Word, int WORD_SIZE>
+static int getNumLanes(const int maxNumBlocks, const int k, const EdlibAlignMode mode) {
+    // Multi-target kernel calculates whole columns, so if band is much narrower than column
+    // it is better to align targets one by one.
+    const int MAX_LANES_NUM_BLOCKS = 32;
+    if (maxNumBlocks > MAX_LANES_NUM_BLOCKS || (k >= 0 && maxNumBlocks > 2 * (k / WORD_SIZE + 1))) {
+        return 1;
+    }
+    // If k is not given, in NW and SHW targets aligned one by one start with a narrow band that is
+    // often enough for similar sequences, so whole columns pay off only while there are just a few blocks.
+    // In HW band is not narrowed that way, so there is no such limit.
+    const int MAX_LANES_AUTO_K_NUM_BLOCKS = 16;
+    if (k < 0 && mode != EDLIB_MODE_HW && maxNumBlocks > MAX_LANES_AUTO_K_NUM_BLOCKS) {
+        return 1;
+    }
+    switch (getSimdLevel()) {
+    case SIMD_AVX512: return 512 / WORD_SIZE;
+    case SIMD_AVX2: return 256 / WORD_SIZE;
+    default: return 1;
+    }
+}
+
+/**
+ * Calculates segments of dynamic programming matrix of global alignment again, starting from checkpoints,
+ * so that traceback has to store only one segment at a time instead of the whole band.
+ * Segment i consists of columns from checkpoint i - 1 to checkpoint i, with first segment starting
+ * with column 0 and last one ending with last column.
+ */
+template <typename Word>
+struct TracebackSegments {
+    const Word* Peq;
+    int W;
+    int maxNumBlocks;
+    int queryLength;
+    const unsigned char* target;
+    int targetLength;
+    int bestScore;
+    NWCheckpoints<Word>* checkpoints;
+    AlignmentData<Word>* segment;  // Has room for interval + 1 columns.
+    Arena* arena;
+    WorkCounters* counters;
+
+    /**
+     * Calculates segment that contains both column c and column c - 1 into segment.
+     * @return Status code.
+     */
+    int load(const int c) {
+        const int interval = checkpoints->interval;
+        const int i = min(ceilDiv(c + 1, interval) - 1, checkpoints->numCheckpoints);
+        segment->firstColumn = i == 0 ? 0 : i * interval - 1;
+        int score_, endLocation_;  // Used only to call function.
+        return myersCalcEditDistanceNW(Peq, W, maxNumBlocks, queryLength, target, targetLength, bestScore, *arena,
+                                       &score_, &endLocation_, true, segment, -1, checkpoints, counters);
+    }
+};
+
 /**
  * Finds one possible alignment that gives optimal score by moving back through the dynamic programming matrix,
- * that is stored in alignData. Consumes large amount of memory: O(queryLength * targetLength).
+ * that is stored in alignData. Consumes amount of memory proportional to area of band: O(k * targetLength),
+ * unless matrix is calculated again in segments.
  * @param [in] queryLength  Normal length, without W.
  * @param [in] targetLength  Normal length, without W.
  * @param [in] bestScore  Best score.
  * @param [in] alignData  Data obtained during finding best score that is useful for finding alignment.
- * @param [out] alignment  Alignment.
+ * @param [in] segments  If not NULL, alignData holds only one segment of matrix at a time,
+ *                       and segments are calculated into it as traceback moves through them.
+ * @param [out] alignment  Alignment. Must have size of at least queryLength + targetLength.
  * @param [out] alignmentLength  Length of alignment.
  * @return Status code.
  */
+template <typename Word, int WORD_SIZE>
 static int obtainAlignmentTraceback(const int queryLength, const int targetLength,
-                                    const int bestScore, const AlignmentData* const alignData,
-                                    unsigned char** const alignment, int* const alignmentLength) {
+                                    const int bestScore, const AlignmentData<Word>* const alignData,
+                                    TracebackSegments<Word>* const segments,
+                                    unsigned char* const alignment, int* const alignmentLength) {
     const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
     const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    const Word HIGH_BIT_MASK = static_cast<Word>(1) << (WORD_SIZE - 1);  // 100..00
 
-    *alignment = static_cast<unsigned char*>(malloc((queryLength + targetLength - 1) * sizeof(unsigned char)));
     *alignmentLength = 0;
     int c = targetLength - 1; // index of column
+    if (segments && segments->load(c) != EDLIB_STATUS_OK) {
+        return EDLIB_STATUS_ERROR;
+    }
     int b = maxNumBlocks - 1; // index of block in column
     int currScore = bestScore; // Score of current cell
     int lScore  = -1; // Score of left cell
     int uScore  = -1; // Score of upper cell
     int ulScore = -1; // Score of upper left cell
-    Word currP = alignData->Ps[c * maxNumBlocks + b]; // P of current block
-    Word currM = alignData->Ms[c * maxNumBlocks + b]; // M of current block
+    Word currP = alignData->Ps[alignData->index(c, b)]; // P of current block
+    Word currM = alignData->Ms[alignData->index(c, b)]; // M of current block
     // True if block to left exists and is in band
-    bool thereIsLeftBlock = c > 0 && b >= alignData->firstBlocks[c-1] && b <= alignData->lastBlocks[c-1];
+    bool thereIsLeftBlock = c > 0 && alignData->inBand(c - 1, b);
     // We set initial values of lP and lM to 0 only to avoid compiler warnings, they should not affect the
     // calculation as both lP and lM should be initialized at some moment later (but compiler can not
     // detect it since this initialization is guaranteed by "business" logic).
     Word lP = 0, lM = 0;
     if (thereIsLeftBlock) {
-        lP = alignData->Ps[(c - 1) * maxNumBlocks + b]; // P of block to the left
-        lM = alignData->Ms[(c - 1) * maxNumBlocks + b]; // M of block to the left
+        lP = alignData->Ps[alignData->index(c - 1, b)]; // P of block to the left
+        lM = alignData->Ms[alignData->index(c - 1, b)]; // M of block to the left
     }
     currP <<= W;
     currM <<= W;
@@ -984,7 +4314,7 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
         //       there is no need to calculate left and upper left cell
         //---------- Calculate scores ---------//
         if (lScore == -1 && thereIsLeftBlock) {
-            lScore = alignData->scores[(c - 1) * maxNumBlocks + b]; // score of block to the left
+            lScore = alignData->scores[alignData->index(c - 1, b)]; // score of block to the left
             for (int i = 0; i < WORD_SIZE - blockPos - 1; i++) {
                 if (lP & HIGH_BIT_MASK) lScore--;
                 if (lM & HIGH_BIT_MASK) lScore++;
@@ -998,10 +4328,10 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
                 if (lP & HIGH_BIT_MASK) ulScore--;
                 if (lM & HIGH_BIT_MASK) ulScore++;
             }
-            else if (c > 0 && b-1 >= alignData->firstBlocks[c-1] && b-1 <= alignData->lastBlocks[c-1]) {
+            else if (c > 0 && alignData->inBand(c - 1, b - 1)) {
                 // This is the case when upper left cell is last cell in block,
                 // and block to left is not in band so lScore is -1.
-                ulScore = alignData->scores[(c - 1) * maxNumBlocks + b - 1];
+                ulScore = alignData->scores[alignData->index(c - 1, b - 1)];
             }
         }
         if (uScore == -1) {
@@ -1023,19 +4353,19 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
             uScore = ulScore = -1;
             if (blockPos == 0) { // If entering new (upper) block
                 if (b == 0) { // If there are no cells above (only boundary cells)
-                    (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_INSERT; // Move up
+                    alignment[(*alignmentLength)++] = EDLIB_EDOP_INSERT; // Move up
                     for (int i = 0; i < c + 1; i++) // Move left until end
-                        (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_DELETE;
+                        alignment[(*alignmentLength)++] = EDLIB_EDOP_DELETE;
                     break;
                 } else {
                     blockPos = WORD_SIZE - 1;
                     b--;
-                    currP = alignData->Ps[c * maxNumBlocks + b];
-                    currM = alignData->Ms[c * maxNumBlocks + b];
-                    if (c > 0 && b >= alignData->firstBlocks[c-1] && b <= alignData->lastBlocks[c-1]) {
+                    currP = alignData->Ps[alignData->index(c, b)];
+                    currM = alignData->Ms[alignData->index(c, b)];
+                    if (c > 0 && alignData->inBand(c - 1, b)) {
                         thereIsLeftBlock = true;
-                        lP = alignData->Ps[(c - 1) * maxNumBlocks + b]; // TODO: improve this, too many operations
-                        lM = alignData->Ms[(c - 1) * maxNumBlocks + b];
+                        lP = alignData->Ps[alignData->index(c - 1, b)]; // TODO: improve this, too many operations
+                        lM = alignData->Ms[alignData->index(c - 1, b)];
                     } else {
                         thereIsLeftBlock = false;
                         // TODO(martin): There may not be left block, but there can be left boundary - do we
@@ -1048,7 +4378,7 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
                 lM <<= 1;
             }
             // Mark move
-            (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_INSERT;
+            alignment[(*alignmentLength)++] = EDLIB_EDOP_INSERT;
         }
         // Move left - deletion from target - insertion to query
         else if (lScore != -1 && lScore + 1 == currScore) {
@@ -1057,18 +4387,21 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
             lScore = ulScore = -1;
             c--;
             if (c == -1) { // If there are no cells to the left (only boundary cells)
-                (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_DELETE; // Move left
+                alignment[(*alignmentLength)++] = EDLIB_EDOP_DELETE; // Move left
                 int numUp = b * WORD_SIZE + blockPos + 1;
                 for (int i = 0; i < numUp; i++) // Move up until end
-                    (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_INSERT;
+                    alignment[(*alignmentLength)++] = EDLIB_EDOP_INSERT;
                 break;
             }
+            if (segments && c > 0 && c - 1 < alignData->firstColumn && segments->load(c) != EDLIB_STATUS_OK) {
+                return EDLIB_STATUS_ERROR;
+            }
             currP = lP;
             currM = lM;
-            if (c > 0 && b >= alignData->firstBlocks[c-1] && b <= alignData->lastBlocks[c-1]) {
+            if (c > 0 && alignData->inBand(c - 1, b)) {
                 thereIsLeftBlock = true;
-                lP = alignData->Ps[(c - 1) * maxNumBlocks + b];
-                lM = alignData->Ms[(c - 1) * maxNumBlocks + b];
+                lP = alignData->Ps[alignData->index(c - 1, b)];
+                lM = alignData->Ms[alignData->index(c - 1, b)];
             } else {
                 if (c == 0) { // If there are no cells to the left (only boundary cells)
                     thereIsLeftBlock = true;
@@ -1079,7 +4412,7 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
                 }
             }
             // Mark move
-            (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_DELETE;
+            alignment[(*alignmentLength)++] = EDLIB_EDOP_DELETE;
         }
         // Move up left - (mis)match
         else if (ulScore != -1) {
@@ -1088,23 +4421,26 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
             uScore = lScore = ulScore = -1;
             c--;
             if (c == -1) { // If there are no cells to the left (only boundary cells)
-                (*alignment)[(*alignmentLength)++] = moveCode; // Move left
+                alignment[(*alignmentLength)++] = moveCode; // Move left
                 int numUp = b * WORD_SIZE + blockPos;
                 for (int i = 0; i < numUp; i++) // Move up until end
-                    (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_INSERT;
+                    alignment[(*alignmentLength)++] = EDLIB_EDOP_INSERT;
                 break;
             }
+            if (segments && c > 0 && c - 1 < alignData->firstColumn && segments->load(c) != EDLIB_STATUS_OK) {
+                return EDLIB_STATUS_ERROR;
+            }
             if (blockPos == 0) { // If entering upper left block
                 if (b == 0) { // If there are no more cells above (only boundary cells)
-                    (*alignment)[(*alignmentLength)++] = moveCode; // Move up left
+                    alignment[(*alignmentLength)++] = moveCode; // Move up left
                     for (int i = 0; i < c + 1; i++) // Move left until end
-                        (*alignment)[(*alignmentLength)++] = EDLIB_EDOP_DELETE;
+                        alignment[(*alignmentLength)++] = EDLIB_EDOP_DELETE;
                     break;
                 }
                 blockPos = WORD_SIZE - 1;
                 b--;
-                currP = alignData->Ps[c * maxNumBlocks + b];
-                currM = alignData->Ms[c * maxNumBlocks + b];
+                currP = alignData->Ps[alignData->index(c, b)];
+                currM = alignData->Ms[alignData->index(c, b)];
             } else { // If entering left block
                 blockPos--;
                 currP = lP;
@@ -1113,10 +4449,10 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
                 currM <<= 1;
             }
             // Set new left block
-            if (c > 0 && b >= alignData->firstBlocks[c-1] && b <= alignData->lastBlocks[c-1]) {
+            if (c > 0 && alignData->inBand(c - 1, b)) {
                 thereIsLeftBlock = true;
-                lP = alignData->Ps[(c - 1) * maxNumBlocks + b];
-                lM = alignData->Ms[(c - 1) * maxNumBlocks + b];
+                lP = alignData->Ps[alignData->index(c - 1, b)];
+                lM = alignData->Ms[alignData->index(c - 1, b)];
             } else {
                 if (c == 0) { // If there are no cells to the left (only boundary cells)
                     thereIsLeftBlock = true;
@@ -1127,7 +4463,7 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
                 }
             }
             // Mark move
-            (*alignment)[(*alignmentLength)++] = moveCode;
+            alignment[(*alignmentLength)++] = moveCode;
         } else {
             // Reached end - finished!
             break;
@@ -1135,12 +4471,22 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
         //----------------------------------//
     }
 
-    *alignment = static_cast<unsigned char*>(realloc(*alignment, (*alignmentLength) * sizeof(unsigned char)));
-    reverse(*alignment, *alignment + (*alignmentLength));
+    reverse(alignment, alignment + (*alignmentLength));
     return EDLIB_STATUS_OK;
 }
 
 
+/**
+ * @return Number of columns between checkpoints of traceback with checkpoints: ceil(sqrt(targetLength)),
+ *         so that checkpoints and one segment between them take about the same amount of memory.
+ */
+static int getCheckpointInterval(const int targetLength) {
+    int interval = static_cast<int>(std::sqrt(static_cast<double>(targetLength)));
+    while (static_cast<long long>(interval) * interval < targetLength) interval++;
+    return max(interval, 1);
+}
+
+
 /**
  * Finds one possible alignment that gives optimal score (bestScore).
  * It will split problem into smaller problems using Hirschberg's algorithm and when they are small enough,
@@ -1154,22 +4500,36 @@ static int obtainAlignmentTraceback(const int queryLength, const int targetLengt
  * @param [in] equalityDefinition
  * @param [in] alphabetLength
  * @param [in] bestScore  Best(optimal) score.
+ * @param [in] Peq  Query profile, or NULL if it should be built here.
+ * @param [in] rPeq  Profile of reversed query, or NULL if it should be built here.
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [in] numThreads  Maximal number of threads that Hirschberg's algorithm can use.
+ * @param [in] parallelCutoff  Problems with target shorter than this are solved in one thread.
+ * @param [in] tracebackMemoryBudget  Problems for which traceback needs more bytes are split further.
+ * @param [in,out] counters  Calculated blocks and depth of Hirschberg's algorithm are counted in it,
+ *                           if it is not NULL.
+ * @param [in] depth  Depth of recursion of Hirschberg's algorithm at which problem is solved,
+ *                    0 for the whole problem.
  * @param [out] alignment  Sequence of edit operations that make target equal to query.
+ *                         Must have size of at least queryLength + targetLength.
  * @param [out] alignmentLength  Length of alignment.
  * @return Status code.
  */
+template <typename Word, int WORD_SIZE>
 static int obtainAlignment(
         const unsigned char* const query, const unsigned char* const rQuery, const int queryLength,
         const unsigned char* const target, const unsigned char* const rTarget, const int targetLength,
         const EqualityDefinition& equalityDefinition, const int alphabetLength, const int bestScore,
-        unsigned char** const alignment, int* const alignmentLength) {
+        const Word* const Peq_, const Word* const rPeq_, Arena& arena,
+        const int numThreads, const int parallelCutoff, const long long tracebackMemoryBudget,
+        WorkCounters* const counters, const int depth,
+        unsigned char* const alignment, int* const alignmentLength) {
 
     // Handle special case when one of sequences has length of 0.
     if (queryLength == 0 || targetLength == 0) {
         *alignmentLength = targetLength + queryLength;
-        *alignment = static_cast<unsigned char*>(malloc((*alignmentLength) * sizeof(unsigned char)));
         for (int i = 0; i < *alignmentLength; i++) {
-            (*alignment)[i] = queryLength == 0 ? EDLIB_EDOP_DELETE : EDLIB_EDOP_INSERT;
+            alignment[i] = queryLength == 0 ? EDLIB_EDOP_DELETE : EDLIB_EDOP_INSERT;
         }
         return EDLIB_STATUS_OK;
     }
@@ -1178,41 +4538,111 @@ static int obtainAlignment(
     const int W = maxNumBlocks * WORD_SIZE - queryLength;
     int statusCode;
 
-    // TODO: think about reducing number of memory allocations in alignment functions, probably
-    // by sharing some memory that is allocated only once. That refers to: Peq, columns in Hirschberg,
-    // and it could also be done for alignments - we could have one big array for alignment that would be
-    // sparsely populated by each of steps in recursion, and at the end we would just consolidate those results.
-
-    // If estimated memory consumption for traceback algorithm is smaller than 1MB use it,
-    // otherwise use Hirschberg's algorithm. By running few tests I choose boundary of 1MB as optimal.
-    long long alignmentDataSize = (2ll * sizeof(Word) + sizeof(int)) * maxNumBlocks * targetLength
-        + 2ll * sizeof(int) * targetLength;
-    if (alignmentDataSize < 1024 * 1024) {
+    // All temporary memory (Peq, columns in Hirschberg) is allocated from arena and released here,
+    // while alignments of sub-problems are written directly to their place in the alignment.
+    ArenaScope arenaScope(arena);
+
+    // If estimated memory consumption for traceback algorithm fits into budget use it,
+    // otherwise use traceback with checkpoints if its memory consumption fits into budget,
+    // otherwise use Hirschberg's algorithm. Problem with target of one character can not be split further.
+    // Only band is stored, so for small bestScore traceback is used also for long sequences.
+    const long long numColumnBandBlocks = getMaxNumBandBlocks<Word>(maxNumBlocks, bestScore);
+    const long long numBandBlocks = numColumnBandBlocks * targetLength;
+    const int checkpointInterval = getCheckpointInterval(targetLength);
+    const long long checkpointedSize = NWCheckpoints<Word>::size(targetLength, checkpointInterval, numColumnBandBlocks)
+        + AlignmentData<Word>::size(checkpointInterval + 1, numColumnBandBlocks * (checkpointInterval + 1));
+    if (AlignmentData<Word>::size(targetLength, numBandBlocks) <= tracebackMemoryBudget || targetLength <= 1) {
         int score_, endLocation_;  // Used only to call function.
-        AlignmentData* alignData = NULL;
-        Word* Peq = buildPeq(alphabetLength, query, queryLength, equalityDefinition);
-        myersCalcEditDistanceNW(Peq, W, maxNumBlocks,
-                                queryLength,
-                                target, targetLength,
-                                bestScore,
-                                &score_, &endLocation_, true, &alignData, -1);
+        AlignmentData<Word> alignData(targetLength, static_cast<size_t>(numBandBlocks), arena);
+        const Word* Peq = Peq_ ? Peq_ : buildPeq<Word>(alphabetLength, query, queryLength, equalityDefinition, arena);
+        myersCalcEditDistanceNW<Word, WORD_SIZE>(Peq, W, maxNumBlocks,
+                                                 queryLength,
+                                                 target, targetLength,
+                                                 bestScore, arena,
+                                                 &score_, &endLocation_, true, &alignData, -1, NULL, counters);
         //assert(score_ == bestScore);
         //assert(endLocation_ == targetLength - 1);
 
-        statusCode = obtainAlignmentTraceback(queryLength, targetLength,
-                                              bestScore, alignData, alignment, alignmentLength);
-        delete alignData;
-        delete[] Peq;
+        statusCode = obtainAlignmentTraceback<Word, WORD_SIZE>(queryLength, targetLength,
+                                                               bestScore, &alignData, NULL,
+                                                               alignment, alignmentLength);
+    } else if (checkpointedSize <= tracebackMemoryBudget) {
+        statusCode = obtainAlignmentCheckpointed(query, queryLength, target, targetLength,
+                                                 equalityDefinition, alphabetLength, bestScore, Peq_, arena,
+                                                 counters, alignment, alignmentLength);
     } else {
         statusCode = obtainAlignmentHirschberg(query, rQuery, queryLength,
                                                target, rTarget, targetLength,
-                                               equalityDefinition, alphabetLength, bestScore,
+                                               equalityDefinition, alphabetLength, bestScore, Peq_, rPeq_, arena,
+                                               numThreads, parallelCutoff, tracebackMemoryBudget, counters, depth,
                                                alignment, alignmentLength);
     }
     return statusCode;
 }
 
 
+/**
+ * Finds one possible alignment that gives optimal score (bestScore).
+ * Dynamic programming matrix is calculated once while saving every interval-th column as a checkpoint,
+ * where interval is about sqrt(targetLength), and then traceback calculates segments of matrix between
+ * checkpoints again, from last to first one, as it moves through them.
+ * Therefore it takes memory proportional to k * sqrt(targetLength) and calculates matrix about twice,
+ * while Hirschberg's algorithm calculates it about log(targetLength) times.
+ * @param [in] query
+ * @param [in] queryLength
+ * @param [in] target
+ * @param [in] targetLength
+ * @param [in] equalityDefinition
+ * @param [in] alphabetLength
+ * @param [in] bestScore  Best(optimal) score.
+ * @param [in] Peq  Query profile, or NULL if it should be built here.
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [in,out] counters  Calculated blocks are counted in it, if it is not NULL.
+ * @param [out] alignment  Sequence of edit operations that make target equal to query.
+ *                         Must have size of at least queryLength + targetLength.
+ * @param [out] alignmentLength  Length of alignment.
+ * @return Status code.
+ */
+template <typename Word, int WORD_SIZE>
+static int obtainAlignmentCheckpointed(
+        const unsigned char* const query, const int queryLength,
+        const unsigned char* const target, const int targetLength,
+        const EqualityDefinition& equalityDefinition, const int alphabetLength, const int bestScore,
+        const Word* const Peq_, Arena& arena, WorkCounters* const counters,
+        unsigned char* const alignment, int* const alignmentLength) {
+    const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
+    const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    const size_t numColumnBandBlocks = static_cast<size_t>(getMaxNumBandBlocks<Word>(maxNumBlocks, bestScore));
+    const int interval = getCheckpointInterval(targetLength);
+
+    ArenaScope arenaScope(arena);
+    const Word* Peq = Peq_ ? Peq_ : buildPeq<Word>(alphabetLength, query, queryLength, equalityDefinition, arena);
+    NWCheckpoints<Word> checkpoints(targetLength, interval, numColumnBandBlocks, arena);
+    int score_, endLocation_;  // Used only to call function.
+    if (myersCalcEditDistanceNW<Word, WORD_SIZE>(Peq, W, maxNumBlocks, queryLength, target, targetLength,
+                                                 bestScore, arena, &score_, &endLocation_, false, NULL, -1,
+                                                 &checkpoints, counters) != EDLIB_STATUS_OK) {
+        return EDLIB_STATUS_ERROR;
+    }
+
+    AlignmentData<Word> segment(interval + 1, numColumnBandBlocks * static_cast<size_t>(interval + 1), arena);
+    TracebackSegments<Word> segments;
+    segments.Peq = Peq;
+    segments.W = W;
+    segments.maxNumBlocks = maxNumBlocks;
+    segments.queryLength = queryLength;
+    segments.target = target;
+    segments.targetLength = targetLength;
+    segments.bestScore = bestScore;
+    segments.checkpoints = &checkpoints;
+    segments.segment = &segment;
+    segments.arena = &arena;
+    segments.counters = counters;
+    return obtainAlignmentTraceback(queryLength, targetLength, bestScore, &segment, &segments,
+                                    alignment, alignmentLength);
+}
+
+
 /**
  * Finds one possible alignment that gives optimal score (bestScore).
  * Uses Hirschberg's algorithm to split problem into two sub-problems, solve them and combine them together.
@@ -1224,61 +4654,80 @@ static int obtainAlignment(
  * @param [in] targetLength
  * @param [in] alphabetLength
  * @param [in] bestScore  Best(optimal) score.
+ * @param [in] Peq  Query profile, or NULL if it should be built here.
+ * @param [in] rPeq  Profile of reversed query, or NULL if it should be built here.
+ * @param [in] arena  Temporary memory is allocated from it.
+ * @param [in] numThreads  Maximal number of threads that Hirschberg's algorithm can use.
+ * @param [in] parallelCutoff  Problems with target shorter than this are solved in one thread.
+ * @param [in] tracebackMemoryBudget  Problems for which traceback needs more bytes are split further.
+ * @param [in,out] counters  Calculated blocks and depth of Hirschberg's algorithm are counted in it,
+ *                           if it is not NULL.
+ * @param [in] depth  Depth of recursion of Hirschberg's algorithm at which problem is solved,
+ *                    0 for the whole problem.
  * @param [out] alignment  Sequence of edit operations that make target equal to query.
+ *                         Must have size of at least queryLength + targetLength.
  * @param [out] alignmentLength  Length of alignment.
  * @return Status code.
  */
+template <typename Word, int WORD_SIZE>
 static int obtainAlignmentHirschberg(
         const unsigned char* const query, const unsigned char* const rQuery, const int queryLength,
         const unsigned char* const target, const unsigned char* const rTarget, const int targetLength,
         const EqualityDefinition& equalityDefinition, const int alphabetLength, const int bestScore,
-        unsigned char** const alignment, int* const alignmentLength) {
+        const Word* const Peq_, const Word* const rPeq_, Arena& arena,
+        const int numThreads, const int parallelCutoff, const long long tracebackMemoryBudget,
+        WorkCounters* const counters, const int depth,
+        unsigned char* const alignment, int* const alignmentLength) {
 
     const int maxNumBlocks = ceilDiv(queryLength, WORD_SIZE);
     const int W = maxNumBlocks * WORD_SIZE - queryLength;
+    if (counters) WorkCounters::updateMax(counters->hirschbergDepth, depth + 1);
 
-    Word* Peq = buildPeq(alphabetLength, query, queryLength, equalityDefinition);
-    Word* rPeq = buildPeq(alphabetLength, rQuery, queryLength, equalityDefinition);
+    // Memory allocated from here on is released before solving sub-problems.
+    const Arena::Mark arenaMark = arena.mark();
+    const Word* Peq = Peq_ ? Peq_ : buildPeq<Word>(alphabetLength, query, queryLength, equalityDefinition, arena);
+    const Word* rPeq = rPeq_ ? rPeq_ : buildPeq<Word>(alphabetLength, rQuery, queryLength, equalityDefinition, arena);
 
-    // Used only to call functions.
-    int score_, endLocation_;
+    // If there is more than one thread, halves are calculated in parallel, and so are sub-problems.
+    const bool parallel = numThreads > 1 && targetLength >= parallelCutoff;
 
     // Divide dynamic matrix into two halfs, left and right.
     const int leftHalfWidth = targetLength / 2;
     const int rightHalfWidth = targetLength - leftHalfWidth;
 
-    // Calculate left half.
-    AlignmentData* alignDataLeftHalf = NULL;
-    int leftHalfCalcStatus = myersCalcEditDistanceNW(
-            Peq, W, maxNumBlocks, queryLength, target, targetLength, bestScore,
-            &score_, &endLocation_, false, &alignDataLeftHalf, leftHalfWidth - 1);
-
-    // Calculate right half.
-    AlignmentData* alignDataRightHalf = NULL;
-    int rightHalfCalcStatus = myersCalcEditDistanceNW(
-            rPeq, W, maxNumBlocks, queryLength, rTarget, targetLength, bestScore,
-            &score_, &endLocation_, false, &alignDataRightHalf, rightHalfWidth - 1);
-
-    delete[] Peq;
-    delete[] rPeq;
+    // Calculate left half and right half.
+    AlignmentData<Word> alignDataLeftHalf(1, maxNumBlocks, arena);
+    AlignmentData<Word> alignDataRightHalf(1, maxNumBlocks, arena);
+    int leftHalfCalcStatus, rightHalfCalcStatus;
+    runTasks(parallel, arena,
+        [&](Arena& taskArena) {
+            int score_, endLocation_;  // Used only to call function.
+            leftHalfCalcStatus = myersCalcEditDistanceNW<Word, WORD_SIZE>(
+                    Peq, W, maxNumBlocks, queryLength, target, targetLength, bestScore, taskArena,
+                    &score_, &endLocation_, false, &alignDataLeftHalf, leftHalfWidth - 1, NULL, counters);
+        },
+        [&](Arena& taskArena) {
+            int score_, endLocation_;  // Used only to call function.
+            rightHalfCalcStatus = myersCalcEditDistanceNW<Word, WORD_SIZE>(
+                    rPeq, W, maxNumBlocks, queryLength, rTarget, targetLength, bestScore, taskArena,
+                    &score_, &endLocation_, false, &alignDataRightHalf, rightHalfWidth - 1, NULL, counters);
+        });
 
     if (leftHalfCalcStatus == EDLIB_STATUS_ERROR || rightHalfCalcStatus == EDLIB_STATUS_ERROR) {
-        if (alignDataLeftHalf) delete alignDataLeftHalf;
-        if (alignDataRightHalf) delete alignDataRightHalf;
+        arena.release(arenaMark);
         return EDLIB_STATUS_ERROR;
     }
 
     // Unwrap the left half.
-    int firstBlockIdxLeft = alignDataLeftHalf->firstBlocks[0];
-    int lastBlockIdxLeft = alignDataLeftHalf->lastBlocks[0];
-    // TODO: avoid this allocation by using some shared array?
+    int firstBlockIdxLeft = alignDataLeftHalf.firstBlocks[0];
+    int lastBlockIdxLeft = alignDataLeftHalf.lastBlocks[0];
     // scoresLeft contains scores from left column, starting with scoresLeftStartIdx row (query index)
     // and ending with scoresLeftEndIdx row (0-indexed).
     int scoresLeftLength = (lastBlockIdxLeft - firstBlockIdxLeft + 1) * WORD_SIZE;
-    int* scoresLeft = new int[scoresLeftLength];
+    int* scoresLeft = arena.allocate<int>(scoresLeftLength);
     for (int blockIdx = firstBlockIdxLeft; blockIdx <= lastBlockIdxLeft; blockIdx++) {
-        Block block(alignDataLeftHalf->Ps[blockIdx], alignDataLeftHalf->Ms[blockIdx],
-                    alignDataLeftHalf->scores[blockIdx]);
+        const size_t i = alignDataLeftHalf.index(0, blockIdx);
+        Block<Word> block(alignDataLeftHalf.Ps[i], alignDataLeftHalf.Ms[i], alignDataLeftHalf.scores[i]);
         readBlock(block, scoresLeft + (blockIdx - firstBlockIdxLeft) * WORD_SIZE);
     }
     int scoresLeftStartIdx = firstBlockIdxLeft * WORD_SIZE;
@@ -1288,19 +4737,18 @@ static int obtainAlignmentHirschberg(
     }
 
     // Unwrap the right half (I also reverse it while unwraping).
-    int firstBlockIdxRight = alignDataRightHalf->firstBlocks[0];
-    int lastBlockIdxRight = alignDataRightHalf->lastBlocks[0];
+    int firstBlockIdxRight = alignDataRightHalf.firstBlocks[0];
+    int lastBlockIdxRight = alignDataRightHalf.lastBlocks[0];
     int scoresRightLength = (lastBlockIdxRight - firstBlockIdxRight + 1) * WORD_SIZE;
-    int* scoresRight = new int[scoresRightLength];
-    int* scoresRightOriginalStart = scoresRight;
+    int* scoresRight = arena.allocate<int>(scoresRightLength);
     for (int blockIdx = firstBlockIdxRight; blockIdx <= lastBlockIdxRight; blockIdx++) {
-        Block block(alignDataRightHalf->Ps[blockIdx], alignDataRightHalf->Ms[blockIdx],
-                    alignDataRightHalf->scores[blockIdx]);
+        const size_t i = alignDataRightHalf.index(0, blockIdx);
+        Block<Word> block(alignDataRightHalf.Ps[i], alignDataRightHalf.Ms[i], alignDataRightHalf.scores[i]);
         readBlockReverse(block, scoresRight + (lastBlockIdxRight - blockIdx) * WORD_SIZE);
     }
     int scoresRightStartIdx = queryLength - (lastBlockIdxRight + 1) * WORD_SIZE;
     // If there is padding at the beginning of scoresRight (that can happen because of reversing that we do),
-    // move pointer forward to remove the padding (that is why we remember originalStart).
+    // move pointer forward to remove the padding.
     if (scoresRightStartIdx < 0) {
         //assert(scoresRightStartIdx == -1 * W);
         scoresRight += W;
@@ -1308,9 +4756,6 @@ static int obtainAlignmentHirschberg(
         scoresRightLength -= W;
     }
 
-    delete alignDataLeftHalf;
-    delete alignDataRightHalf;
-
     //--------------------- Find the best move ----------------//
     // Find the query/row index of cell in left column which together with its lower right neighbour
     // from right column gives the best score (when summed). We also have to consider boundary cells
@@ -1352,8 +4797,7 @@ static int obtainAlignmentHirschberg(
         }
     }
 
-    delete[] scoresLeft;
-    delete[] scoresRightOriginalStart;
+    arena.release(arenaMark);
 
     if (queryIdxLeftAlignmentFound == false) {
         // If there was no move that is part of optimal alignment, then there is no such alignment
@@ -1368,30 +4812,38 @@ static int obtainAlignmentHirschberg(
     const int lrHeight = queryLength - ulHeight;
     const int ulWidth = leftHalfWidth;
     const int lrWidth = rightHalfWidth;
-    unsigned char* ulAlignment = NULL; int ulAlignmentLength;
-    int ulStatusCode = obtainAlignment(query, rQuery + lrHeight, ulHeight,
-                                       target, rTarget + lrWidth, ulWidth,
-                                       equalityDefinition, alphabetLength, leftScore,
-                                       &ulAlignment, &ulAlignmentLength);
-    unsigned char* lrAlignment = NULL; int lrAlignmentLength;
-    int lrStatusCode = obtainAlignment(query + ulHeight, rQuery, lrHeight,
-                                       target + ulWidth, rTarget, lrWidth,
-                                       equalityDefinition, alphabetLength, rightScore,
-                                       &lrAlignment, &lrAlignmentLength);
+    // Alignment is built by concatenating upper left alignment with lower right alignment.
+    // Since they may be calculated at the same time, lower right alignment is written
+    // after space reserved for upper left alignment and is then moved right after it.
+    // Threads are split between them.
+    unsigned char* const lrAlignment = alignment + ulHeight + ulWidth;
+    const int ulNumThreads = numThreads / 2;
+    const int lrNumThreads = numThreads - ulNumThreads;
+    int ulAlignmentLength, lrAlignmentLength;
+    int ulStatusCode, lrStatusCode;
+    runTasks(parallel, arena,
+        [&](Arena& taskArena) {
+            ulStatusCode = obtainAlignment<Word>(query, rQuery + lrHeight, ulHeight,
+                                                 target, rTarget + lrWidth, ulWidth,
+                                                 equalityDefinition, alphabetLength, leftScore, NULL, NULL, taskArena,
+                                                 max(ulNumThreads, 1), parallelCutoff, tracebackMemoryBudget,
+                                                 counters, depth + 1,
+                                                 alignment, &ulAlignmentLength);
+        },
+        [&](Arena& taskArena) {
+            lrStatusCode = obtainAlignment<Word>(query + ulHeight, rQuery, lrHeight,
+                                                 target + ulWidth, rTarget, lrWidth,
+                                                 equalityDefinition, alphabetLength, rightScore, NULL, NULL, taskArena,
+                                                 lrNumThreads, parallelCutoff, tracebackMemoryBudget,
+                                                 counters, depth + 1,
+                                                 lrAlignment, &lrAlignmentLength);
+        });
     if (ulStatusCode == EDLIB_STATUS_ERROR || lrStatusCode == EDLIB_STATUS_ERROR) {
-        if (ulAlignment) free(ulAlignment);
-        if (lrAlignment) free(lrAlignment);
         return EDLIB_STATUS_ERROR;
     }
+    memmove(alignment + ulAlignmentLength, lrAlignment, lrAlignmentLength);
 
-    // Build alignment by concatenating upper left alignment with lower right alignment.
     *alignmentLength = ulAlignmentLength + lrAlignmentLength;
-    *alignment = static_cast<unsigned char*>(malloc((*alignmentLength) * sizeof(unsigned char)));
-    memcpy(*alignment, ulAlignment, ulAlignmentLength);
-    memcpy(*alignment + ulAlignmentLength, lrAlignment, lrAlignmentLength);
-
-    free(ulAlignment);
-    free(lrAlignment);
     return EDLIB_STATUS_OK;
 }
 
@@ -1400,7 +4852,7 @@ static int obtainAlignmentHirschberg(
  * Takes char query and char target, recognizes alphabet and transforms them into unsigned char sequences
  * where elements in sequences are not any more letters of alphabet, but their index in alphabet.
  * Most of internal edlib functions expect such transformed sequences.
- * This function will allocate queryTransformed and targetTransformed, so make sure to free them when done.
+ * This function will allocate queryTransformed and targetTransformed from the arena.
  * Example:
  *   Original sequences: "ACT" and "CGT".
  *   Alphabet would be recognized as "ACTG". Alphabet length = 4.
@@ -1411,19 +4863,20 @@ static int obtainAlignmentHirschberg(
  * @param [in] targetLength
  * @param [out] queryTransformed  It will contain values in range [0, alphabet length - 1].
  * @param [out] targetTransformed  It will contain values in range [0, alphabet length - 1].
+ * @param [in] arena  Transformed sequences are allocated from it.
  * @return  Alphabet as a string of unique characters, where index of each character is its value in transformed
  *          sequences.
  */
 static string transformSequences(const char* const queryOriginal, const int queryLength,
                                  const char* const targetOriginal, const int targetLength,
                                  unsigned char** const queryTransformed_,
-                                 unsigned char** const targetTransformed_) {
+                                 unsigned char** const targetTransformed_, Arena& arena) {
     // Alphabet is constructed from letters that are present in sequences.
     // Each letter is assigned an ordinal number, starting from 0 up to alphabetLength - 1,
     // and new query and target are created in which letters are replaced with their ordinal numbers.
     // This query and target are used in all the calculations later.
-    unsigned char *queryTransformed = static_cast<unsigned char *>(malloc(sizeof(unsigned char) * queryLength));
-    unsigned char *targetTransformed = static_cast<unsigned char *>(malloc(sizeof(unsigned char) * targetLength));
+    unsigned char *queryTransformed = arena.allocate<unsigned char>(queryLength);
+    unsigned char *targetTransformed = arena.allocate<unsigned char>(targetLength);
 
     char alphabet[MAX_UCHAR + 1];
     int alphabetSize = 0;
@@ -1461,6 +4914,93 @@ static string transformSequences(const char* const queryOriginal, const int quer
     return std::string(alphabet, alphabetSize);
 }
 
+/**
+ * Same as transformSequences(), but transforms query and multiple targets, all with the same alphabet.
+ * @param [in] queryOriginal
+ * @param [in] queryLength
+ * @param [in] targetsOriginal
+ * @param [in] targetLengths
+ * @param [in] numTargets
+ * @param [out] queryTransformed  Allocated from the arena.
+ * @param [out] targetsTransformed  All targets one after another, allocated from the arena.
+ * @param [out] targets  Pointer to each target in targetsTransformed. Must have size of at least numTargets.
+ * @param [in] arena
+ * @return  Alphabet as a string of unique characters, where index of each character is its value in transformed
+ *          sequences.
+ */
+static string transformSequencesBatch(const char* const queryOriginal, const int queryLength,
+                                      const char* const* const targetsOriginal, const int* const targetLengths,
+                                      const int numTargets,
+                                      unsigned char** const queryTransformed_,
+                                      unsigned char** const targetsTransformed_,
+                                      const unsigned char** const targets, Arena& arena) {
+    size_t totalTargetsLength = 0;
+    for (int i = 0; i < numTargets; i++) {
+        totalTargetsLength += static_cast<size_t>(targetLengths[i]);
+    }
+    unsigned char *queryTransformed = arena.allocate<unsigned char>(queryLength);
+    unsigned char *targetsTransformed = arena.allocate<unsigned char>(totalTargetsLength);
+
+    char alphabet[MAX_UCHAR + 1];
+    int alphabetSize = 0;
+    unsigned char letterIdx[MAX_UCHAR + 1];
+    bool inAlphabet[MAX_UCHAR + 1];
+    for (int i = 0; i < MAX_UCHAR + 1; i++) inAlphabet[i] = false;
+
+    for (int i = 0; i < queryLength; i++) {
+        unsigned char c = static_cast<unsigned char>(queryOriginal[i]);
+        if (!inAlphabet[c]) {
+            inAlphabet[c] = true;
+            const unsigned char idx = static_cast<unsigned char>(alphabetSize++);
+            letterIdx[c] = idx;
+            alphabet[idx] = queryOriginal[i];
+        }
+        queryTransformed[i] = letterIdx[c];
+    }
+    unsigned char* targetTransformed = targetsTransformed;
+    for (int t = 0; t < numTargets; t++) {
+        targets[t] = targetTransformed;
+        for (int i = 0; i < targetLengths[t]; i++) {
+            unsigned char c = static_cast<unsigned char>(targetsOriginal[t][i]);
+            if (!inAlphabet[c]) {
+                inAlphabet[c] = true;
+                const unsigned char idx = static_cast<unsigned char>(alphabetSize++);
+                letterIdx[c] = idx;
+                alphabet[idx] = targetsOriginal[t][i];
+            }
+            targetTransformed[i] = letterIdx[c];
+        }
+        targetTransformed += targetLengths[t];
+    }
+
+    *queryTransformed_  = queryTransformed;
+    *targetsTransformed_ = targetsTransformed;
+
+    return std::string(alphabet, alphabetSize);
+}
+
+/**
+ * @return Number of unique characters in query and target together,
+ *         which is alphabet length that transformSequences() would recognize.
+ */
+static int countAlphabet(const char* const query, const int queryLength,
+                         const char* const target, const int targetLength) {
+    bool inAlphabet[MAX_UCHAR + 1];
+    for (int i = 0; i < MAX_UCHAR + 1; i++) inAlphabet[i] = false;
+    int alphabetSize = 0;
+    for (int i = 0; i < queryLength; i++) {
+        const unsigned char c = static_cast<unsigned char>(query[i]);
+        alphabetSize += !inAlphabet[c];
+        inAlphabet[c] = true;
+    }
+    for (int i = 0; i < targetLength; i++) {
+        const unsigned char c = static_cast<unsigned char>(target[i]);
+        alphabetSize += !inAlphabet[c];
+        inAlphabet[c] = true;
+    }
+    return alphabetSize;
+}
+
 
 extern "C" EdlibAlignConfig edlibNewAlignConfig(int k, EdlibAlignMode mode, EdlibAlignTask task,
                                                 const EdlibEqualityPair* additionalEqualities,
@@ -1471,6 +5011,15 @@ extern "C" EdlibAlignConfig edlibNewAlignConfig(int k, EdlibAlignMode mode, Edli
     config.task = task;
     config.additionalEqualities = additionalEqualities;
     config.additionalEqualitiesLength = additionalEqualitiesLength;
+    config.workspace = NULL;
+    config.numThreads = 1;
+    config.parallelCutoff = 10000;
+    config.tracebackMemoryBudget = EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET;
+    config.maxAlignments = 1;
+    config.runLengthAlignment = 0;
+    config.stats = NULL;
+    config.engine = EDLIB_ENGINE_BIT_VECTOR;
+    config.affineCosts = NULL;
     return config;
 }
 
@@ -1478,8 +5027,28 @@ extern "C" EdlibAlignConfig edlibDefaultAlignConfig(void) {
     return edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0);
 }
 
+extern "C" EdlibWorkspace* edlibCreateWorkspace(void) {
+    return new EdlibWorkspace;
+}
+
+extern "C" void edlibFreeWorkspace(EdlibWorkspace* const workspace) {
+    delete workspace;
+}
+
+extern "C" void edlibFreeAlignResult64(EdlibAlignResult64 result) {
+    if (result.endLocations) free(result.endLocations);
+    if (result.startLocations) free(result.startLocations);
+    if (result.alignment) free(result.alignment);
+    if (result.alignmentLengths) free(result.alignmentLengths);
+    if (result.alignmentRuns) free(result.alignmentRuns);
+    if (result.alignmentNumRuns) free(result.alignmentNumRuns);
+}
+
 extern "C" void edlibFreeAlignResult(EdlibAlignResult result) {
     if (result.endLocations) free(result.endLocations);
     if (result.startLocations) free(result.startLocations);
     if (result.alignment) free(result.alignment);
+    if (result.alignmentLengths) free(result.alignmentLengths);
+    if (result.alignmentRuns) free(result.alignmentRuns);
+    if (result.alignmentNumRuns) free(result.alignmentNumRuns);
 }
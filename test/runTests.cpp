@@ -3,6 +3,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <climits>
+#include <string>
+#include <vector>
 
 #include "edlib.h"
 #include "SimpleEditDistance.h"
@@ -569,12 +571,1469 @@ bool testEmptySequences() {
     return r;
 }
 
+// Band spans many blocks, so multi-block kernels are used (if supported by CPU).
+bool testManyBlocks() {
+    printf("Many blocks per column:\n");
+
+    const int queryLength = 1000;
+    const int targetLength = 1300;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+
+    bool r = executeTest(query, queryLength, target, targetLength, EDLIB_MODE_HW);
+    r = r && executeTest(query, queryLength, target, targetLength, EDLIB_MODE_NW);
+    r = r && executeTest(query, queryLength, target, targetLength, EDLIB_MODE_SHW);
+
+    free(query);
+    free(target);
+    return r;
+}
+
+// Checks that aligning query against multiple targets gives same results as aligning them one by one.
+bool testAlignBatch() {
+    printf("Align batch:\n");
+
+    const int numTargets = 21;
+    const int queryLengths[] = {10, 100, 300};
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    const int ks[] = {-1, 5, 40};
+    bool pass = true;
+
+    for (int queryLength : queryLengths) {
+        char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+        fillRandomly(query, queryLength, 4);
+        char* targets[numTargets];
+        int targetLengths[numTargets];
+        for (int i = 0; i < numTargets; i++) {
+            // First target is empty and last one has bigger alphabet than query.
+            targetLengths[i] = i == 0 ? 0 : rand() % (2 * queryLength);
+            targets[i] = static_cast<char *>(malloc(sizeof(char) * (targetLengths[i] + 1)));
+            fillRandomly(targets[i], targetLengths[i], i == numTargets - 1 ? 6 : 4);
+            // Some targets are similar to query, so there are also alignments with small edit distance.
+            if (i % 3 == 0 && targetLengths[i] >= queryLength) {
+                memcpy(targets[i] + targetLengths[i] / 4, query, queryLength * 3 / 4);
+            }
+        }
+
+        for (EdlibAlignMode mode : modes) {
+            for (int k : ks) {
+                const EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_PATH, NULL, 0);
+                EdlibAlignResult results[numTargets];
+                edlibAlignBatch(query, queryLength, targets, targetLengths, numTargets, config, results);
+                for (int i = 0; i < numTargets; i++) {
+                    EdlibAlignResult expected = edlibAlign(query, queryLength, targets[i], targetLengths[i], config);
+                    bool equal = results[i].status == expected.status
+                        && results[i].editDistance == expected.editDistance
+                        && results[i].numLocations == expected.numLocations
+                        && results[i].alignmentLength == expected.alignmentLength
+                        && results[i].alphabetLength == expected.alphabetLength;
+                    for (int j = 0; equal && j < expected.numLocations; j++) {
+                        equal = results[i].endLocations[j] == expected.endLocations[j]
+                            && (expected.startLocations == NULL
+                                || results[i].startLocations[j] == expected.startLocations[j]);
+                    }
+                    equal = equal && (expected.alignmentLength == 0
+                                      || memcmp(results[i].alignment, expected.alignment,
+                                                expected.alignmentLength) == 0);
+                    if (!equal) {
+                        pass = false;
+                        printf("Result for target %d (query length %d, k = %d) differs: "
+                               "expected edit distance %d, got %d\n",
+                               i, queryLength, k, expected.editDistance, results[i].editDistance);
+                    }
+                    edlibFreeAlignResult(expected);
+                    edlibFreeAlignResult(results[i]);
+                }
+            }
+        }
+
+        for (int i = 0; i < numTargets; i++) {
+            free(targets[i]);
+        }
+        free(query);
+    }
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that aligning with query profile gives same results as aligning with edlibAlign().
+bool testQueryProfile() {
+    printf("Query profile:\n");
+
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    // Characters 1 and 2 are in query, X and Y are only in targets.
+    EdlibEqualityPair additionalEqualities[2] = {{1, 'X'}, {'Y', 2}};
+    bool pass = true;
+
+    for (int queryLength : {0, 50, 700}) {
+        char* query = static_cast<char *>(malloc(sizeof(char) * (queryLength + 1)));
+        fillRandomly(query, queryLength, 4);
+        EdlibQueryProfile* profile = edlibCreateQueryProfile(query, queryLength, additionalEqualities, 2);
+        for (int t = 0; t < 10; t++) {
+            // Some targets contain characters that are not in query, some of them being equal to query characters.
+            const int targetLength = t == 0 ? 0 : rand() % (2 * queryLength + 10);
+            char* target = static_cast<char *>(malloc(sizeof(char) * (targetLength + 1)));
+            fillRandomly(target, targetLength, 4);
+            for (int i = 0; i < targetLength; i++) {
+                if (rand() % 10 == 0) target[i] = "XYZ"[rand() % 3];
+            }
+            if (t % 2 == 0 && targetLength >= queryLength) {
+                memcpy(target + targetLength / 4, query, queryLength * 3 / 4);
+            }
+
+            for (EdlibAlignMode mode : modes) {
+                const EdlibAlignConfig config = edlibNewAlignConfig(-1, mode, EDLIB_TASK_PATH,
+                                                                    additionalEqualities, 2);
+                EdlibAlignResult result = edlibAlignWithProfile(profile, target, targetLength, config);
+                EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+                bool equal = result.status == expected.status
+                    && result.editDistance == expected.editDistance
+                    && result.numLocations == expected.numLocations
+                    && result.alignmentLength == expected.alignmentLength
+                    && result.alphabetLength == expected.alphabetLength;
+                for (int j = 0; equal && j < expected.numLocations; j++) {
+                    equal = result.endLocations[j] == expected.endLocations[j]
+                        && (expected.startLocations == NULL
+                            || result.startLocations[j] == expected.startLocations[j]);
+                }
+                equal = equal && (expected.alignmentLength == 0
+                                  || memcmp(result.alignment, expected.alignment, expected.alignmentLength) == 0);
+                if (!equal) {
+                    pass = false;
+                    printf("Result (query length %d, target length %d) differs: "
+                           "expected edit distance %d, got %d\n",
+                           queryLength, targetLength, expected.editDistance, result.editDistance);
+                }
+                edlibFreeAlignResult(result);
+                edlibFreeAlignResult(expected);
+            }
+            free(target);
+        }
+        edlibFreeQueryProfile(profile);
+        free(query);
+    }
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that aligning with one workspace reused between alignments gives same results as aligning without it.
+bool testWorkspace() {
+    printf("Workspace:\n");
+
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    EdlibWorkspace* workspace = edlibCreateWorkspace();
+    bool pass = true;
+
+    // Sequences get longer and then shorter again, so workspace has to grow and is then reused.
+    // Longest of them are aligned with Hirschberg's algorithm.
+    for (int queryLength : {10, 200, 2000, 500, 0, 50}) {
+        char* query = static_cast<char *>(malloc(sizeof(char) * (queryLength + 1)));
+        fillRandomly(query, queryLength, 4);
+        for (int t = 0; t < 5; t++) {
+            const int targetLength = queryLength / 2 + rand() % (queryLength + 10);
+            char* target = static_cast<char *>(malloc(sizeof(char) * (targetLength + 1)));
+            fillRandomly(target, targetLength, 4);
+            if (t % 2 == 0 && targetLength >= queryLength) {
+                memcpy(target + targetLength / 4, query, queryLength * 3 / 4);
+            }
+
+            for (EdlibAlignMode mode : modes) {
+                EdlibAlignConfig config = edlibNewAlignConfig(-1, mode, EDLIB_TASK_PATH, NULL, 0);
+                EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+                config.workspace = workspace;
+                EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+                bool equal = result.status == expected.status
+                    && result.editDistance == expected.editDistance
+                    && result.numLocations == expected.numLocations
+                    && result.alignmentLength == expected.alignmentLength
+                    && result.alphabetLength == expected.alphabetLength;
+                for (int j = 0; equal && j < expected.numLocations; j++) {
+                    equal = result.endLocations[j] == expected.endLocations[j]
+                        && (expected.startLocations == NULL
+                            || result.startLocations[j] == expected.startLocations[j]);
+                }
+                equal = equal && (expected.alignmentLength == 0
+                                  || memcmp(result.alignment, expected.alignment, expected.alignmentLength) == 0);
+                if (!equal) {
+                    pass = false;
+                    printf("Result (query length %d, target length %d) differs: "
+                           "expected edit distance %d, got %d\n",
+                           queryLength, targetLength, expected.editDistance, result.editDistance);
+                }
+                edlibFreeAlignResult(result);
+                edlibFreeAlignResult(expected);
+            }
+            free(target);
+        }
+        free(query);
+    }
+    edlibFreeWorkspace(workspace);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Long and similar sequences, for which only narrow band is stored during traceback.
+bool testNarrowBand() {
+    printf("Long sequences with small edit distance:\n");
+
+    const int queryLength = 5000;
+    const int targetLength = 5010;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    memcpy(target, query, queryLength);
+    fillRandomly(target + queryLength, targetLength - queryLength, 4);
+    for (int i = 0; i < 20; i++) {
+        target[rand() % targetLength] = static_cast<char>(rand() % 4);
+    }
+
+    bool r = executeTest(query, queryLength, target, targetLength, EDLIB_MODE_HW);
+    r = r && executeTest(query, queryLength, target, targetLength, EDLIB_MODE_NW);
+    r = r && executeTest(query, queryLength, target, targetLength, EDLIB_MODE_SHW);
+
+    free(query);
+    free(target);
+    return r;
+}
+
+// Checks that finding alignment with Hirschberg's algorithm in multiple threads gives same alignment
+// as finding it in one thread.
+bool testParallelAlignment() {
+    printf("Parallel alignment:\n");
+
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    const int queryLength = 3000;
+    const int targetLength = 4000;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    memcpy(target + 500, query, queryLength / 2);
+    bool pass = true;
+
+    for (EdlibAlignMode mode : modes) {
+        for (int numThreads : {2, 3, 8}) {
+            EdlibAlignConfig config = edlibNewAlignConfig(-1, mode, EDLIB_TASK_PATH, NULL, 0);
+            // Small enough that Hirschberg's algorithm is used, and not traceback with checkpoints.
+            config.tracebackMemoryBudget = 10000;
+            EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+            config.numThreads = numThreads;
+            config.parallelCutoff = 100;
+            EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+            if (result.status != expected.status || result.editDistance != expected.editDistance
+                || result.alignmentLength != expected.alignmentLength
+                || memcmp(result.alignment, expected.alignment, expected.alignmentLength) != 0) {
+                pass = false;
+                printf("Alignment with %d threads differs from alignment with one thread\n", numThreads);
+            }
+            edlibFreeAlignResult(result);
+            edlibFreeAlignResult(expected);
+        }
+    }
+
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Queries that fit into 32 bits are aligned with 32-bit words, so checks queries around that length.
+bool testShortQueries() {
+    printf("Short queries:\n");
+
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    bool pass = true;
+    for (int queryLength : {5, 17, 31, 32, 33, 40}) {
+        const int targetLength = 10 + rand() % 100;
+        char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+        char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+        fillRandomly(query, queryLength, 4);
+        fillRandomly(target, targetLength, 4);
+        for (EdlibAlignMode mode : modes) {
+            pass = executeTest(query, queryLength, target, targetLength, mode) && pass;
+        }
+        free(query);
+        free(target);
+    }
+    return pass;
+}
+
+// Stops edlibAlignMany() after third target.
+int stopAfterThreeTargets(int targetIdx, const EdlibAlignResult*, void* userData) {
+    *static_cast<int*>(userData) = targetIdx + 1;
+    return targetIdx == 2 ? -2 : -1;
+}
+
+// Checks that edlibAlignTopN() finds same targets as aligning query to each target with edlibAlign().
+bool testAlignTopN() {
+    printf("Align top N:\n");
+
+    const int numTargets = 50;
+    const int queryLength = 100;
+    const EdlibAlignMode modes[] = {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW};
+    bool pass = true;
+
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    fillRandomly(query, queryLength, 4);
+    char* targets[numTargets];
+    int targetLengths[numTargets];
+    for (int i = 0; i < numTargets; i++) {
+        targetLengths[i] = i == 0 ? 0 : queryLength / 2 + rand() % queryLength;
+        targets[i] = static_cast<char *>(malloc(sizeof(char) * (targetLengths[i] + 1)));
+        fillRandomly(targets[i], targetLengths[i], 4);
+        // Targets are more and more similar to query, and some of them are same, so there are ties.
+        for (int j = 0; j < min(queryLength, targetLengths[i]); j++) {
+            if (rand() % numTargets < i) targets[i][j] = query[j];
+        }
+        if (i % 10 == 9) {
+            targetLengths[i] = targetLengths[i - 1];
+            targets[i] = static_cast<char *>(realloc(targets[i], sizeof(char) * (targetLengths[i] + 1)));
+            memcpy(targets[i], targets[i - 1], targetLengths[i]);
+        }
+    }
+
+    for (EdlibAlignMode mode : modes) {
+        for (int k : {-1, 30}) {
+            for (int numBest : {1, 7, numTargets + 1}) {
+                const EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_PATH, NULL, 0);
+                // Targets sorted by edit distance and index.
+                int expectedIdxs[numTargets];
+                int expectedScores[numTargets];
+                int numExpected = 0;
+                for (int i = 0; i < numTargets; i++) {
+                    EdlibAlignResult result = edlibAlign(query, queryLength, targets[i], targetLengths[i], config);
+                    if (result.editDistance >= 0 && (k < 0 || result.editDistance <= k)) {
+                        int j = numExpected++;
+                        for (; j > 0 && expectedScores[j - 1] > result.editDistance; j--) {
+                            expectedIdxs[j] = expectedIdxs[j - 1];
+                            expectedScores[j] = expectedScores[j - 1];
+                        }
+                        expectedIdxs[j] = i;
+                        expectedScores[j] = result.editDistance;
+                    }
+                    edlibFreeAlignResult(result);
+                }
+                numExpected = min(numExpected, numBest);
+
+                EdlibAlignResult results[numTargets + 1];
+                int targetIdxs[numTargets + 1];
+                const int numFound = edlibAlignTopN(query, queryLength, targets, targetLengths, numTargets,
+                                                    numBest, config, results, targetIdxs);
+                bool equal = numFound == numExpected;
+                for (int j = 0; j < numFound; j++) {
+                    if (equal) {
+                        const int i = targetIdxs[j];
+                        EdlibAlignResult expected = edlibAlign(query, queryLength, targets[i], targetLengths[i],
+                                                               config);
+                        equal = i == expectedIdxs[j]
+                            && results[j].editDistance == expectedScores[j]
+                            && results[j].numLocations == expected.numLocations
+                            && results[j].alignmentLength == expected.alignmentLength
+                            && (expected.alignmentLength == 0
+                                || memcmp(results[j].alignment, expected.alignment, expected.alignmentLength) == 0);
+                        edlibFreeAlignResult(expected);
+                    }
+                    edlibFreeAlignResult(results[j]);
+                }
+                if (!equal) {
+                    pass = false;
+                    printf("Best targets differ (mode = %d, k = %d, numBest = %d)\n", mode, k, numBest);
+                }
+            }
+        }
+    }
+
+    int numAligned = 0;
+    edlibAlignMany(query, queryLength, targets, targetLengths, numTargets, edlibDefaultAlignConfig(),
+                   stopAfterThreeTargets, &numAligned);
+    if (numAligned != 3) {
+        pass = false;
+        printf("Aligning was not stopped by callback, %d targets were aligned\n", numAligned);
+    }
+
+    for (int i = 0; i < numTargets; i++) {
+        free(targets[i]);
+    }
+    free(query);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that alignments are found for all locations, when query is found in repeated parts of target.
+bool testMultipleAlignments() {
+    printf("Multiple alignments:\n");
+
+    const int queryLength = 80;
+    const int targetLength = 3000;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    // Same copies of query with two differences, and one copy with different two differences.
+    for (int position : {200, 1000, 1800, 2600}) {
+        memcpy(target + position, query, queryLength);
+        target[position + 10] = query[10] == 'A' ? 'C' : 'A';
+        target[position + (position == 2600 ? 30 : 50)] = query[50] == 'A' ? 'C' : 'A';
+    }
+    bool pass = true;
+
+    for (EdlibAlignMode mode : {EDLIB_MODE_HW, EDLIB_MODE_SHW}) {
+        for (int maxAlignments : {-1, 2}) {
+            EdlibAlignConfig config = edlibNewAlignConfig(-1, mode, EDLIB_TASK_PATH, NULL, 0);
+            EdlibAlignResult first = edlibAlign(query, queryLength, target, targetLength, config);
+            config.maxAlignments = maxAlignments;
+            EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+            const int expectedNumAlignments = maxAlignments < 0 ? result.numLocations
+                : min(maxAlignments, result.numLocations);
+            bool correct = result.numAlignments == expectedNumAlignments
+                && (mode == EDLIB_MODE_SHW || result.numAlignments >= 2)
+                && result.alignmentLength == first.alignmentLength
+                && memcmp(result.alignment, first.alignment, first.alignmentLength) == 0;
+            const unsigned char* alignment = result.alignment;
+            for (int i = 0; i < result.numAlignments && correct; i++) {
+                correct = checkAlignment(query, queryLength, target, result.editDistance, result.endLocations[i],
+                                         mode, const_cast<unsigned char *>(alignment), result.alignmentLengths[i])
+                    && getAlignmentStart(alignment, result.alignmentLengths[i], result.endLocations[i])
+                    == result.startLocations[i];
+                alignment += result.alignmentLengths[i];
+            }
+            if (!correct) {
+                pass = false;
+                printf("Alignments are not correct (mode = %d, maxAlignments = %d)\n", mode, maxAlignments);
+            }
+            edlibFreeAlignResult(result);
+            edlibFreeAlignResult(first);
+        }
+    }
+
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that edlibFindHits() finds every location where query ends with edit distance of at most k.
+bool testFindHits() {
+    printf("Find hits:\n");
+
+    const int targetLength = 500;
+    const int k = 6;
+    bool pass = true;
+
+    for (int queryLength : {20, 70}) {
+        char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+        char* rQuery = static_cast<char *>(malloc(sizeof(char) * queryLength));
+        char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+        char* rTarget = static_cast<char *>(malloc(sizeof(char) * targetLength));
+        fillRandomly(query, queryLength, 4);
+        fillRandomly(target, targetLength, 4);
+        for (int position : {0, 150, 300, 400}) {
+            memcpy(target + position, query, queryLength);
+            target[position + queryLength / 2] = 'A';
+        }
+        for (int i = 0; i < queryLength; i++) rQuery[i] = query[queryLength - i - 1];
+        for (int i = 0; i < targetLength; i++) rTarget[i] = target[targetLength - i - 1];
+
+        for (EdlibAlignMode mode : {EDLIB_MODE_HW, EDLIB_MODE_SHW}) {
+            // Edit distance of best alignment ending at each position. For HW it is found by aligning
+            // reversed query to reversed target that ends at that position, with gap after query not penalized.
+            vector<int> scores(targetLength);
+            for (int e = 0; e < targetLength; e++) {
+                EdlibAlignResult result = mode == EDLIB_MODE_HW
+                    ? edlibAlign(rQuery, queryLength, rTarget + targetLength - e - 1, e + 1,
+                                 edlibNewAlignConfig(-1, EDLIB_MODE_SHW, EDLIB_TASK_DISTANCE, NULL, 0))
+                    : edlibAlign(query, queryLength, target, e + 1,
+                                 edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0));
+                scores[e] = result.editDistance;
+                edlibFreeAlignResult(result);
+            }
+
+            for (int suppressionRadius : {0, 10}) {
+                vector<int> expected;
+                for (int e = 0; e < targetLength; e++) {
+                    bool suppressed = scores[e] > k;
+                    for (int d = 1; d <= suppressionRadius && !suppressed; d++) {
+                        suppressed = (e - d >= 0 && scores[e - d] <= scores[e])
+                            || (e + d < targetLength && scores[e + d] < scores[e]);
+                    }
+                    if (!suppressed) expected.push_back(e);
+                }
+
+                EdlibHit* hits;
+                const int numHits = edlibFindHits(query, queryLength, target, targetLength,
+                                                  edlibNewAlignConfig(k, mode, EDLIB_TASK_DISTANCE, NULL, 0),
+                                                  suppressionRadius, &hits);
+                bool equal = numHits == static_cast<int>(expected.size());
+                for (int i = 0; i < numHits && equal; i++) {
+                    equal = hits[i].endLocation == expected[i] && hits[i].editDistance == scores[expected[i]];
+                }
+                if (!equal) {
+                    pass = false;
+                    printf("Hits differ (queryLength = %d, mode = %d, suppressionRadius = %d)\n",
+                           queryLength, mode, suppressionRadius);
+                }
+                free(hits);
+            }
+        }
+
+        free(query);
+        free(rQuery);
+        free(target);
+        free(rTarget);
+    }
+
+    EdlibHit* hits;
+    if (edlibFindHits("AC", 2, "ACAC", 4, edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_DISTANCE, NULL, 0),
+                      0, &hits) != -1) {
+        pass = false;
+        printf("Negative k should not be accepted\n");
+    }
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that stream search, with target given in parts of random length, finds same hits as edlibFindHits().
+bool testStreamSearch() {
+    printf("Stream search:\n");
+
+    const int targetLength = 5000;
+    const int k = 10;
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(target, targetLength, 4);
+    bool pass = true;
+
+    for (int queryLength : {20, 100}) {
+        char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+        fillRandomly(query, queryLength, 4);
+        for (int position : {0, 1000, 3000, targetLength - queryLength}) {
+            memcpy(target + position, query, queryLength);
+            target[position + queryLength / 2] = 'A';
+        }
+
+        for (EdlibAlignMode mode : {EDLIB_MODE_HW, EDLIB_MODE_SHW}) {
+            const EdlibAlignConfig config = edlibNewAlignConfig(k, mode, EDLIB_TASK_DISTANCE, NULL, 0);
+            EdlibHit* expected;
+            const int numExpected = edlibFindHits(query, queryLength, target, targetLength, config, 0, &expected);
+
+            vector<EdlibHit> hits;
+            EdlibStreamSearch* search = edlibCreateStreamSearch(query, queryLength, config);
+            const EdlibHit* partHits;
+            for (int start = 0; start < targetLength; ) {
+                const int partLength = min(rand() % 300, targetLength - start);
+                const int numPartHits = edlibStreamSearchFeed(search, target + start, partLength, &partHits);
+                hits.insert(hits.end(), partHits, partHits + numPartHits);
+                start += partLength;
+            }
+            const int numPartHits = edlibStreamSearchFinish(search, &partHits);
+            hits.insert(hits.end(), partHits, partHits + numPartHits);
+            edlibFreeStreamSearch(search);
+
+            bool equal = numExpected > 0 && static_cast<int>(hits.size()) == numExpected;
+            for (int i = 0; i < numExpected && equal; i++) {
+                equal = hits[i].endLocation == expected[i].endLocation
+                    && hits[i].editDistance == expected[i].editDistance;
+            }
+            if (!equal) {
+                pass = false;
+                printf("Hits differ (queryLength = %d, mode = %d)\n", queryLength, mode);
+            }
+            free(expected);
+        }
+        free(query);
+    }
+    free(target);
+
+    if (edlibCreateStreamSearch("AC", 2, edlibNewAlignConfig(1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0))) {
+        pass = false;
+        printf("NW mode should not be accepted\n");
+    }
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that searching with target index gives same results as searching whole target.
+bool testTargetIndex() {
+    printf("Target index:\n");
+
+    const int targetLength = 20000;
+    const int queryLength = 30;
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(target, targetLength, 4);
+    char query[queryLength];
+    fillRandomly(query, queryLength, 4);
+    // Query occurs in target few times with edits, and once it is cut by the end of target.
+    for (int position : {0, 5000, 5020, 12000, targetLength - queryLength / 2}) {
+        memcpy(target + position, query, min(queryLength, targetLength - position));
+        target[position + queryLength / 3] = 'A';
+    }
+    target[12000 + queryLength / 2] = 'B';
+    EdlibTargetIndex* index = edlibCreateTargetIndex(target, targetLength, 6);
+    bool pass = index != NULL;
+
+    for (EdlibAlignMode mode : {EDLIB_MODE_HW, EDLIB_MODE_SHW}) {
+        for (EdlibAlignTask task : {EDLIB_TASK_DISTANCE, EDLIB_TASK_LOC, EDLIB_TASK_PATH}) {
+            // Query consists of 5 seeds, so index is used in HW for k of at most 4,
+            // and whole target is searched for larger or negative k.
+            for (int k : {0, 1, 3, 10, -1}) {
+                const EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, NULL, 0);
+                EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+                EdlibAlignResult result = edlibAlignWithIndex(query, queryLength, index, config);
+                bool equal = result.editDistance == expected.editDistance
+                    && result.numLocations == expected.numLocations
+                    && result.numAlignments == expected.numAlignments
+                    && result.alignmentLength == expected.alignmentLength
+                    && result.alphabetLength == expected.alphabetLength;
+                for (int i = 0; equal && i < expected.numLocations; i++) {
+                    equal = result.endLocations[i] == expected.endLocations[i]
+                        && (expected.startLocations == NULL
+                            || result.startLocations[i] == expected.startLocations[i]);
+                }
+                if (equal && expected.alignment) {
+                    equal = memcmp(result.alignment, expected.alignment, expected.alignmentLength) == 0;
+                }
+                if (!equal) {
+                    pass = false;
+                    printf("Results differ (mode = %d, task = %d, k = %d)\n", mode, task, k);
+                }
+                edlibFreeAlignResult(result);
+                edlibFreeAlignResult(expected);
+
+                if (task != EDLIB_TASK_DISTANCE || k < 0) continue;
+                EdlibHit* expectedHits, * hits;
+                const int numExpected = edlibFindHits(query, queryLength, target, targetLength, config, 5,
+                                                      &expectedHits);
+                const int numHits = edlibFindHitsWithIndex(query, queryLength, index, config, 5, &hits);
+                equal = numHits == numExpected;
+                for (int i = 0; equal && i < numHits; i++) {
+                    equal = hits[i].endLocation == expectedHits[i].endLocation
+                        && hits[i].editDistance == expectedHits[i].editDistance;
+                }
+                if (!equal) {
+                    pass = false;
+                    printf("Hits differ (mode = %d, k = %d)\n", mode, k);
+                }
+                free(expectedHits);
+                free(hits);
+            }
+        }
+    }
+    edlibFreeTargetIndex(index);
+    free(target);
+
+    if (edlibCreateTargetIndex("ACGT", 4, 0)) {
+        pass = false;
+        printf("Seed length 0 should not be accepted\n");
+    }
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that edlibAlign64() gives same results as edlibAlign() for target that it processes in parts.
+bool testAlign64() {
+    printf("Align 64:\n");
+
+    const int queryLength = 100;
+    const int targetLength = 5 * (1 << 19);
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    // Copies of query, some of them over the border of two parts.
+    for (int position : {1000, (1 << 20) - 40, (1 << 21) - 99, targetLength - queryLength}) {
+        memcpy(target + position, query, queryLength);
+        target[position + 20] = 'A';
+    }
+    bool pass = true;
+
+    for (EdlibAlignMode mode : {EDLIB_MODE_HW, EDLIB_MODE_SHW}) {
+        for (EdlibAlignTask task : {EDLIB_TASK_DISTANCE, EDLIB_TASK_LOC, EDLIB_TASK_PATH}) {
+            for (int k : {-1, 10}) {
+                EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, NULL, 0);
+                config.maxAlignments = -1;
+                EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+                EdlibAlignResult64 result = edlibAlign64(query, queryLength, target, targetLength, config);
+                bool equal = result.status == expected.status
+                    && result.editDistance == expected.editDistance
+                    && result.numLocations == expected.numLocations
+                    && result.alphabetLength == expected.alphabetLength
+                    && (result.startLocations == NULL) == (expected.startLocations == NULL)
+                    && result.numAlignments == expected.numAlignments
+                    && result.alignmentLength == expected.alignmentLength;
+                int totalAlignmentLength = 0;
+                for (int i = 0; i < result.numLocations && equal; i++) {
+                    equal = result.endLocations[i] == expected.endLocations[i]
+                        && (!expected.startLocations || result.startLocations[i] == expected.startLocations[i]);
+                }
+                for (int i = 0; i < result.numAlignments && equal; i++) {
+                    equal = result.alignmentLengths[i] == expected.alignmentLengths[i];
+                    totalAlignmentLength += result.alignmentLengths[i];
+                }
+                if (equal && totalAlignmentLength > 0) {
+                    equal = memcmp(result.alignment, expected.alignment, totalAlignmentLength) == 0;
+                }
+                if (!equal) {
+                    pass = false;
+                    printf("Results differ (mode = %d, task = %d, k = %d)\n", mode, task, k);
+                }
+                edlibFreeAlignResult64(result);
+                edlibFreeAlignResult(expected);
+            }
+        }
+    }
+
+    // Target is not read, since NW can not be done with target that does not fit into int.
+    EdlibAlignResult64 result = edlibAlign64(query, queryLength, target, 1LL << 32, edlibDefaultAlignConfig());
+    if (result.status != EDLIB_STATUS_ERROR) {
+        pass = false;
+        printf("NW with too long target should fail\n");
+    }
+    edlibFreeAlignResult64(result);
+
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testAlignStats() {
+    printf("Align stats:\n");
+
+    bool pass = true;
+    const int queryLength = 3000;
+    const int targetLength = 4000;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    memcpy(target + 500, query, queryLength / 2);
+    EdlibAlignStats stats;
+
+    // Short query, so traceback is used to find alignment.
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+    config.stats = &stats;
+    EdlibAlignResult result = edlibAlign(query, 20, target, targetLength, config);
+    if (stats.blockSize != 32 || stats.numKRounds < 1 || stats.k != 32 << (stats.numKRounds - 1)
+        || stats.k < result.editDistance || stats.distance.numBlocks < targetLength
+        || stats.distance.maxBandBlocks != 1 || stats.start.numBlocks <= 0 || stats.alignment.numBlocks <= 0
+        || stats.hirschbergDepth != 0 || stats.bytesAllocated <= 0) {
+        pass = false;
+        printf("Wrong stats of short query\n");
+    }
+    edlibFreeAlignResult(result);
+
+    // Long query and small traceback memory budget, so Hirschberg's algorithm is used, in multiple threads.
+    for (int numThreads : {1, 4}) {
+        config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+        config.tracebackMemoryBudget = 10000;
+        EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+        config.stats = &stats;
+        config.numThreads = numThreads;
+        config.parallelCutoff = 100;
+        result = edlibAlign(query, queryLength, target, targetLength, config);
+        if (result.editDistance != expected.editDistance || result.alignmentLength != expected.alignmentLength
+            || memcmp(result.alignment, expected.alignment, expected.alignmentLength) != 0) {
+            pass = false;
+            printf("Alignment with stats differs from alignment without them\n");
+        }
+        if (stats.blockSize != 64 || stats.k < result.editDistance || stats.distance.numBlocks <= 0
+            || stats.distance.maxBandBlocks > (queryLength + 63) / 64 || stats.start.numBlocks != 0
+            || stats.alignment.numBlocks <= 0 || stats.hirschbergDepth <= 0 || stats.bytesAllocated <= 0) {
+            pass = false;
+            printf("Wrong stats of long query with %d threads\n", numThreads);
+        }
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expected);
+    }
+
+    // Given k is calculated once, and there is nothing more to find for distance.
+    config = edlibNewAlignConfig(1000, EDLIB_MODE_SHW, EDLIB_TASK_DISTANCE, NULL, 0);
+    config.stats = &stats;
+    result = edlibAlign(query, queryLength, target, targetLength, config);
+    if (stats.numKRounds != 1 || stats.k != 1000 || stats.alignment.numBlocks != 0 || stats.start.numBlocks != 0) {
+        pass = false;
+        printf("Wrong stats with given k\n");
+    }
+    edlibFreeAlignResult(result);
+
+    // Stats are reset even if there is nothing to calculate.
+    memset(&stats, 1, sizeof(stats));
+    result = edlibAlign(query, 0, target, targetLength, config);
+    if (stats.numKRounds != 0 || stats.distance.numBlocks != 0 || stats.bytesAllocated != 0) {
+        pass = false;
+        printf("Stats of empty query are not reset\n");
+    }
+    edlibFreeAlignResult(result);
+
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testAutoK() {
+    printf("Automatically adjusted k:\n");
+
+    bool pass = true;
+    const int queryLength = 2000;
+    const int targetLength = 2500;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    memcpy(target + 300, query + 1000, 500);
+    const EdlibEqualityPair equalities[] = {{0, 1}};
+    EdlibAlignStats stats;
+
+    for (EdlibAlignMode mode : {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW}) {
+        for (int numEqualities : {0, 1}) {
+            EdlibAlignConfig config = edlibNewAlignConfig(queryLength + targetLength, mode, EDLIB_TASK_LOC,
+                                                          equalities, numEqualities);
+            EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+            config.k = -1;
+            config.stats = &stats;
+            EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+            if (result.editDistance != expected.editDistance || result.numLocations != expected.numLocations
+                || memcmp(result.endLocations, expected.endLocations, sizeof(int) * expected.numLocations) != 0
+                || memcmp(result.startLocations, expected.startLocations, sizeof(int) * expected.numLocations) != 0
+                || stats.k < result.editDistance) {
+                pass = false;
+                printf("Wrong result in mode %d with %d equalities\n", mode, numEqualities);
+            }
+            // Sequences are very different, so just doubling k from 64 would take 6 rounds.
+            if (mode == EDLIB_MODE_NW && numEqualities == 0 && stats.numKRounds > 4) {
+                pass = false;
+                printf("Too many rounds: %d\n", stats.numKRounds);
+            }
+            edlibFreeAlignResult(result);
+            edlibFreeAlignResult(expected);
+        }
+    }
+
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testDiagonalTransition() {
+    printf("Diagonal transition engine:\n");
+
+    bool pass = true;
+    const int queryLength = 5000;
+    const int targetLength = 7000;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    // Target starts with query with few edits, followed by random characters that are not used in NW.
+    memcpy(target, query, queryLength);
+    for (int i = 100; i < queryLength; i += 500) target[i] = static_cast<char>((target[i] + 1) % 4);
+    memmove(target + 2001, target + 2000, queryLength - 2001);
+    const EdlibEqualityPair equalities[] = {{0, 1}};
+    EdlibAlignStats stats;
+
+    for (EdlibAlignMode mode : {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW}) {
+        const int alignedLength = mode == EDLIB_MODE_NW ? queryLength + 1 : targetLength;
+        for (EdlibAlignTask task : {EDLIB_TASK_DISTANCE, EDLIB_TASK_LOC, EDLIB_TASK_PATH}) {
+            for (int k : {-1, 5, 30}) {
+                for (int numEqualities : {0, 1}) {
+                    EdlibAlignConfig config = edlibNewAlignConfig(k, mode, task, equalities, numEqualities);
+                    config.engine = EDLIB_ENGINE_BIT_VECTOR;
+                    EdlibAlignResult expected = edlibAlign(query, queryLength, target, alignedLength, config);
+                    for (EdlibAlignEngine engine : {EDLIB_ENGINE_AUTO, EDLIB_ENGINE_DIAGONAL_TRANSITION}) {
+                        config.engine = engine;
+                        config.stats = &stats;
+                        EdlibAlignResult result = edlibAlign(query, queryLength, target, alignedLength, config);
+                        bool same = result.editDistance == expected.editDistance
+                            && result.numLocations == expected.numLocations
+                            && result.alignmentLength == expected.alignmentLength;
+                        for (int i = 0; same && i < expected.numLocations; i++) {
+                            same = result.endLocations[i] == expected.endLocations[i]
+                                && (task == EDLIB_TASK_DISTANCE
+                                    || result.startLocations[i] == expected.startLocations[i]);
+                        }
+                        if (same && task == EDLIB_TASK_PATH && expected.editDistance >= 0) {
+                            same = memcmp(result.alignment, expected.alignment, expected.alignmentLength) == 0;
+                        }
+                        // Sequences are similar, so diagonal transition is picked automatically,
+                        // except for HW, for which it is not faster.
+                        const EdlibAlignEngine expectedEngine = engine == EDLIB_ENGINE_AUTO && mode == EDLIB_MODE_HW
+                            ? EDLIB_ENGINE_BIT_VECTOR : EDLIB_ENGINE_DIAGONAL_TRANSITION;
+                        if (!same || stats.engine != expectedEngine) {
+                            pass = false;
+                            printf("Wrong result in mode %d for task %d, k %d, %d equalities and engine %d\n",
+                                   mode, task, k, numEqualities, engine);
+                        }
+                        edlibFreeAlignResult(result);
+                    }
+                    edlibFreeAlignResult(expected);
+                }
+            }
+        }
+    }
+
+    // Unrelated sequences, for which automatically picked engine gives up on diagonal transition.
+    fillRandomly(target, targetLength, 4);
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_DISTANCE, NULL, 0);
+    config.stats = &stats;
+    EdlibAlignResult expected = edlibAlign(query, queryLength, target, targetLength, config);
+    // Diagonal transition is used only if it is asked for.
+    if (config.engine != EDLIB_ENGINE_BIT_VECTOR || stats.engine != EDLIB_ENGINE_BIT_VECTOR) {
+        pass = false;
+        printf("Default engine is not bit-vector algorithm\n");
+    }
+    for (EdlibAlignEngine engine : {EDLIB_ENGINE_AUTO, EDLIB_ENGINE_DIAGONAL_TRANSITION}) {
+        config.engine = engine;
+        EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+        const EdlibAlignEngine expectedEngine = engine == EDLIB_ENGINE_AUTO
+            ? EDLIB_ENGINE_BIT_VECTOR : EDLIB_ENGINE_DIAGONAL_TRANSITION;
+        if (result.editDistance != expected.editDistance || stats.engine != expectedEngine) {
+            pass = false;
+            printf("Wrong result of unrelated sequences with engine %d\n", engine);
+        }
+        edlibFreeAlignResult(result);
+    }
+    edlibFreeAlignResult(expected);
+
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testAffineGaps() {
+    printf("Affine gap costs:\n");
+
+    bool pass = true;
+    // One gap of length 3 costs 2 + 3 * 1, which is less than any alignment with gaps split or with mismatches.
+    const EdlibAffineCosts costs = {3, 2, 1};
+    EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+    config.affineCosts = &costs;
+    EdlibAlignResult result = edlibAlign("ACGTACGT", 8, "ACGTGGGACGT", 11, config);
+    char* cigar = result.alignment
+        ? edlibAlignmentToCigar(result.alignment, result.alignmentLength, EDLIB_CIGAR_EXTENDED) : NULL;
+    if (result.editDistance != 5 || cigar == NULL || strcmp(cigar, "4=3D4=") != 0) {
+        pass = false;
+        printf("Wrong alignment with one gap: %d %s\n", result.editDistance, cigar ? cigar : "");
+    }
+    free(cigar);
+    edlibFreeAlignResult(result);
+
+    // Only gap in empty query.
+    result = edlibAlign("", 0, "ACGT", 4, config);
+    if (result.editDistance != 6) {
+        pass = false;
+        printf("Wrong cost of empty query: %d\n", result.editDistance);
+    }
+    edlibFreeAlignResult(result);
+
+    const int queryLength = 300;
+    const int numTargets = 10;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    fillRandomly(query, queryLength, 4);
+    char* targets[numTargets];
+    int targetLengths[numTargets];
+    for (int i = 0; i < numTargets; i++) {
+        targetLengths[i] = 1 + rand() % (2 * queryLength);
+        targets[i] = static_cast<char *>(malloc(sizeof(char) * targetLengths[i]));
+        fillRandomly(targets[i], targetLengths[i], 4);
+        // Some targets are similar to query.
+        if (i % 2 == 0 && targetLengths[i] >= queryLength) {
+            memcpy(targets[i] + targetLengths[i] / 4, query, queryLength * 3 / 4);
+        }
+    }
+    const EdlibAffineCosts unitCosts = {1, 0, 1};
+    for (EdlibAlignMode mode : {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW}) {
+        for (int k : {-1, 50}) {
+            // With unit costs, cost is edit distance.
+            EdlibAlignConfig unitConfig = edlibNewAlignConfig(k, mode, EDLIB_TASK_LOC, NULL, 0);
+            for (int i = 0; i < numTargets; i++) {
+                EdlibAlignResult expected = edlibAlign(query, queryLength, targets[i], targetLengths[i], unitConfig);
+                unitConfig.affineCosts = &unitCosts;
+                result = edlibAlign(query, queryLength, targets[i], targetLengths[i], unitConfig);
+                unitConfig.affineCosts = NULL;
+                bool same = result.editDistance == expected.editDistance
+                    && result.numLocations == expected.numLocations;
+                for (int j = 0; same && j < expected.numLocations; j++) {
+                    same = result.endLocations[j] == expected.endLocations[j];
+                }
+                if (!same) {
+                    pass = false;
+                    printf("Unit costs differ from edit distance in mode %d for k %d and target %d\n", mode, k, i);
+                }
+                edlibFreeAlignResult(expected);
+                edlibFreeAlignResult(result);
+            }
+
+            // Cost of found alignment is the reported one, and batch gives same results.
+            config = edlibNewAlignConfig(k, mode, EDLIB_TASK_PATH, NULL, 0);
+            config.affineCosts = &costs;
+            EdlibAlignResult results[numTargets];
+            edlibAlignBatch(query, queryLength, targets, targetLengths, numTargets, config, results);
+            for (int i = 0; i < numTargets; i++) {
+                result = edlibAlign(query, queryLength, targets[i], targetLengths[i], config);
+                bool correct = result.editDistance == results[i].editDistance
+                    && result.numLocations == results[i].numLocations
+                    && result.alignmentLength == results[i].alignmentLength;
+                if (correct && result.editDistance >= 0) {
+                    int cost = 0;
+                    int queryIdx = 0;
+                    int targetIdx = result.startLocations[0];
+                    for (int j = 0; j < result.alignmentLength; j++) {
+                        const unsigned char op = result.alignment[j];
+                        if (op == EDLIB_EDOP_INSERT || op == EDLIB_EDOP_DELETE) {
+                            cost += costs.gapExtend + (j > 0 && result.alignment[j - 1] == op ? 0 : costs.gapOpen);
+                        } else {
+                            cost += query[queryIdx] == targets[i][targetIdx] ? 0 : costs.mismatch;
+                        }
+                        if (op != EDLIB_EDOP_DELETE) queryIdx++;
+                        if (op != EDLIB_EDOP_INSERT) targetIdx++;
+                    }
+                    correct = cost == result.editDistance && queryIdx == queryLength
+                        && targetIdx == result.endLocations[0] + 1
+                        && memcmp(result.alignment, results[i].alignment, result.alignmentLength) == 0;
+                }
+                if (!correct) {
+                    pass = false;
+                    printf("Wrong affine alignment in mode %d for k %d and target %d\n", mode, k, i);
+                }
+                edlibFreeAlignResult(result);
+                edlibFreeAlignResult(results[i]);
+            }
+        }
+    }
+
+    // With unit costs, short sequences with small alphabet give same locations as edit distance,
+    // including alignments that consist only of insertions.
+    for (int i = 0; i < 2000; i++) {
+        char shortQuery[4], shortTarget[6];
+        const int shortQueryLength = rand() % 5;
+        const int shortTargetLength = rand() % 7;
+        fillRandomly(shortQuery, shortQueryLength, 4);
+        fillRandomly(shortTarget, shortTargetLength, 4);
+        for (EdlibAlignMode mode : {EDLIB_MODE_NW, EDLIB_MODE_SHW, EDLIB_MODE_HW}) {
+            EdlibAlignConfig unitConfig = edlibNewAlignConfig(-1, mode, EDLIB_TASK_LOC, NULL, 0);
+            EdlibAlignResult expected = edlibAlign(shortQuery, shortQueryLength, shortTarget, shortTargetLength,
+                                                   unitConfig);
+            unitConfig.affineCosts = &unitCosts;
+            result = edlibAlign(shortQuery, shortQueryLength, shortTarget, shortTargetLength, unitConfig);
+            bool same = result.editDistance == expected.editDistance && result.numLocations == expected.numLocations;
+            for (int j = 0; same && j < expected.numLocations; j++) {
+                same = result.endLocations[j] == expected.endLocations[j]
+                    && (expected.startLocations == NULL
+                        || (result.startLocations && result.startLocations[j] == expected.startLocations[j]));
+            }
+            if (!same) {
+                pass = false;
+                printf("Unit costs differ from edit distance in mode %d for short sequences %d\n", mode, i);
+            }
+            edlibFreeAlignResult(expected);
+            edlibFreeAlignResult(result);
+        }
+    }
+
+    // Band from which alignment path is traced back has to fit into budget, which is not needed for cost only.
+    config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+    config.affineCosts = &costs;
+    config.tracebackMemoryBudget = 1;
+    result = edlibAlign(query, queryLength, query, queryLength, config);
+    config.task = EDLIB_TASK_DISTANCE;
+    EdlibAlignResult distanceResult = edlibAlign(query, queryLength, query, queryLength, config);
+    if (result.status != EDLIB_STATUS_ERROR || distanceResult.status != EDLIB_STATUS_OK
+        || distanceResult.editDistance != 0) {
+        pass = false;
+        printf("Traceback memory budget is not respected with affine costs\n");
+    }
+    edlibFreeAlignResult(result);
+    edlibFreeAlignResult(distanceResult);
+
+    // Invalid costs, and functions that do not support affine costs.
+    const EdlibAffineCosts invalidCosts = {1, 1, 0};
+    config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_DISTANCE, NULL, 0);
+    config.affineCosts = &invalidCosts;
+    result = edlibAlign(query, queryLength, targets[0], targetLengths[0], config);
+    if (result.status != EDLIB_STATUS_ERROR) {
+        pass = false;
+        printf("Invalid costs are accepted\n");
+    }
+    edlibFreeAlignResult(result);
+    config.k = 5;
+    config.affineCosts = &costs;
+    EdlibHit* hits;
+    if (edlibFindHits(query, queryLength, targets[0], targetLengths[0], config, 0, &hits) != -1
+        || edlibCreateStreamSearch(query, queryLength, config) != NULL) {
+        pass = false;
+        printf("Affine costs are accepted when searching for hits\n");
+    }
+
+    for (int i = 0; i < numTargets; i++) free(targets[i]);
+    free(query);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+// Checks that traceback memory budget decides between traceback and Hirschberg's algorithm,
+// and that peak memory follows it.
+bool testTracebackMemoryBudget() {
+    printf("Traceback memory budget:\n");
+
+    bool pass = true;
+    const int queryLength = 10000;
+    const int targetLength = 10200;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    memcpy(target + 100, query, queryLength);
+    for (int i = 100; i < targetLength; i += 97) target[i] = 'A';
+
+    EdlibAlignStats stats;
+    // From budget for which whole band fits, to budget for which problem is split down to single columns.
+    // Smaller budget makes traceback use checkpoints and then Hirschberg's algorithm go deeper,
+    // while peak memory does not grow.
+    const long long budgets[] = {1LL << 30, EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET, 10000, 1};
+    const int numBudgets = 4;
+    int depths[numBudgets];
+    long long peakBytes[numBudgets];
+    for (int i = 0; i < numBudgets; i++) {
+        EdlibAlignConfig config = edlibNewAlignConfig(500, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+        config.tracebackMemoryBudget = budgets[i];
+        config.stats = &stats;
+        EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+        depths[i] = stats.hirschbergDepth;
+        peakBytes[i] = stats.peakBytes;
+        const bool correct = result.editDistance >= 0
+            && checkAlignment(query, queryLength, target + result.startLocations[0], result.editDistance,
+                              result.endLocations[0] - result.startLocations[0], EDLIB_MODE_NW,
+                              result.alignment, result.alignmentLength);
+        if (!correct || peakBytes[i] <= 0 || peakBytes[i] > stats.bytesAllocated
+            || (i <= 1 && depths[i] != 0) || (i > 1 && (depths[i] <= depths[i - 1]
+                                                       || peakBytes[i] > peakBytes[i - 1]))
+            || (i == 1 && peakBytes[i] > peakBytes[i - 1])) {
+            pass = false;
+            printf("Wrong alignment or stats with budget %lld: depth %d, peak %lld\n",
+                   budgets[i], depths[i], peakBytes[i]);
+        }
+        edlibFreeAlignResult(result);
+    }
+    if (peakBytes[1] >= peakBytes[0] || peakBytes[1] > 2 * EDLIB_DEFAULT_TRACEBACK_MEMORY_BUDGET) {
+        pass = false;
+        printf("Default budget does not lower peak memory\n");
+    }
+    // Budget that is not given, as in zero-initialized config, is the default one.
+    for (long long budget : {0LL, -1LL}) {
+        EdlibAlignConfig config = edlibNewAlignConfig(500, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+        config.tracebackMemoryBudget = budget;
+        config.stats = &stats;
+        EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+        if (stats.hirschbergDepth != depths[1] || stats.peakBytes != peakBytes[1]) {
+            pass = false;
+            printf("Budget %lld is not the default one: depth %d, peak %lld\n",
+                   budget, stats.hirschbergDepth, stats.peakBytes);
+        }
+        edlibFreeAlignResult(result);
+    }
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testCheckpointedTraceback() {
+    printf("Checkpointed traceback:\n");
+
+    bool pass = true;
+    const int queryLength = 20000;
+    const int targetLength = 20500;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    // Target is query with a few hundred substitutions and one insertion of 500 characters.
+    memcpy(target, query, queryLength / 2);
+    memcpy(target + queryLength / 2 + 500, query + queryLength / 2, queryLength - queryLength / 2);
+    for (int i = 0; i < targetLength; i += 61) target[i] = 'A';
+
+    // Whole band does not fit into budget, but checkpoints do, so matrix is calculated about twice
+    // instead of being split by Hirschberg's algorithm.
+    EdlibAlignStats stats;
+    long long numBlocks[3];
+    const long long budgets[] = {1LL << 30, 200000, 1};
+    EdlibAlignResult results[3];
+    for (int i = 0; i < 3; i++) {
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_NW, EDLIB_TASK_PATH, NULL, 0);
+        config.tracebackMemoryBudget = budgets[i];
+        config.stats = &stats;
+        results[i] = edlibAlign(query, queryLength, target, targetLength, config);
+        const EdlibAlignResult& result = results[i];
+        numBlocks[i] = stats.alignment.numBlocks;
+        if (result.editDistance < 0
+            || !checkAlignment(query, queryLength, target, result.editDistance, result.endLocations[0],
+                               EDLIB_MODE_NW, result.alignment, result.alignmentLength)
+            || (i <= 1 && stats.hirschbergDepth != 0) || (i == 2 && stats.hirschbergDepth == 0)) {
+            pass = false;
+            printf("Wrong alignment or stats with budget %lld: depth %d\n", budgets[i], stats.hirschbergDepth);
+        }
+        // Checkpointed traceback moves through same columns as traceback of whole band.
+        if (i == 1 && (result.alignmentLength != results[0].alignmentLength
+                       || memcmp(result.alignment, results[0].alignment, results[0].alignmentLength) != 0)) {
+            pass = false;
+            printf("Checkpointed traceback differs from traceback of whole band\n");
+        }
+    }
+    for (int i = 0; i < 3; i++) edlibFreeAlignResult(results[i]);
+    if (numBlocks[1] <= numBlocks[0] || numBlocks[1] > 3 * numBlocks[0] || numBlocks[1] >= numBlocks[2]) {
+        pass = false;
+        printf("Checkpointed traceback calculated %lld blocks, instead of between %lld and %lld\n",
+               numBlocks[1], numBlocks[0], min(3 * numBlocks[0], numBlocks[2]));
+    }
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testCigarBufferAndRuns() {
+    printf("Cigar buffer and alignment runs:\n");
+
+    bool pass = true;
+    unsigned char alignment[130] = {EDLIB_EDOP_MATCH, EDLIB_EDOP_MATCH, EDLIB_EDOP_INSERT, EDLIB_EDOP_INSERT,
+                                    EDLIB_EDOP_INSERT, EDLIB_EDOP_DELETE, EDLIB_EDOP_INSERT, EDLIB_EDOP_INSERT,
+                                    EDLIB_EDOP_MISMATCH, EDLIB_EDOP_MATCH, EDLIB_EDOP_MATCH};
+    const char expected[] = "2=3I1D2I1X2=";
+    const int expectedLength = static_cast<int>(strlen(expected));
+    char cigar[16];
+    // Buffer that is too small, even if only for null character, gives length without writing cigar.
+    if (edlibAlignmentToCigarBuffer(alignment, 11, EDLIB_CIGAR_EXTENDED, NULL, 0) != expectedLength
+        || edlibAlignmentToCigarBuffer(alignment, 11, EDLIB_CIGAR_EXTENDED, cigar, expectedLength) != expectedLength
+        || edlibAlignmentToCigarBuffer(alignment, 11, EDLIB_CIGAR_EXTENDED, cigar, sizeof(cigar)) != expectedLength
+        || strcmp(cigar, expected) != 0) {
+        pass = false;
+        printf("Expected %s in buffer\n", expected);
+    }
+    for (int i = 11; i < 130; i++) alignment[i] = EDLIB_EDOP_MATCH;
+    if (edlibAlignmentToCigarBuffer(alignment, 130, EDLIB_CIGAR_STANDARD, cigar, sizeof(cigar)) != 12
+        || strcmp(cigar, "2M3I1D2I122M") != 0
+        || edlibAlignmentToCigarBuffer(alignment, 0, EDLIB_CIGAR_STANDARD, cigar, 1) != 0 || cigar[0] != 0) {
+        pass = false;
+        printf("Wrong cigar with long run or of empty alignment\n");
+    }
+    alignment[5] = 4;
+    if (edlibAlignmentToCigarBuffer(alignment, 11, EDLIB_CIGAR_EXTENDED, cigar, sizeof(cigar)) != -1) {
+        pass = false;
+        printf("Invalid alignment should give -1\n");
+    }
+
+    // Runs are same as runs of alignment that is found without them, for multiple alignments and affine costs.
+    const int queryLength = 300;
+    const int targetLength = 3000;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    for (int position : {200, 1500}) {
+        memcpy(target + position, query, queryLength);
+        target[position + 100] = query[100] == 'A' ? 'C' : 'A';
+    }
+    const EdlibAffineCosts costs = {3, 2, 1};
+    EdlibWorkspace* workspace = edlibCreateWorkspace();
+    for (int affine = 0; affine < 2; affine++) {
+        EdlibAlignConfig config = edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0);
+        config.maxAlignments = -1;
+        config.affineCosts = affine ? &costs : NULL;
+        EdlibAlignResult expectedResult = edlibAlign(query, queryLength, target, targetLength, config);
+        config.runLengthAlignment = 1;
+        config.workspace = workspace;
+        EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength, config);
+        bool correct = result.alignment == NULL && result.alignmentRuns != NULL && result.numAlignments == 2
+            && result.numAlignments == expectedResult.numAlignments
+            && result.alignmentLength == expectedResult.alignmentLength;
+        const EdlibAlignmentRun* run = result.alignmentRuns;
+        const unsigned char* expectedAlignment = expectedResult.alignment;
+        for (int a = 0; correct && a < result.numAlignments; a++) {
+            int length = 0;
+            for (int r = 0; correct && r < result.alignmentNumRuns[a]; r++, run++) {
+                correct = run->length > 0 && (r == 0 || run->operation != (run - 1)->operation);
+                for (int i = 0; correct && i < run->length; i++) {
+                    correct = *(expectedAlignment++) == run->operation;
+                }
+                length += run->length;
+            }
+            correct = correct && length == result.alignmentLengths[a] && length == expectedResult.alignmentLengths[a];
+        }
+        if (!correct) {
+            pass = false;
+            printf("Runs differ from alignment%s\n", affine ? " with affine costs" : "");
+        }
+        edlibFreeAlignResult(result);
+        edlibFreeAlignResult(expectedResult);
+    }
+    edlibFreeWorkspace(workspace);
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testPackedCigar() {
+    printf("Packed cigar:\n");
+
+    bool pass = true;
+    unsigned char alignment[] = {EDLIB_EDOP_MATCH, EDLIB_EDOP_MATCH, EDLIB_EDOP_INSERT, EDLIB_EDOP_INSERT,
+                                 EDLIB_EDOP_INSERT, EDLIB_EDOP_DELETE, EDLIB_EDOP_INSERT, EDLIB_EDOP_INSERT,
+                                 EDLIB_EDOP_MISMATCH, EDLIB_EDOP_MATCH, EDLIB_EDOP_MATCH};
+    // 2=3I1D2I1X2= and 2M3I1D2I3M, with operations coded as in BAM.
+    const uint32_t expectedExtended[] = {2 << 4 | 7, 3 << 4 | 1, 1 << 4 | 2, 2 << 4 | 1, 1 << 4 | 8, 2 << 4 | 7};
+    const uint32_t expectedStandard[] = {2 << 4 | 0, 3 << 4 | 1, 1 << 4 | 2, 2 << 4 | 1, 3 << 4 | 0};
+    uint32_t cigar[8];
+    if (edlibAlignmentToPackedCigar(alignment, 11, EDLIB_CIGAR_EXTENDED, NULL, 0) != 6
+        || edlibAlignmentToPackedCigar(alignment, 11, EDLIB_CIGAR_EXTENDED, cigar, 5) != 6
+        || edlibAlignmentToPackedCigar(alignment, 11, EDLIB_CIGAR_EXTENDED, cigar, 8) != 6
+        || memcmp(cigar, expectedExtended, sizeof(expectedExtended)) != 0) {
+        pass = false;
+        printf("Wrong packed cigar in extended format\n");
+    }
+    if (edlibAlignmentToPackedCigar(alignment, 11, EDLIB_CIGAR_STANDARD, cigar, 8) != 5
+        || memcmp(cigar, expectedStandard, sizeof(expectedStandard)) != 0) {
+        pass = false;
+        printf("Wrong packed cigar in standard format\n");
+    }
+    alignment[5] = 4;
+    if (edlibAlignmentToPackedCigar(alignment, 11, EDLIB_CIGAR_STANDARD, cigar, 8) != -1
+        || edlibAlignmentToPackedCigar(alignment, 0, EDLIB_CIGAR_STANDARD, cigar, 8) != 0) {
+        pass = false;
+        printf("Wrong packed cigar of invalid or empty alignment\n");
+    }
+
+    // Packed cigar has same operations as cigar string.
+    const int queryLength = 500;
+    const int targetLength = 700;
+    char* query = static_cast<char *>(malloc(sizeof(char) * queryLength));
+    char* target = static_cast<char *>(malloc(sizeof(char) * targetLength));
+    fillRandomly(query, queryLength, 4);
+    fillRandomly(target, targetLength, 4);
+    memcpy(target + 100, query, queryLength);
+    for (int i = 100; i < 600; i += 37) target[i] = 'A';
+    EdlibAlignResult result = edlibAlign(query, queryLength, target, targetLength,
+                                         edlibNewAlignConfig(-1, EDLIB_MODE_HW, EDLIB_TASK_PATH, NULL, 0));
+    for (EdlibCigarFormat format : {EDLIB_CIGAR_STANDARD, EDLIB_CIGAR_EXTENDED}) {
+        char* cigarString = edlibAlignmentToCigar(result.alignment, result.alignmentLength, format);
+        const int numOperations = edlibAlignmentToPackedCigar(result.alignment, result.alignmentLength, format,
+                                                              NULL, 0);
+        uint32_t* packedCigar = static_cast<uint32_t *>(malloc(sizeof(uint32_t) * numOperations));
+        edlibAlignmentToPackedCigar(result.alignment, result.alignmentLength, format, packedCigar, numOperations);
+        string unpacked;
+        for (int i = 0; i < numOperations; i++) {
+            unpacked += to_string(packedCigar[i] >> 4) + "MIDNSHP=X"[packedCigar[i] & 0xf];
+        }
+        if (unpacked != cigarString) {
+            pass = false;
+            printf("Packed cigar %s differs from %s\n", unpacked.c_str(), cigarString);
+        }
+        free(packedCigar);
+        free(cigarString);
+    }
+    edlibFreeAlignResult(result);
+    free(query);
+    free(target);
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
+bool testAlignPairs() {
+    printf("Align pairs:\n");
+
+    const int numPairs = 150;
+    bool pass = true;
+    char* queries[numPairs];
+    int queryLengths[numPairs];
+    char* targets[numPairs];
+    int targetLengths[numPairs];
+    for (int i = 0; i < numPairs; i++) {
+        // Some queries are longer than one word, and first pair has empty query.
+        queryLengths[i] = i == 0 ? 0 : rand() % 200;
+        targetLengths[i] = rand() % 300;
+        queries[i] = static_cast<char *>(malloc(sizeof(char) * (queryLengths[i] + 1)));
+        targets[i] = static_cast<char *>(malloc(sizeof(char) * (targetLengths[i] + 1)));
+        fillRandomly(queries[i], queryLengths[i], 4);
+        fillRandomly(targets[i], targetLengths[i], 4);
+        if (queryLengths[i] <= targetLengths[i]) {
+            memcpy(targets[i] + (targetLengths[i] - queryLengths[i]) / 2, queries[i], queryLengths[i] * 3 / 4);
+        }
+    }
+
+    for (int numThreads : {1, 4}) {
+        for (EdlibAlignMode mode : {EDLIB_MODE_NW, EDLIB_MODE_HW}) {
+            const EdlibAlignConfig config = edlibNewAlignConfig(mode == EDLIB_MODE_HW ? 50 : -1, mode,
+                                                                EDLIB_TASK_PATH, NULL, 0);
+            EdlibAlignResult results[numPairs];
+            edlibAlignPairs(queries, queryLengths, targets, targetLengths, numPairs, config, numThreads, results);
+            for (int i = 0; i < numPairs; i++) {
+                EdlibAlignResult expected = edlibAlign(queries[i], queryLengths[i], targets[i], targetLengths[i],
+                                                       config);
+                bool equal = results[i].status == expected.status
+                    && results[i].editDistance == expected.editDistance
+                    && results[i].numLocations == expected.numLocations
+                    && results[i].alignmentLength == expected.alignmentLength;
+                for (int j = 0; equal && j < expected.numLocations; j++) {
+                    equal = results[i].endLocations[j] == expected.endLocations[j]
+                        && (expected.startLocations == NULL
+                            || results[i].startLocations[j] == expected.startLocations[j]);
+                }
+                equal = equal && (expected.alignmentLength == 0
+                                  || memcmp(results[i].alignment, expected.alignment, expected.alignmentLength) == 0);
+                if (!equal) {
+                    pass = false;
+                    printf("Result for pair %d (%d threads) differs: expected edit distance %d, got %d\n",
+                           i, numThreads, expected.editDistance, results[i].editDistance);
+                }
+                edlibFreeAlignResult(expected);
+                edlibFreeAlignResult(results[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < numPairs; i++) {
+        free(queries[i]);
+        free(targets[i]);
+    }
+
+    printf(pass ? "\x1B[32m OK \x1B[0m\n" : "\x1B[31m FAIL \x1B[0m\n");
+    return pass;
+}
+
 bool runTests() {
     // TODO: make this global vector where tests have to add themselves.
-    int numTests = 19;
+    int numTests = 41;
     bool (* tests [])() = {test1, test2, test3, test4, test5, test6,
                            test7, test8, test9, test10, test11, test12, test13, test14, test15, test16,
-                           testCigar, testCustomEqualityRelation, testEmptySequences};
+                           testCigar, testCustomEqualityRelation, testEmptySequences, testManyBlocks,
+                           testAlignBatch, testQueryProfile, testWorkspace, testNarrowBand,
+                           testParallelAlignment, testShortQueries, testAlignTopN, testMultipleAlignments,
+                           testFindHits, testStreamSearch, testAlign64, testAlignStats,
+                           testAutoK, testDiagonalTransition, testAffineGaps, testTargetIndex,
+                           testTracebackMemoryBudget, testCheckpointedTraceback, testCigarBufferAndRuns,
+                           testPackedCigar, testAlignPairs};
 
     bool allTestsPassed = true;
     for (int i = 0; i < numTests; i++) {